@@ -0,0 +1,100 @@
+/**
+ *
+ *  \file
+ *  \brief      Overlapping Allan variance of recorded sensor data, and fitting of
+ *              the standard noise terms to the resulting curves.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_ALLAN_VARIANCE_H
+#define UM6_ALLAN_VARIANCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace um6
+{
+
+struct AllanCurve
+{
+  std::vector<double> tau;
+  std::vector<double> adev;
+};
+
+/**
+ * Noise terms read off an Allan deviation curve, in the units of the signal:
+ * angle random walk in units/sqrt(Hz), bias instability in units.
+ */
+struct AllanNoise
+{
+  double angle_random_walk;
+  double bias_instability;
+  double bias_instability_tau;
+};
+
+/**
+ * Returns roughly log-spaced cluster sizes, from one sample up to the largest
+ * for which the overlapping estimator is defined.
+ */
+std::vector<uint64_t> allanClusterSizes(size_t samples, unsigned int per_decade = 10);
+
+/**
+ * Integrates samples taken every tau0 seconds, after removing their mean,
+ * giving the samples + 1 "angle" values from which Allan variance is computed.
+ */
+void allanIntegrate(const double* samples, size_t count, double tau0, std::vector<double>* theta);
+
+/**
+ * Overlapping Allan variance at a cluster size of m samples, from the
+ * integrated signal. Each cluster size is a single O(N) pass.
+ */
+double allanVariance(const std::vector<double>& theta, uint64_t m, double tau0);
+
+/**
+ * Computes Allan deviation curves for several signals sampled at the same
+ * rate. The work is spread over the given number of threads, by signal and by
+ * cluster size.
+ */
+void allanDeviationCurves(const std::vector<std::vector<double> >& signals, double tau0,
+                          unsigned int threads, std::vector<AllanCurve>* curves,
+                          unsigned int per_decade = 10);
+
+/**
+ * Fits angle random walk to the part of the curve with a slope of -1/2, and
+ * takes bias instability from the flat bottom of the curve.
+ */
+AllanNoise fitAllanNoise(const AllanCurve& curve);
+
+}  // namespace um6
+
+#endif  // UM6_ALLAN_VARIANCE_H
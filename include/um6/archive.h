@@ -0,0 +1,212 @@
+/**
+ *
+ *  \file
+ *  \brief      Columnar on-disk archive of decoded samples. Written in fixed-size
+ *              chunks from a background thread, read back through mmap.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_ARCHIVE_H
+#define UM6_ARCHIVE_H
+
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "um6/sample.h"
+
+namespace um6
+{
+
+/**
+ * Archive files consist of a fixed header followed by chunks which are all
+ * exactly the same size on disk. Each chunk holds up to chunk_samples samples,
+ * stored column-wise: a chunk header, then a column of double stamps, then one
+ * column of float values for each Sample channel. Only the final chunk of a
+ * file may be partially filled.
+ *
+ * Because chunks sit at a fixed stride, the chunk headers double as a sparse
+ * time index: locating a stamp is a binary search over the chunk headers
+ * followed by one within a single stamp column, so no part of the file needs
+ * to be parsed up front.
+ */
+struct ArchiveFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t channels;
+  uint32_t chunk_samples;
+  uint32_t chunk_bytes;
+  uint8_t reserved[40];
+};
+
+struct ArchiveChunkHeader
+{
+  uint32_t count;
+  uint32_t reserved;
+  double first_stamp;
+  double last_stamp;
+};
+
+class ArchiveWriter
+{
+public:
+  /**
+   * Creates (or truncates) the archive at path. The chunk size is rounded up
+   * to a multiple of 16 samples to keep the columns aligned, and must be from
+   * 1 to MAX_CHUNK_SAMPLES. A realtime writer drops chunks rather than ever
+   * blocking the caller on disk I/O.
+   */
+  explicit ArchiveWriter(const std::string& path, uint32_t chunk_samples = 4096, bool realtime = false);
+  ~ArchiveWriter();
+
+  /**
+   * Copies a sample into the chunk being filled. This never touches the disk;
+   * full chunks are handed to the writer thread. If the writer thread has
+   * fallen too far behind, a realtime writer drops the chunk; otherwise, the
+   * caller waits for the backlog to clear.
+   */
+  void append(const Sample& sample);
+
+  /**
+   * Writes out the partially-filled chunk, if any, and waits for the writer
+   * thread to finish. Called automatically on destruction.
+   */
+  void close();
+
+  /**
+   * Chunks dropped by a realtime writer which fell behind, or which failed to
+   * write; safe to read from any thread. */
+  uint64_t droppedChunks() const
+  {
+    return dropped_chunks_.load(boost::memory_order_relaxed);
+  }
+
+  /**
+   * Number of full chunks waiting for the writer thread. */
+  size_t pendingChunks();
+
+  /**
+   * CPU time consumed so far by the writer thread, in nanoseconds, or zero
+   * once the writer is closed.
+   */
+  uint64_t writerCpuNanoseconds();
+
+  static const uint32_t MAX_PENDING_CHUNKS;
+  static const uint32_t MAX_CHUNK_SAMPLES;
+
+private:
+  void handOff();
+  void writeLoop();
+
+  int fd_;
+  uint32_t chunk_samples_;
+  uint32_t chunk_bytes_;
+  uint32_t fill_;
+  bool realtime_;
+  std::vector<char>* current_;
+  boost::atomic<uint64_t> dropped_chunks_;
+  uint64_t chunks_written_;
+
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  std::deque<std::vector<char>*> pending_;
+  std::vector<std::vector<char>*> spare_;
+  bool closing_;
+  boost::thread thread_;
+};
+
+class ArchiveReader : private boost::noncopyable
+{
+public:
+  /**
+   * Maps the archive at path, rejecting one whose header or chunk headers
+   * are inconsistent. */
+  explicit ArchiveReader(const std::string& path);
+  ~ArchiveReader();
+
+  /**
+   * Total number of samples in the archive. */
+  size_t size() const;
+
+  size_t chunks() const
+  {
+    return chunks_;
+  }
+
+  uint32_t chunkCount(size_t chunk) const
+  {
+    return chunkHeader(chunk)->count;
+  }
+
+  /**
+   * Zero-copy access to the stamp and channel columns of a chunk. Both are valid
+   * for chunkCount(chunk) entries, and for the lifetime of the reader. */
+  const double* stamps(size_t chunk) const;
+  const float* column(size_t chunk, int channel) const;
+
+  /**
+   * Returns the index of the first sample with a stamp at or after the one
+   * given, or size() if there is no such sample.
+   */
+  size_t find(double stamp) const;
+
+  /**
+   * Reassembles a single sample. The orientation covariance is not archived,
+   * and is returned zeroed.
+   */
+  void sample(size_t index, Sample* sample) const;
+
+  /**
+   * Collects every decimation-th sample of one channel with stamps in [start, end).
+   * Returns the number of values appended to the output vectors.
+   */
+  size_t scan(double start, double end, size_t decimation, int channel,
+              std::vector<double>* stamps, std::vector<float>* values) const;
+
+private:
+  const ArchiveChunkHeader* chunkHeader(size_t chunk) const;
+
+  const uint8_t* map_;
+  size_t map_length_;
+  size_t chunks_;
+  uint32_t chunk_samples_;
+  uint32_t chunk_bytes_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_ARCHIVE_H
@@ -0,0 +1,118 @@
+/**
+ *
+ *  \file
+ *  \brief      Rate-limited logging from the serial hot path, through a lock-free queue.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_ASYNC_LOG_H
+#define UM6_ASYNC_LOG_H
+
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+
+/**
+ * Logs a printf-style message from a hot path. Each call site passes at most
+ * one message per period seconds; the rest are counted, and the count is
+ * appended to the next message passed. Passed messages are formatted into a
+ * lock-free queue and handed to rosconsole by a background thread, so the
+ * caller never blocks on rosout.
+ */
+#define UM6_LOG_ASYNC(severity, period, ...) \
+  do \
+  { \
+    static um6::AsyncLog::Site um6_async_log_site; \
+    um6::AsyncLog::log(&um6_async_log_site, um6::AsyncLog::severity, period, __VA_ARGS__); \
+  } while (0)
+
+#define UM6_WARN_ASYNC(...) UM6_LOG_ASYNC(WARN, 1.0, __VA_ARGS__)
+#define UM6_ERROR_ASYNC(...) UM6_LOG_ASYNC(ERROR, 1.0, __VA_ARGS__)
+
+namespace um6
+{
+
+class AsyncLog
+{
+public:
+  enum Severity
+  {
+    INFO,
+    WARN,
+    ERROR
+  };
+
+  /**
+   * Rate-limiting state for one call site. */
+  struct Site
+  {
+    Site() : next_ns(0), suppressed(0)
+    {
+    }
+
+    boost::atomic<uint64_t> next_ns;
+    boost::atomic<uint32_t> suppressed;
+  };
+
+  /**
+   * Longest message passed on; longer ones are truncated. */
+  static const size_t MAX_TEXT = 200;
+
+  static void log(Site* site, Severity severity, double period, const char* format, ...)
+  __attribute__((format(printf, 4, 5)));
+
+  /**
+   * Starts the background thread, with room for capacity (rounded up to a
+   * power of two) messages in flight. Until started, and after stopping,
+   * messages are passed to rosconsole directly by the caller.
+   */
+  static void start(size_t capacity = 256);
+
+  /**
+   * Stops the background thread and passes on anything still queued. No
+   * other thread may be logging at the time. */
+  static void stop();
+
+  /**
+   * Messages dropped because the queue was full. */
+  static uint64_t dropped();
+
+  typedef void (*Sink)(Severity severity, const char* text);
+
+  /**
+   * Replaces rosconsole as the destination of passed messages, or restores
+   * it if sink is NULL. Set before starting. */
+  static void setSink(Sink sink);
+};
+
+}  // namespace um6
+
+#endif  // UM6_ASYNC_LOG_H
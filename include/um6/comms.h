@@ -36,6 +36,7 @@
 #define UM6_COMMS_H
 
 #include <stdint.h>
+#include <string.h>
 #include <string>
 
 namespace serial
@@ -52,12 +53,23 @@ class BadChecksum : public std::exception {};
 
 class Registers;
 class Accessor_;
+class FlightRecorder;
 
 class Comms
 {
 public:
-  explicit Comms(serial::Serial* s) : serial_(s), first_spin_(true)
+  explicit Comms(serial::Serial* s) : first_spin_(true), serial_(s), recorder_(NULL)
   {
+    memset(&counters_, 0, sizeof(counters_));
+  }
+
+  /**
+   * Copies every packet sent and received, good or bad, into the given
+   * recorder. Pass NULL to stop recording.
+   */
+  void setFlightRecorder(FlightRecorder* recorder)
+  {
+    recorder_ = recorder;
   }
 
   /**
@@ -70,6 +82,23 @@ public:
 
   void send(const Accessor_& a) const;
 
+  struct Counters
+  {
+    uint64_t bytes;          // Read from the port, including junk.
+    uint64_t packets;        // Received with a good checksum.
+    uint64_t bad_checksums;
+    uint64_t timeouts;
+    uint64_t resyncs;        // Header not where expected, so searched for.
+    uint64_t junk_bytes;     // Skipped while searching.
+  };
+
+  /**
+   * Running totals since construction. */
+  const Counters& counters() const
+  {
+    return counters_;
+  }
+
   bool sendWaitAck(const Accessor_& a);
 
   static const uint8_t PACKET_HAS_DATA;
@@ -84,6 +113,8 @@ public:
 private:
   bool first_spin_;
   serial::Serial* serial_;
+  FlightRecorder* recorder_;
+  Counters counters_;
 };
 }  // namespace um6
 
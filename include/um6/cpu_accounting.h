@@ -0,0 +1,115 @@
+/**
+ *
+ *  \file
+ *  \brief      Per-stage thread CPU accounting, for reporting cost per sample.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_CPU_ACCOUNTING_H
+#define UM6_CPU_ACCOUNTING_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+namespace um6
+{
+
+/**
+ * Charges the calling thread's CPU time (CLOCK_THREAD_CPUTIME_ID) to whichever
+ * stage of processing it is in. Switching stage reads the clock once, so
+ * callers should switch only on a change of stage rather than per packet.
+ * Alongside the CPU time, it counts the samples and bytes processed, so
+ * that the cost of each can be derived from the difference between two
+ * snapshots.
+ */
+class CpuAccounting
+{
+public:
+  enum Stage
+  {
+    READ,     // Waiting on and parsing serial data.
+    DECODE,   // Scaling registers into a sample.
+    PUBLISH,  // Building and publishing messages, logging, callbacks.
+    NUM_STAGES
+  };
+
+  struct Snapshot
+  {
+    uint64_t cpu_ns[NUM_STAGES];
+    uint64_t samples;
+    uint64_t bytes;
+  };
+
+  CpuAccounting();
+
+  /**
+   * Ends the current stage, if any, and starts charging the given one. */
+  void enter(Stage stage);
+
+  Stage stage() const
+  {
+    return stage_;
+  }
+
+  void addSample()
+  {
+    totals_.samples++;
+  }
+
+  void addBytes(uint64_t bytes)
+  {
+    totals_.bytes += bytes;
+  }
+
+  /**
+   * Totals so far, including the time spent in the current stage. */
+  Snapshot snapshot() const;
+
+  static const char* stageName(int stage);
+
+  /**
+   * CPU time consumed by the calling thread, in nanoseconds. */
+  static uint64_t threadCpuNanoseconds();
+
+  /**
+   * CPU time consumed by another thread of this process, in nanoseconds, or
+   * zero if it can't be read. The thread must not yet have been joined. */
+  static uint64_t threadCpuNanoseconds(pthread_t thread);
+
+private:
+  Stage stage_;
+  uint64_t stage_start_ns_;
+  Snapshot totals_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_CPU_ACCOUNTING_H
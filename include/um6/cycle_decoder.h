@@ -0,0 +1,83 @@
+/**
+ *
+ *  \file
+ *  \brief      Decoding of each completed cycle in the configured precision.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_CYCLE_DECODER_H
+#define UM6_CYCLE_DECODER_H
+
+#include <string>
+
+#include "ros/time.h"
+
+#include "um6/fixed_sample.h"
+#include "um6/sample.h"
+
+namespace um6
+{
+
+class Registers;
+
+/**
+ * Decodes each cycle in the configured precision, optionally low-pass
+ * filtered in that same precision. Messages are built from doubles
+ * regardless, so the sample handed back is always a double one.
+ */
+class CycleDecoder
+{
+public:
+  enum Precision { DOUBLE, FLOAT, FIXED };
+
+  CycleDecoder(Precision precision, int lowpass_shift);
+
+  void decode(const Registers& registers, const ros::Time& stamp, Sample* sample);
+
+  /**
+   * Restarts the filters, such as after a reconnect. */
+  void reset();
+
+  /**
+   * Parses "double", "float" or "fixed", returning false for anything else. */
+  static bool parsePrecision(const std::string& name, Precision* precision);
+
+private:
+  Precision precision_;
+  bool filtering_;
+  LowPass<double> lowpass_;
+  LowPass<float> lowpass_float_;
+  FixedLowPass lowpass_fixed_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_CYCLE_DECODER_H
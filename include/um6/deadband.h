@@ -0,0 +1,114 @@
+/**
+ *
+ *  \file
+ *  \brief      Change-triggered publishing of slowly varying registers.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef UM6_DEADBAND_H
+#define UM6_DEADBAND_H
+
+#include <stdexcept>
+
+#include "um6/registers.h"
+
+namespace um6
+{
+
+/**
+ * Decides, each cycle, whether a slowly varying register such as the
+ * temperature or magnetometer has moved far enough since it was last
+ * published to be worth publishing again, or has gone unpublished for too
+ * long. The comparison is made on the raw register fields against a
+ * threshold converted to counts once, so a skipped cycle costs a compare per
+ * field and nothing more.
+ */
+template<typename RegT>
+class Deadband
+{
+public:
+  enum { MAX_FIELDS = 4 };
+
+  /**
+   * The deadband is in the register's scaled units; zero or less publishes
+   * every cycle. A maximum interval of zero or less never forces a publish. */
+  Deadband(double deadband, double max_interval)
+    : deadband_(deadband), max_interval_(max_interval), threshold_(0), primed_(false), last_time_(0)
+  {}
+
+  bool enabled() const
+  {
+    return deadband_ > 0;
+  }
+
+  /**
+   * Returns true if the register should be published at this time, in
+   * seconds, in which case its fields become those compared against. */
+  bool update(const Accessor<RegT>& reg, double now)
+  {
+    if (!enabled()) return true;
+    bool publish = !primed_ || (max_interval_ > 0 && now - last_time_ >= max_interval_);
+    for (uint16_t i = 0; i < reg.length && !publish; i++)
+    {
+      RegT value = reg.get(i);
+      publish = value > last_[i] + threshold_ || value < last_[i] - threshold_;
+    }
+    if (!publish) return false;
+
+    if (!primed_)
+    {
+      if (reg.length > MAX_FIELDS) throw std::runtime_error("Too many fields for a deadband.");
+      threshold_ = deadband_ / reg.scale();
+      primed_ = true;
+    }
+    for (uint16_t i = 0; i < reg.length; i++) last_[i] = reg.get(i);
+    last_time_ = now;
+    return true;
+  }
+
+  /**
+   * Publishes on the next update, such as after a reconnect. */
+  void reset()
+  {
+    primed_ = false;
+  }
+
+private:
+  double deadband_;
+  double max_interval_;
+  double threshold_;
+  bool primed_;
+  double last_time_;
+  RegT last_[MAX_FIELDS];
+};
+
+}  // namespace um6
+
+#endif  // UM6_DEADBAND_H
@@ -0,0 +1,117 @@
+/**
+ *
+ *  \file
+ *  \brief      Detection of shocks and rapid rotations from single packets, ahead
+ *              of the rest of their cycle.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef UM6_EVENT_DETECTOR_H
+#define UM6_EVENT_DETECTOR_H
+
+#include <stdint.h>
+
+#include "um6/registers.h"
+
+namespace um6
+{
+
+/**
+ * Threshold detectors on the magnitude of acceleration and of angular rate,
+ * checked against each accelerometer or gyro packet as it is received rather
+ * than once the whole cycle has arrived, which at low baud rates is several
+ * milliseconds later. The magnitude is compared squared and in raw counts, so
+ * a packet which raises no event costs a few multiplies.
+ *
+ * Each detector fires once on crossing its threshold, and re-arms only after
+ * the magnitude has dropped back below it and the holdoff has passed, so that
+ * one impact raises one event rather than one per packet.
+ */
+class EventDetector
+{
+public:
+  enum Type { SHOCK, ROTATION, NUM_TYPES };
+
+  struct Event
+  {
+    Type type;
+
+    /**
+     * In g for a shock, rad/s for a rotation. */
+    double magnitude;
+
+    /**
+     * x, y, z in the ENU frame of imu/data. */
+    double vector[3];
+  };
+
+  /**
+   * The shock threshold is in g, and the rotation threshold in rad/s; either
+   * may be zero or less to disable it. The holdoff is in seconds. */
+  EventDetector(double shock_threshold, double rotation_threshold, double holdoff);
+
+  bool enabled() const
+  {
+    return detectors_[SHOCK].enabled || detectors_[ROTATION].enabled;
+  }
+
+  /**
+   * Checks the registers written by a packet just received from the given
+   * address, at a time in seconds. Returns true if that raised an event. */
+  bool check(int16_t address, const Registers& r, double now, Event* event);
+
+  /**
+   * Re-arms both detectors, such as after a reconnect. */
+  void reset();
+
+  static const char* typeName(Type type);
+
+private:
+  struct Detector
+  {
+    bool enabled;
+    bool armed;
+    double threshold;
+    double last_event;
+
+    /**
+     * Squared threshold in counts of the register. */
+    int64_t threshold_squared;
+  };
+
+  bool check(Type type, const Accessor<int16_t>& reg, double now, Event* event);
+
+  double holdoff_;
+  Detector detectors_[NUM_TYPES];
+};
+
+}  // namespace um6
+
+#endif  // UM6_EVENT_DETECTOR_H
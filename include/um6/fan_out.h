@@ -0,0 +1,369 @@
+/**
+ *
+ *  \file
+ *  \brief      Delivery of each sample to several consumers, each with its own
+ *              bounded queue and policy for when it falls behind.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_FAN_OUT_H
+#define UM6_FAN_OUT_H
+
+#include <semaphore.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+#include <string>
+
+#include "um6/cpu_accounting.h"
+#include "um6/trace.h"
+
+namespace um6
+{
+
+/**
+ * What a queue does with a new value when its consumer is a full queue behind.
+ */
+struct FanOutPolicy
+{
+  enum Type
+  {
+    /**
+     * Overwrite the oldest value; the consumer skips ahead. */
+    DROP_OLDEST,
+
+    /**
+     * Discard the new value. */
+    DROP_NEWEST,
+
+    /**
+     * Keep only the most recent value, which the consumer gets when it next
+     * looks. The queue's capacity is one. */
+    LATEST,
+
+    /**
+     * Wait up to a deadline for the consumer to make room, then discard the
+     * new value. */
+    BLOCK
+  };
+
+  /**
+   * Parses "drop_oldest", "drop_newest", "latest" or "block", returning false
+   * for anything else. */
+  static bool parse(const std::string& name, Type* policy);
+
+  static const char* name(Type policy);
+};
+
+/**
+ * Bounded single-producer, single-consumer queue, lock-free on both sides.
+ * Each slot carries a sequence number, written odd before the value and even
+ * after, so that under the overwriting policies a consumer can tell a value
+ * torn by the producer and skip past it. T must be safe to copy with memcpy
+ * semantics, as a torn copy is discarded rather than prevented.
+ */
+template<typename T>
+class FanOutQueue
+{
+public:
+  FanOutQueue(FanOutPolicy::Type policy, size_t capacity, double block_deadline)
+    : policy_(policy), capacity_(policy == FanOutPolicy::LATEST ? 1 : (capacity > 0 ? capacity : 1)),
+      block_deadline_ns_(static_cast<uint64_t>(block_deadline * 1e9)), slots_(new Slot[capacity_]),
+      head_(0), tail_(0), dropped_(0), max_lag_(0)
+  {
+    for (size_t i = 0; i < capacity_; i++) slots_[i].sequence.store(0, boost::memory_order_relaxed);
+  }
+
+  /**
+   * Producer side. Returns false if the value was discarded. */
+  bool push(const T& value)
+  {
+    uint64_t head = head_.load(boost::memory_order_relaxed);
+    if (policy_ == FanOutPolicy::DROP_NEWEST || policy_ == FanOutPolicy::BLOCK)
+    {
+      uint64_t deadline = 0;
+      while (head - tail_.load(boost::memory_order_acquire) >= capacity_)
+      {
+        if (policy_ == FanOutPolicy::DROP_NEWEST) return drop();
+        uint64_t now = traceClock();
+        if (deadline == 0) deadline = now + block_deadline_ns_;
+        else if (now >= deadline) return drop();
+        boost::this_thread::yield();
+      }
+    }
+
+    Slot& slot = slots_[head % capacity_];
+    slot.sequence.store(2 * head + 1, boost::memory_order_relaxed);
+    boost::atomic_thread_fence(boost::memory_order_release);
+    slot.value = value;
+    slot.sequence.store(2 * head + 2, boost::memory_order_release);
+    head_.store(head + 1, boost::memory_order_release);
+
+    uint64_t lag = head + 1 - tail_.load(boost::memory_order_relaxed);
+    if (lag > max_lag_.load(boost::memory_order_relaxed)) max_lag_.store(lag, boost::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * Consumer side. Copies out the next value, returning false if there is
+   * none. Values overwritten before they were read are counted as dropped. */
+  bool pop(T* value)
+  {
+    uint64_t tail = tail_.load(boost::memory_order_relaxed);
+    while (true)
+    {
+      uint64_t head = head_.load(boost::memory_order_acquire);
+      if (tail == head) return false;
+      if (head - tail > capacity_)
+      {
+        dropped_.fetch_add(head - tail - capacity_, boost::memory_order_relaxed);
+        tail = head - capacity_;
+      }
+
+      const Slot& slot = slots_[tail % capacity_];
+      uint64_t sequence = slot.sequence.load(boost::memory_order_acquire);
+      if (sequence == 2 * tail + 2)
+      {
+        *value = slot.value;
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        if (slot.sequence.load(boost::memory_order_relaxed) == sequence)
+        {
+          tail_.store(tail + 1, boost::memory_order_release);
+          return true;
+        }
+      }
+      // Overwritten while we looked; the producer has moved on, so go again from its new head.
+      dropped_.fetch_add(1, boost::memory_order_relaxed);
+      tail++;
+      tail_.store(tail, boost::memory_order_release);
+    }
+  }
+
+  FanOutPolicy::Type policy() const
+  {
+    return policy_;
+  }
+
+  size_t capacity() const
+  {
+    return capacity_;
+  }
+
+  /**
+   * Values pushed but not yet consumed, including any about to be found
+   * overwritten. */
+  uint64_t lag() const
+  {
+    return head_.load(boost::memory_order_relaxed) - tail_.load(boost::memory_order_relaxed);
+  }
+
+  /**
+   * Greatest lag seen by the producer since the queue was created. */
+  uint64_t maxLag() const
+  {
+    return max_lag_.load(boost::memory_order_relaxed);
+  }
+
+  uint64_t dropped() const
+  {
+    return dropped_.load(boost::memory_order_relaxed);
+  }
+
+  uint64_t pushed() const
+  {
+    return head_.load(boost::memory_order_relaxed);
+  }
+
+private:
+  bool drop()
+  {
+    dropped_.fetch_add(1, boost::memory_order_relaxed);
+    return false;
+  }
+
+  struct Slot
+  {
+    boost::atomic<uint64_t> sequence;
+    T value;
+  };
+
+  const FanOutPolicy::Type policy_;
+  const size_t capacity_;
+  const uint64_t block_deadline_ns_;
+  boost::scoped_array<Slot> slots_;
+  boost::atomic<uint64_t> head_;
+  boost::atomic<uint64_t> tail_;
+  boost::atomic<uint64_t> dropped_;
+  boost::atomic<uint64_t> max_lag_;
+};
+
+/**
+ * Hands each value from one producer thread to any number of consumers, each
+ * called back on a thread of its own through its own FanOutQueue, so that a
+ * slow consumer only ever holds up itself. The producer never locks; it only
+ * posts a semaphore to wake each consumer.
+ */
+template<typename T>
+class FanOut
+{
+public:
+  typedef boost::function<void(const T&)> Callback;
+
+  FanOut() : running_(false)
+  {}
+
+  ~FanOut()
+  {
+    stop();
+  }
+
+  /**
+   * Adds a consumer, returning its index. All consumers must be added before
+   * start. */
+  size_t add(const std::string& name, const Callback& callback, FanOutPolicy::Type policy,
+             size_t capacity, double block_deadline = 0.0)
+  {
+    consumers_.push_back(new Consumer(name, callback, policy, capacity, block_deadline));
+    return consumers_.size() - 1;
+  }
+
+  void start()
+  {
+    if (running_) return;
+    running_ = true;
+    for (size_t i = 0; i < consumers_.size(); i++)
+    {
+      consumers_[i].stopping.store(false, boost::memory_order_relaxed);
+      consumers_[i].thread = boost::thread(&FanOut::consume, &consumers_[i]);
+      consumers_[i].handle = consumers_[i].thread.native_handle();
+    }
+  }
+
+  /**
+   * Delivers every value already queued, then stops the consumer threads. */
+  void stop()
+  {
+    if (!running_) return;
+    for (size_t i = 0; i < consumers_.size(); i++)
+    {
+      consumers_[i].stopping.store(true, boost::memory_order_release);
+      sem_post(&consumers_[i].wake);
+    }
+    for (size_t i = 0; i < consumers_.size(); i++)
+    {
+      consumers_[i].thread.join();
+    }
+    running_ = false;
+  }
+
+  void push(const T& value)
+  {
+    for (size_t i = 0; i < consumers_.size(); i++)
+    {
+      if (consumers_[i].queue.push(value)) sem_post(&consumers_[i].wake);
+    }
+  }
+
+  size_t size() const
+  {
+    return consumers_.size();
+  }
+
+  const std::string& name(size_t consumer) const
+  {
+    return consumers_[consumer].name;
+  }
+
+  const FanOutQueue<T>& queue(size_t consumer) const
+  {
+    return consumers_[consumer].queue;
+  }
+
+  /**
+   * CPU time consumed so far by a consumer's thread, in nanoseconds, or zero
+   * while stopped. */
+  uint64_t cpuNanoseconds(size_t consumer) const
+  {
+    if (!running_) return 0;
+    return CpuAccounting::threadCpuNanoseconds(consumers_[consumer].handle);
+  }
+
+private:
+  struct Consumer
+  {
+    Consumer(const std::string& name, const Callback& callback, FanOutPolicy::Type policy,
+             size_t capacity, double block_deadline)
+      : name(name), callback(callback), queue(policy, capacity, block_deadline), stopping(false)
+    {
+      sem_init(&wake, 0, 0);
+    }
+
+    ~Consumer()
+    {
+      sem_destroy(&wake);
+    }
+
+    std::string name;
+    Callback callback;
+    FanOutQueue<T> queue;
+    sem_t wake;
+    boost::atomic<bool> stopping;
+    boost::thread thread;
+    pthread_t handle;
+  };
+
+  static void consume(Consumer* consumer)
+  {
+    T value;
+    while (true)
+    {
+      sem_wait(&consumer->wake);
+      while (consumer->queue.pop(&value)) consumer->callback(value);
+      if (consumer->stopping.load(boost::memory_order_acquire))
+      {
+        while (consumer->queue.pop(&value)) consumer->callback(value);
+        return;
+      }
+    }
+  }
+
+  boost::ptr_vector<Consumer> consumers_;
+  bool running_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_FAN_OUT_H
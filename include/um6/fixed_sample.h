@@ -0,0 +1,157 @@
+/**
+ *
+ *  \file
+ *  \brief      Fixed-point decode, frame conversion and filtering, for targets
+ *              without a floating-point unit.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_FIXED_SAMPLE_H
+#define UM6_FIXED_SAMPLE_H
+
+#include <stdint.h>
+
+#include "um6/sample.h"
+
+namespace um6
+{
+
+class Registers;
+
+/**
+ * Signed Q16.16: 16 integer bits, 16 fractional bits. Every int16 channel of
+ * the UM6 fits once scaled to SI units, the largest being the gyro at just
+ * under 35 rad/s. */
+typedef int32_t q16_t;
+
+const int Q16_SHIFT = 16;
+
+/**
+ * Multipliers from raw register counts to Q16.16, each being the scale
+ * factor Registers applies, in SI units, times 2^32. Shifting the 64-bit
+ * product down by 16 bits leaves Q16.16 with the scale factor accurate to
+ * better than one part per million.
+ */
+struct FixedScale
+{
+  static const int32_t GYRO = 4575279;   // 0.0610352 deg/s
+  static const int32_t ACCEL = 786430;   // 0.000183105 g
+  static const int32_t MAG = 1310721;    // 0.000305176 (unitless)
+  static const int32_t EULER = 823548;   // 0.0109863 deg
+  static const int32_t QUAT = 144179;    // 0.0000335693 (unitless)
+};
+
+/**
+ * Scales a raw register value to Q16.16, rounding to nearest. */
+inline q16_t toQ16(int16_t raw, int32_t multiplier)
+{
+  return static_cast<q16_t>((static_cast<int64_t>(raw) * multiplier + (1 << (Q16_SHIFT - 1))) >> Q16_SHIFT);
+}
+
+inline double fromQ16(q16_t value)
+{
+  return value * (1.0 / (1 << Q16_SHIFT));
+}
+
+/**
+ * Integer-only counterpart to Sample, for the decode and filtering stages on
+ * processors where double-precision maths is costly. Channels are in the same
+ * units and ENU frame as Sample, as Q16.16. The temperature and covariance
+ * registers are floats on the wire, so are carried through untouched.
+ */
+struct FixedSample
+{
+  /**
+   * Every channel but the temperature. */
+  enum { NUM_CHANNELS = Sample::TEMPERATURE };
+
+  uint64_t stamp_ns;
+
+  q16_t channel[NUM_CHANNELS];
+
+  float temperature;
+
+  float orientation_covariance[9];
+};
+
+/**
+ * Populates a FixedSample from the data registers of the UM6, without any
+ * floating-point arithmetic.
+ */
+void decodeFixedSample(const Registers& r, uint64_t stamp_ns, FixedSample* sample);
+
+/**
+ * Converts to a Sample, the only step of the fixed-point path which uses
+ * floating point. Intended to be done just before messages are constructed.
+ */
+void toSample(const FixedSample& fixed, Sample* sample);
+
+/**
+ * First-order low-pass filter over the gyro, accelerometer and magnetometer
+ * channels of a FixedSample, with a smoothing factor of 2^-shift. The
+ * orientation channels are left alone, as the Euler angles wrap and the
+ * quaternion would lose its norm. The state is kept shifted up, so that
+ * truncation doesn't bias the output; shift is limited to 8 so that it fits
+ * in 32 bits.
+ */
+class FixedLowPass
+{
+public:
+  explicit FixedLowPass(int shift);
+
+  /**
+   * Filters the sample in place. The first sample passes through unchanged
+   * and initialises the filter. */
+  void filter(FixedSample* sample);
+
+  void reset()
+  {
+    primed_ = false;
+  }
+
+  int shift() const
+  {
+    return shift_;
+  }
+
+  static const int MAX_SHIFT = 8;
+
+private:
+  enum { FIRST = Sample::GYRO_X, LAST = Sample::MAG_Z };
+
+  int shift_;
+  bool primed_;
+  int32_t state_[LAST - FIRST + 1];
+};
+
+}  // namespace um6
+
+#endif  // UM6_FIXED_SAMPLE_H
@@ -0,0 +1,137 @@
+/**
+ *
+ *  \file
+ *  \brief      FlightRecorder class definition. Keeps a lock-free ring of the most
+ *              recent packets and events, which can be dumped to disk after a fault.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_FLIGHT_RECORDER_H
+#define UM6_FLIGHT_RECORDER_H
+
+#include <limits.h>
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <string>
+
+namespace um6
+{
+
+/**
+ * Fixed-size ring of raw packets and events. Recording claims a slot with a
+ * single atomic increment and copies the bytes in; nothing is allocated or
+ * locked, so it's cheap enough to leave on permanently. Each slot carries a
+ * sequence number, so that a dump can run concurrently with recording (or
+ * from a signal handler which interrupted it) and simply skip any slot which
+ * was being overwritten as it was read.
+ */
+class FlightRecorder
+{
+public:
+  enum RecordType
+  {
+    RX_PACKET,
+    RX_BAD_CHECKSUM,
+    RX_JUNK,
+    TX_PACKET,
+    EVENT
+  };
+
+  /**
+   * Largest payload kept per record; enough for any UM6 packet. Longer data,
+   * such as a long run of junk, is truncated. */
+  static const size_t MAX_PAYLOAD = 72;
+
+  /**
+   * The ring holds capacity records, of which dumps include only those from
+   * the last window seconds. Dumps from signal handlers go to default_path.
+   */
+  FlightRecorder(size_t capacity, double window, const std::string& default_path);
+
+  void record(RecordType type, const void* data, size_t length);
+
+  void event(const std::string& text)
+  {
+    record(EVENT, text.data(), text.length());
+  }
+
+  /**
+   * Writes the recent records as text to a temporary file, then renames it to
+   * path, so that a reader never sees a partial dump. Only async-signal-safe
+   * calls are made. Returns false if the file couldn't be written.
+   */
+  bool dump(const char* path) const;
+
+  bool dump() const
+  {
+    return dump(default_path_);
+  }
+
+  const char* defaultPath() const
+  {
+    return default_path_;
+  }
+
+  /**
+   * Resolves a file name given by a dump request to a path in the directory of
+   * the default path, so that a request can't write anywhere else. An empty
+   * name gives the default path. Returns false if name isn't a plain file name.
+   */
+  bool requestPath(const std::string& name, std::string* path) const;
+
+  /**
+   * Dumps the given recorder to its default path on SIGSEGV, SIGABRT, SIGBUS
+   * or SIGFPE, before letting the signal take its usual course.
+   */
+  static void installSignalHandlers(FlightRecorder* recorder);
+
+private:
+  struct Record
+  {
+    boost::atomic<uint32_t> sequence;
+    uint8_t type;
+    uint8_t length;
+    uint64_t stamp_ns;
+    uint8_t data[MAX_PAYLOAD];
+  };
+
+  boost::scoped_array<Record> records_;
+  size_t capacity_;
+  boost::atomic<uint32_t> next_;
+  uint64_t window_ns_;
+  char default_path_[PATH_MAX];
+};
+
+}  // namespace um6
+
+#endif  // UM6_FLIGHT_RECORDER_H
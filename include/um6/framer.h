@@ -0,0 +1,112 @@
+/**
+ *
+ *  \file
+ *  \brief      Framer class definition. Frames UM6 packets out of an in-memory
+ *              byte buffer, for offline processing of recorded streams.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_FRAMER_H
+#define UM6_FRAMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace um6
+{
+
+class Registers;
+
+/**
+ * Reproduces the packet framing of Comms::receive, but over a buffer rather
+ * than a live serial port. It performs the same optimistic header read and the
+ * same bounded search for a start-of-packet sequence, so that a recorded byte
+ * stream yields exactly the packets which the driver would have seen.
+ */
+class Framer
+{
+public:
+  Framer() : packets_(0), bad_checksums_(0), resyncs_(0), junk_bytes_(0)
+  {
+  }
+
+  /**
+   * Returned by parse when the buffer ends before the packet does. On a live
+   * port, this is the case in which Comms::receive would wait, and perhaps
+   * time out. */
+  static const int16_t NEED_MORE;
+
+  /**
+   * Maximum number of bytes which Comms::receive will search for a header.
+   */
+  static const size_t SEARCH_LENGTH;
+
+  /**
+   * Parses one packet from the start of data. Return values are as for
+   * Comms::receive: the register address of a good packet, or -1 if a packet
+   * was discarded or no header was found. Otherwise, returns NEED_MORE and
+   * consumes nothing. Data of good packets is written to registers, if given.
+   */
+  int16_t parse(const uint8_t* data, size_t length, size_t* consumed, Registers* registers = NULL);
+
+  uint64_t packets() const
+  {
+    return packets_;
+  }
+
+  uint64_t badChecksums() const
+  {
+    return bad_checksums_;
+  }
+
+  /**
+   * Number of times a header had to be searched for, rather than being found
+   * immediately after the preceding packet. */
+  uint64_t resyncs() const
+  {
+    return resyncs_;
+  }
+
+  uint64_t junkBytes() const
+  {
+    return junk_bytes_;
+  }
+
+private:
+  uint64_t packets_;
+  uint64_t bad_checksums_;
+  uint64_t resyncs_;
+  uint64_t junk_bytes_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_FRAMER_H
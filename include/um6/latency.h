@@ -0,0 +1,258 @@
+/**
+ *
+ *  \file
+ *  \brief      Per-stage latency histograms and traces for the driver's receive cycle.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_LATENCY_H
+#define UM6_LATENCY_H
+
+#include <stdint.h>
+
+#include <ostream>
+#include <vector>
+
+namespace um6
+{
+
+/**
+ * Histogram of nanosecond durations in the style of HdrHistogram: buckets are
+ * exact below 128ns, and above that each power of two is split into 64
+ * buckets, so any recorded value is reported to within 1.6%. Values beyond
+ * about 36.6 minutes (2^41ns) are clamped.
+ */
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void record(uint64_t ns);
+  void merge(const LatencyHistogram& other);
+  void reset();
+
+  uint64_t count() const
+  {
+    return count_;
+  }
+
+  uint64_t min() const;
+  uint64_t max() const
+  {
+    return max_;
+  }
+  double mean() const;
+
+  /**
+   * Returns the smallest value which at least the given percentage of
+   * recorded values were less than or equal to, to the bucket's precision. */
+  uint64_t percentile(double percent) const;
+
+  static size_t bucketIndex(uint64_t ns);
+  static uint64_t bucketLowest(size_t index);
+  static uint64_t bucketHighest(size_t index);
+
+  static const int SUB_BUCKET_BITS = 7;
+  static const size_t BUCKET_COUNT;
+
+private:
+  std::vector<uint64_t> counts_;
+  uint64_t count_;
+  uint64_t min_;
+  uint64_t max_;
+  double total_;
+};
+
+/**
+ * Collects a monotonic timestamp at each stage boundary of a receive cycle,
+ * from the first packet of a broadcast group arriving to the end of the
+ * callback spin which follows publishing. Each stage's duration goes into
+ * its own histogram, and the most recent cycles are optionally kept whole
+ * so they can be exported for chrome://tracing or Perfetto.
+ */
+class LatencyTracer
+{
+public:
+  enum Mark
+  {
+    FIRST_PACKET,  // First packet of the group parsed.
+    LAST_PACKET,   // Final (trigger) packet of the group parsed.
+    DECODED,       // Registers scaled and converted into a sample.
+    PUBLISHED,     // Messages handed to roscpp.
+    LOGGED,        // Sample written to the archive and register log.
+    SPUN,          // Pending callbacks serviced.
+    NUM_MARKS
+  };
+
+  static const int NUM_STAGES = NUM_MARKS - 1;
+
+  /**
+   * Keeps the last trace_capacity cycles for export; zero keeps only the
+   * histograms. */
+  explicit LatencyTracer(size_t trace_capacity = 0);
+
+  /**
+   * Stamps the given boundary of the current cycle with the current time.
+   * Marking FIRST_PACKET starts a new cycle, and marking SPUN completes it;
+   * a cycle which is not completed is discarded when the next one starts.
+   */
+  void mark(Mark m);
+
+  /**
+   * As for mark(), with a timestamp from traceClock() taken by the caller.
+   */
+  void mark(Mark m, uint64_t ns);
+
+  bool inCycle() const
+  {
+    return in_cycle_;
+  }
+
+  /**
+   * Discards the current cycle, if any, such as one whose trigger packet was
+   * lost, so that its stamps aren't carried into the next. */
+  void abandon()
+  {
+    in_cycle_ = false;
+  }
+
+  /**
+   * Stage n runs from mark n to mark n + 1. The last stage is the total. */
+  const LatencyHistogram& histogram(int stage) const
+  {
+    return histograms_[stage];
+  }
+
+  const LatencyHistogram& total() const
+  {
+    return histograms_[NUM_STAGES];
+  }
+
+  static const char* stageName(int stage);
+
+  /**
+   * Writes count, mean and percentiles for each stage, one per line. */
+  void writeSummary(std::ostream& out) const;
+
+  /**
+   * Writes the kept cycles as a Chrome trace event JSON document, with one
+   * complete ("X") event per stage. Times are microseconds of the monotonic
+   * clock. */
+  void writeChromeTrace(std::ostream& out) const;
+
+  void reset();
+
+private:
+  struct Trace
+  {
+    uint64_t stamp[NUM_MARKS];
+  };
+
+  std::vector<Trace> traces_;
+  size_t next_trace_;
+  size_t trace_count_;
+  Trace current_;
+  bool in_cycle_;
+  LatencyHistogram histograms_[NUM_STAGES + 1];
+};
+
+/**
+ * Time from each channel of the broadcast group arriving to its data being
+ * published, so that the wait for the rest of the cycle is visible channel by
+ * channel, along with what publishing a channel ahead of its cycle saves.
+ * A channel sent in several packets arrives with the last of them.
+ */
+class ChannelLatency
+{
+public:
+  enum Channel
+  {
+    GYRO,
+    ACCEL,
+    MAG,
+    EULER,
+    QUAT,
+    COVARIANCE,
+    TEMPERATURE,
+    NUM_CHANNELS
+  };
+
+  ChannelLatency();
+
+  /**
+   * Notes the arrival of the packet at the given address, returning its
+   * channel, or -1 for a packet outside the broadcast group. */
+  int arrived(int16_t address, uint64_t ns);
+
+  /**
+   * The given channel went out ahead of its cycle. */
+  void publishedEarly(Channel channel, uint64_t ns);
+
+  /**
+   * The cycle went out, with every channel which arrived since the last. */
+  void published(uint64_t ns);
+
+  /**
+   * Forgets the arrivals of a cycle which won't complete, such as after a
+   * reconnect, keeping the histograms. */
+  void discard();
+
+  const LatencyHistogram& cycle(int channel) const
+  {
+    return cycle_[channel];
+  }
+
+  const LatencyHistogram& early(int channel) const
+  {
+    return early_[channel];
+  }
+
+  static int channelOf(int16_t address);
+  static const char* channelName(int channel);
+
+  /**
+   * Writes the wait of each channel which has arrived, one per line, and for
+   * those published early, that latency and the mean saved. */
+  void writeSummary(std::ostream& out) const;
+
+  void reset();
+
+private:
+  uint64_t arrival_[NUM_CHANNELS];
+  bool pending_[NUM_CHANNELS];
+  bool pending_early_[NUM_CHANNELS];
+  LatencyHistogram cycle_[NUM_CHANNELS];
+  LatencyHistogram early_[NUM_CHANNELS];
+};
+
+}  // namespace um6
+
+#endif  // UM6_LATENCY_H
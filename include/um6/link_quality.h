@@ -0,0 +1,168 @@
+/**
+ *
+ *  \file
+ *  \brief      Link quality estimate and baud rate fallback policy.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_LINK_QUALITY_H
+#define UM6_LINK_QUALITY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "um6/comms.h"
+
+namespace um6
+{
+
+/**
+ * Returns the communication register's code for a baud rate, or -1 if the
+ * UM6 doesn't support it. */
+int baudRateCode(uint32_t baud);
+
+/**
+ * Finds the communication register's broadcast rate field for the highest
+ * rate at which a cycle of bytes_per_cycle uses no more than the given
+ * fraction of the link, assuming ten bits on the wire per byte. Returns false,
+ * with the field for the slowest rate, if even that rate doesn't fit. */
+bool broadcastRateField(uint32_t baud, size_t bytes_per_cycle, double utilisation, uint8_t* field);
+
+/**
+ * Broadcast frequency in Hz for a broadcast rate field. */
+double broadcastRateHz(uint8_t field);
+
+/**
+ * Running estimate of how well packets are getting through, from the Comms
+ * counters, smoothed exponentially over roughly time_constant seconds. Quality
+ * is the fraction of packet starts which yield a good packet: each bad
+ * checksum and each resync counts against it, and an interval with only
+ * timeouts counts as zero.
+ */
+class LinkQuality
+{
+public:
+  explicit LinkQuality(double time_constant = 5.0);
+
+  /**
+   * Starts again from a perfect link, such as after a reconnect or baud
+   * change. */
+  void reset(const Comms::Counters& counters, double now);
+
+  /**
+   * Carries on from previously saved estimates, after a reset. */
+  void restore(double quality, double junk_rate, double resync_rate);
+
+  void update(const Comms::Counters& counters, double now);
+
+  double quality() const
+  {
+    return quality_;
+  }
+
+  double junkBytesPerSecond() const
+  {
+    return junk_rate_;
+  }
+
+  double resyncsPerSecond() const
+  {
+    return resync_rate_;
+  }
+
+private:
+  double time_constant_;
+  double quality_;
+  double junk_rate_;
+  double resync_rate_;
+  Comms::Counters last_;
+  double last_time_;
+};
+
+/**
+ * Decides when to step the baud rate down a ladder of rates, and when to
+ * probe back up. A step down follows quality staying below the threshold for
+ * hold seconds. After probe_interval seconds of good quality at a lower rate,
+ * the next rate up is tried; if that fails, the wait before the next probe
+ * doubles, up to eight times the interval.
+ */
+class BaudController
+{
+public:
+  /**
+   * Rates are tried in the order given, which should be fastest first. */
+  BaudController(const std::vector<uint32_t>& rates, double threshold, double hold, double probe_interval);
+
+  /**
+   * Restarts at the given rate, which is taken to be known-good. */
+  void reset(uint32_t baud, double now);
+
+  /**
+   * Returns the baud rate to switch to, or zero to stay at the current one. */
+  uint32_t update(double quality, double now);
+
+  /**
+   * Called when the link is lost. A probe which was underway has failed, and
+   * makes the next one wait longer, as if quality had dropped. */
+  void linkLost();
+
+  uint32_t current() const
+  {
+    return rates_[index_];
+  }
+
+  double probeInterval() const
+  {
+    return probe_interval_;
+  }
+
+  /**
+   * Restores the wait before the next probe, as backed off by failed probes.
+   * It is kept within the range the controller would itself reach. */
+  void setProbeInterval(double probe_interval);
+
+private:
+  std::vector<uint32_t> rates_;
+  double threshold_;
+  double hold_;
+  double base_probe_interval_;
+  double probe_interval_;
+  size_t index_;
+  double last_change_;
+  double below_since_;
+  bool probing_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_LINK_QUALITY_H
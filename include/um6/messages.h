@@ -0,0 +1,101 @@
+/**
+ *
+ *  \file
+ *  \brief      Construction of the ROS messages the driver publishes, from a
+ *              decoded sample.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_MESSAGES_H
+#define UM6_MESSAGES_H
+
+#include "geometry_msgs/Vector3Stamped.h"
+#include "sensor_msgs/Imu.h"
+#include "std_msgs/Float32.h"
+#include "std_msgs/Header.h"
+#include "um6/ChannelStats.h"
+#include "um6/ImuEvent.h"
+
+#include "um6/event_detector.h"
+#include "um6/sample.h"
+#include "um6/windowed_stats.h"
+
+namespace um6
+{
+
+/**
+ * Settings which shape the messages but aren't carried by the sample.
+ */
+struct MessageConfig
+{
+  MessageConfig() : angular_velocity_covariance(0), linear_acceleration_covariance(0)
+  {}
+
+  /**
+   * Diagonal noise covariances, left unknown (zero) unless configured. */
+  double angular_velocity_covariance;
+  double linear_acceleration_covariance;
+};
+
+/**
+ * Orientation, angular velocity and linear acceleration, for imu/data. */
+void imuMessage(const Sample& s, const std_msgs::Header& header, const MessageConfig& config,
+                sensor_msgs::Imu* msg);
+
+/**
+ * Magnetometer vector, for imu/mag. */
+void magMessage(const Sample& s, const std_msgs::Header& header, geometry_msgs::Vector3Stamped* msg);
+
+/**
+ * Roll, pitch and yaw, for imu/rpy. */
+void rpyMessage(const Sample& s, const std_msgs::Header& header, geometry_msgs::Vector3Stamped* msg);
+
+/**
+ * Temperature in degrees Celsius, for imu/temperature. */
+void temperatureMessage(const Sample& s, std_msgs::Float32* msg);
+
+/**
+ * Angular velocity straight from the gyro registers, unfiltered, for
+ * imu/rate as soon as the gyro packet arrives. */
+void rateMessage(const Registers& r, const std_msgs::Header& header, geometry_msgs::Vector3Stamped* msg);
+
+/**
+ * Statistics of every channel over the last window closed, for imu/stats.
+ * The header's stamp is replaced with the start of the window. */
+void channelStatsMessage(const WindowedStats& stats, const std_msgs::Header& header, ChannelStats* msg);
+
+/**
+ * A detected shock or rotation, for imu/events. */
+void imuEventMessage(const EventDetector::Event& event, const std_msgs::Header& header, ImuEvent* msg);
+
+}  // namespace um6
+
+#endif  // UM6_MESSAGES_H
@@ -0,0 +1,132 @@
+/**
+ *
+ *  \file
+ *  \brief      Driver metrics, served in Prometheus text format over a Unix socket.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_METRICS_H
+#define UM6_METRICS_H
+
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+namespace um6
+{
+
+/**
+ * Fixed set of named values, updated by the driver thread and rendered by
+ * another. Each value is a single atomic word, so updates and reads never
+ * lock or wait on each other; a render may mix values from either side of an
+ * update, which is expected of a scrape.
+ *
+ * All metrics must be added before rendering starts on another thread.
+ */
+class Metrics
+{
+public:
+  enum Type
+  {
+    COUNTER,
+    GAUGE,
+    SUMMARY
+  };
+
+  Metrics();
+  ~Metrics();
+
+  /**
+   * Adds a metric, returning the id with which to set it. Metrics which share
+   * a name but differ in labels (given without braces, as `stage="decode"`)
+   * should be added consecutively, and the help and type of the first is used
+   * for all of them.
+   */
+  size_t add(const std::string& name, const std::string& labels, Type type, const std::string& help);
+
+  void set(size_t id, double value)
+  {
+    values_[id]->store(value, boost::memory_order_relaxed);
+  }
+
+  double get(size_t id) const
+  {
+    return values_[id]->load(boost::memory_order_relaxed);
+  }
+
+  /**
+   * Appends all metrics in the Prometheus text exposition format. */
+  void render(std::string* out) const;
+
+private:
+  struct Info
+  {
+    std::string name;
+    std::string labels;
+    Type type;
+    std::string help;
+  };
+
+  std::vector<Info> info_;
+  std::vector<boost::atomic<double>*> values_;
+};
+
+/**
+ * Serves rendered metrics on a Unix domain socket, from its own thread. A
+ * client which sends an HTTP request, such as `curl --unix-socket`, gets an
+ * HTTP response; one which sends nothing, such as `socat`, gets plain text.
+ */
+class MetricsServer
+{
+public:
+  /**
+   * Replaces any stale socket at path and starts serving. Throws
+   * std::runtime_error if the socket can't be bound. */
+  MetricsServer(const Metrics* metrics, const std::string& path);
+  ~MetricsServer();
+
+private:
+  void serve();
+  void respond(int fd);
+
+  const Metrics* metrics_;
+  std::string path_;
+  int listen_fd_;
+  boost::atomic<bool> stopping_;
+  boost::thread thread_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_METRICS_H
@@ -0,0 +1,165 @@
+/**
+ *
+ *  \file
+ *  \brief      Streaming compression of register-frame logs, using per-channel
+ *              delta coding, zig-zag and bit packing, with periodic keyframes.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_REGISTER_LOG_H
+#define UM6_REGISTER_LOG_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace um6
+{
+
+class Registers;
+
+/**
+ * A register-frame log records a fixed, consecutive range of registers once
+ * per cycle. Each 32-bit register is treated as two 16-bit channels, which is
+ * the native layout of all the int16 data registers; float registers are
+ * carried the same way, losslessly if less compactly.
+ *
+ * A log is a stream header followed by frames. Delta frames carry the
+ * zig-zag encoded difference of every channel from the previous frame,
+ * bit-packed at the narrowest width which fits them all:
+ *
+ *   'D' | varint stamp delta (ns) | width | packed deltas
+ *
+ * Every keyframe_interval frames, a keyframe carries the channels verbatim,
+ * prefixed by a sync word, so that a reader can seek into the middle of a
+ * log and resynchronize:
+ *
+ *   sync (4) | frame number (4) | stamp ns (8) | channels (2 each) | checksum (2)
+ *
+ * All multi-byte fields are little-endian.
+ */
+struct RegisterLogHeader
+{
+  uint8_t first_register;
+  uint8_t register_count;
+  uint32_t keyframe_interval;
+
+  static const size_t SIZE;
+};
+
+class RegisterLogEncoder
+{
+public:
+  RegisterLogEncoder(uint8_t first_register, uint8_t register_count, uint32_t keyframe_interval = 100);
+
+  /**
+   * Appends the stream header to out. */
+  void header(std::string* out) const;
+
+  /**
+   * Appends one frame to out. Words are in network byte order, as returned by
+   * Registers::read_raw.
+   */
+  void encode(uint64_t stamp_ns, const uint32_t* words, std::string* out);
+
+  /**
+   * Convenience to capture and encode the logged range of a register array. */
+  void encode(uint64_t stamp_ns, const Registers& registers, std::string* out);
+
+  const RegisterLogHeader& config() const
+  {
+    return config_;
+  }
+
+private:
+  RegisterLogHeader config_;
+  uint32_t frame_;
+  uint64_t stamp_ns_;
+  std::vector<uint16_t> channels_;
+  std::vector<uint16_t> zigzag_;
+};
+
+class RegisterLogDecoder
+{
+public:
+  RegisterLogDecoder() : frame_(0), stamp_ns_(0), synced_(false)
+  {
+  }
+
+  /**
+   * Parses the stream header, returning the number of bytes consumed, or 0 if
+   * more data is required. Throws std::runtime_error if this is not a log.
+   */
+  size_t header(const uint8_t* data, size_t length);
+
+  /**
+   * Decodes one frame into words (register_count words, network byte order),
+   * returning the number of bytes consumed, or 0 if the frame is incomplete.
+   * Throws std::runtime_error on a corrupt frame; the caller can then seek to
+   * the next keyframe and carry on.
+   */
+  size_t decode(const uint8_t* data, size_t length, uint64_t* stamp_ns, uint32_t* words);
+
+  /**
+   * Discards delta state, so that decoding resumes at the next keyframe. */
+  void resync()
+  {
+    synced_ = false;
+  }
+
+  /**
+   * Returns the offset of the first intact keyframe at or after from, or
+   * length if there is none. Requires the stream header to have been parsed.
+   */
+  size_t findKeyframe(const uint8_t* data, size_t length, size_t from) const;
+
+  const RegisterLogHeader& config() const
+  {
+    return config_;
+  }
+
+  uint32_t frameNumber() const
+  {
+    return frame_;
+  }
+
+private:
+  RegisterLogHeader config_;
+  uint32_t frame_;
+  uint64_t stamp_ns_;
+  bool synced_;
+  std::vector<uint16_t> channels_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_REGISTER_LOG_H
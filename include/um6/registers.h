@@ -41,6 +41,9 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <boost/type_traits/is_integral.hpp>
+#include <algorithm>
+#include <limits>
 #include <stdexcept>
 #include <string>
 
@@ -132,7 +135,16 @@ public:
 
   double get_scaled(uint16_t field) const
   {
-    return get(field) * scale_;
+    return get_scaled_as<double>(field);
+  }
+
+  /**
+   * Scaled value in the given floating-point type, with both the register
+   * value and the scale factor converted before multiplying. */
+  template<typename T>
+  T get_scaled_as(uint16_t field) const
+  {
+    return static_cast<T>(get(field)) * static_cast<T>(scale_);
   }
 
   void set(uint8_t field, RegT value) const
@@ -141,9 +153,26 @@ public:
     memcpy_network(raw_ptr + field, &value, sizeof(value));
   }
 
+  /**
+   * Size of one count of the register, in the units of get_scaled. */
+  double scale() const
+  {
+    return scale_;
+  }
+
+  /**
+   * Sets a field from its scaled value, rounded to the nearest integer for an
+   * integer register so that get_scaled gives back the value set. A value
+   * beyond an integer register's range saturates at its limit. */
   void set_scaled(uint16_t field, double value) const
   {
-    set(field, value / scale_);
+    double unscaled = value / scale_;
+    if (boost::is_integral<RegT>::value)
+    {
+      unscaled = std::min<double>(floor(unscaled + 0.5), std::numeric_limits<RegT>::max());
+      unscaled = std::max<double>(unscaled, std::numeric_limits<RegT>::min());
+    }
+    set(field, unscaled);
   }
 
 private:
@@ -169,6 +198,9 @@ public:
     status(this, UM6_STATUS, 1),
     mag_ref(this, UM6_MAG_REF_X, 3),
     accel_ref(this, UM6_ACCEL_REF_X, 3),
+    ekf_mag_variance(this, UM6_EKF_MAG_VARIANCE, 1),
+    ekf_accel_variance(this, UM6_EKF_ACCEL_VARIANCE, 1),
+    ekf_process_variance(this, UM6_EKF_PROCESS_VARIANCE, 1),
     gyro_bias(this, UM6_GYRO_BIAS_XY, 3),
     accel_bias(this, UM6_ACCEL_BIAS_XY, 3),
     mag_bias(this, UM6_MAG_BIAS_XY, 3),
@@ -188,6 +220,7 @@ public:
   // Configs
   const Accessor<uint32_t> communication, misc_config, status;
   const Accessor<float> mag_ref, accel_ref;
+  const Accessor<float> ekf_mag_variance, ekf_accel_variance, ekf_process_variance;
   const Accessor<int16_t> gyro_bias, accel_bias, mag_bias;
 
   // Commands
@@ -196,13 +229,25 @@ public:
 
   void write_raw(uint8_t register_index, std::string data)
   {
-    if ((register_index - 1) + (data.length()/4 - 1) >= NUM_REGISTERS)
+    if (register_index + (data.length() + 3) / 4 > NUM_REGISTERS)
     {
       throw std::range_error("Index and length write beyond boundaries of register array.");
     }
     memcpy(&raw_[register_index], data.c_str(), data.length());
   }
 
+  /**
+   * Copies out consecutive registers exactly as they were received, that is,
+   * in network byte order. */
+  void read_raw(uint8_t register_index, uint8_t count, uint32_t* out) const
+  {
+    if (register_index + count > NUM_REGISTERS)
+    {
+      throw std::range_error("Index and length read beyond boundaries of register array.");
+    }
+    memcpy(out, &raw_[register_index], count * sizeof(uint32_t));
+  }
+
 private:
   uint32_t raw_[NUM_REGISTERS];
 
@@ -0,0 +1,170 @@
+/**
+ *
+ *  \file
+ *  \brief      Decoded representation of one complete UM6 broadcast cycle,
+ *              converted to SI units and the ROS (ENU) frame.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_SAMPLE_H
+#define UM6_SAMPLE_H
+
+namespace um6
+{
+
+class Registers;
+
+/**
+ * The channels of a sample, independent of its scalar type.
+ */
+struct SampleChannels
+{
+  enum Channel
+  {
+    GYRO_X, GYRO_Y, GYRO_Z,
+    ACCEL_X, ACCEL_Y, ACCEL_Z,
+    MAG_X, MAG_Y, MAG_Z,
+    ROLL, PITCH, YAW,
+    QUAT_X, QUAT_Y, QUAT_Z, QUAT_W,
+    TEMPERATURE,
+    NUM_CHANNELS
+  };
+
+  static const char* channelName(int channel);
+};
+
+/**
+ * One complete cycle of broadcast data, decoded out of the register array,
+ * scaled, and converted from the UM6's NED convention to ENU. This is the
+ * form in which data is handed to everything downstream of the register
+ * array: message construction, logging, statistics.
+ *
+ * The scalar type is either double, as the driver uses by default, or float,
+ * which halves the footprint and doubles the width of vectorised stages. Every
+ * channel value fits comfortably in a float's 24-bit significand, as the
+ * registers are 16-bit; the stamp stays a double either way.
+ */
+template<typename T>
+struct BasicSample : public SampleChannels
+{
+  typedef T Scalar;
+
+  /**
+   * Seconds since the epoch at which the cycle was completed. */
+  double stamp;
+
+  T channel[NUM_CHANNELS];
+
+  /**
+   * Row-major 3x3 xyz orientation covariance, from the device's 4x4 wxyz matrix. */
+  T orientation_covariance[9];
+};
+
+typedef BasicSample<double> Sample;
+typedef BasicSample<float> SampleF;
+
+/**
+ * Populates a sample from the data registers of the UM6. Instantiated for
+ * float and double.
+ */
+template<typename T>
+void decodeSample(const Registers& r, double stamp, BasicSample<T>* sample);
+
+/**
+ * Writes a sample back into the data registers, the inverse of decodeSample
+ * to within the registers' resolution, such as for an emulated device.
+ */
+void encodeSample(const Sample& sample, Registers* r);
+
+/**
+ * Converts a sample between scalar types.
+ */
+template<typename T, typename U>
+void convertSample(const BasicSample<U>& from, BasicSample<T>* to)
+{
+  to->stamp = from.stamp;
+  for (int i = 0; i < SampleChannels::NUM_CHANNELS; i++)
+  {
+    to->channel[i] = static_cast<T>(from.channel[i]);
+  }
+  for (int i = 0; i < 9; i++)
+  {
+    to->orientation_covariance[i] = static_cast<T>(from.orientation_covariance[i]);
+  }
+}
+
+/**
+ * First-order low-pass filter over the gyro, accelerometer and magnetometer
+ * channels of a sample, in the sample's own precision. As with FixedLowPass,
+ * the orientation channels are left alone.
+ */
+template<typename T>
+class LowPass
+{
+public:
+  explicit LowPass(T alpha) : alpha_(alpha), primed_(false)
+  {}
+
+  /**
+   * Filters the sample in place. The first sample passes through unchanged
+   * and initialises the filter. */
+  void filter(BasicSample<T>* sample)
+  {
+    T* x = sample->channel + FIRST;
+    if (!primed_)
+    {
+      for (int i = 0; i < COUNT; i++) state_[i] = x[i];
+      primed_ = true;
+      return;
+    }
+    for (int i = 0; i < COUNT; i++)
+    {
+      state_[i] += alpha_ * (x[i] - state_[i]);
+      x[i] = state_[i];
+    }
+  }
+
+  void reset()
+  {
+    primed_ = false;
+  }
+
+private:
+  enum { FIRST = SampleChannels::GYRO_X, COUNT = SampleChannels::MAG_Z - SampleChannels::GYRO_X + 1 };
+
+  T alpha_;
+  bool primed_;
+  T state_[COUNT];
+};
+
+}  // namespace um6
+
+#endif  // UM6_SAMPLE_H
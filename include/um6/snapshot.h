@@ -0,0 +1,155 @@
+/**
+ *
+ *  \file
+ *  \brief      Snapshots of what the driver has learned about a device and its
+ *              link, for a warm restart.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_SNAPSHOT_H
+#define UM6_SNAPSHOT_H
+
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <string>
+
+namespace um6
+{
+
+/**
+ * State the driver builds up while running, which would otherwise take
+ * minutes to reconverge after a restart: the baud rate the link settled on,
+ * how far probing back up has backed off, and the link quality estimate.
+ * The device it was learned from is recorded so that it is only restored
+ * for that same device.
+ */
+struct DriverSnapshot
+{
+  DriverSnapshot();
+
+  /**
+   * As returned by deviceIdentity. */
+  std::string device;
+
+  /**
+   * Wall-clock time of the snapshot, in nanoseconds since the epoch. */
+  uint64_t stamp_ns;
+
+  uint32_t baud;
+  double probe_interval;
+  double link_quality;
+  double junk_rate;
+  double resync_rate;
+};
+
+/**
+ * Writes a snapshot, stamped with the current time, to a freshly created
+ * temporary file beside path, syncs it, and renames it into place, so that a
+ * reader only ever sees a complete snapshot. Returns false on failure,
+ * leaving any previous snapshot in place.
+ */
+bool saveSnapshot(const std::string& path, const DriverSnapshot& snapshot);
+
+/**
+ * Reads a snapshot, returning false if the file is missing, of another
+ * version, or fails its checksum.
+ */
+bool loadSnapshot(const std::string& path, DriverSnapshot* snapshot);
+
+/**
+ * Seconds since the snapshot was taken, by the wall clock. Negative if its
+ * stamp is in the future, as after the clock has been stepped back.
+ */
+double snapshotAge(const DriverSnapshot& snapshot);
+
+/**
+ * Names the device behind a serial port, stable across reboots and
+ * re-enumeration: its entry in /dev/serial/by-id, which carries the USB
+ * adapter's serial number. Falls back to the port's resolved path if there
+ * is no such entry.
+ */
+std::string deviceIdentity(const std::string& port);
+
+/**
+ * Where a device's snapshots go unless configured otherwise: a file in
+ * $ROS_HOME, or ~/.ros without it, named for the device, so that drivers of
+ * different devices on one host don't overwrite each other's. Empty if
+ * neither directory is known.
+ */
+std::string defaultSnapshotPath(const std::string& device);
+
+/**
+ * Saves snapshots on a thread of its own, so that syncing them to disk never
+ * holds up the caller. Only the newest snapshot is kept: one still waiting
+ * when the next is handed over is replaced.
+ */
+class SnapshotWriter : private boost::noncopyable
+{
+public:
+  explicit SnapshotWriter(const std::string& path);
+
+  /**
+   * Saves any snapshot still waiting before returning. */
+  ~SnapshotWriter();
+
+  void save(const DriverSnapshot& snapshot);
+
+  /**
+   * Number of saves which have failed so far. */
+  uint64_t failures() const
+  {
+    return failures_.load(boost::memory_order_relaxed);
+  }
+
+  const std::string& path() const
+  {
+    return path_;
+  }
+
+private:
+  void writeLoop();
+
+  std::string path_;
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  DriverSnapshot pending_;
+  bool has_pending_;
+  bool stopping_;
+  boost::atomic<uint64_t> failures_;
+  boost::thread thread_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_SNAPSHOT_H
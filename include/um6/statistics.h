@@ -0,0 +1,147 @@
+/**
+ *
+ *  \file
+ *  \brief      Running statistics which can be accumulated incrementally and
+ *              merged, for summarizing channels of data.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_STATISTICS_H
+#define UM6_STATISTICS_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include <limits>
+
+namespace um6
+{
+
+/**
+ * Mean, variance and extremes of a stream of values, using Welford's
+ * update. Two instances accumulated over disjoint parts of a stream can be
+ * merged, giving the same result as if one had seen all of it.
+ *
+ * The accumulators are of type T. Float agrees with double to a few parts
+ * per million over ten thousand gyro-like values, but the variance drifts by
+ * around half a percent over a million, so long runs should stay in double.
+ */
+template<typename T>
+class BasicRunningStats
+{
+public:
+  BasicRunningStats()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    count_ = 0;
+    mean_ = 0;
+    m2_ = 0;
+    min_ = std::numeric_limits<T>::infinity();
+    max_ = -std::numeric_limits<T>::infinity();
+  }
+
+  void add(T value)
+  {
+    count_++;
+    T delta = value - mean_;
+    mean_ += delta / static_cast<T>(count_);
+    m2_ += delta * (value - mean_);
+    if (value < min_) min_ = value;
+    if (value > max_) max_ = value;
+  }
+
+  void merge(const BasicRunningStats& other)
+  {
+    if (other.count_ == 0) return;
+    if (count_ == 0)
+    {
+      *this = other;
+      return;
+    }
+    uint64_t count = count_ + other.count_;
+    T delta = other.mean_ - mean_;
+    mean_ += delta * static_cast<T>(other.count_) / static_cast<T>(count);
+    m2_ += other.m2_ + delta * delta * static_cast<T>(count_) * static_cast<T>(other.count_) / static_cast<T>(count);
+    count_ = count;
+    if (other.min_ < min_) min_ = other.min_;
+    if (other.max_ > max_) max_ = other.max_;
+  }
+
+  uint64_t count() const
+  {
+    return count_;
+  }
+
+  T mean() const
+  {
+    return mean_;
+  }
+
+  /**
+   * Sample variance; zero until there are at least two values. */
+  T variance() const
+  {
+    return count_ > 1 ? m2_ / static_cast<T>(count_ - 1) : T(0);
+  }
+
+  T stddev() const
+  {
+    return sqrt(variance());
+  }
+
+  T min() const
+  {
+    return min_;
+  }
+
+  T max() const
+  {
+    return max_;
+  }
+
+private:
+  uint64_t count_;
+  T mean_;
+  T m2_;
+  T min_;
+  T max_;
+};
+
+typedef BasicRunningStats<double> RunningStats;
+typedef BasicRunningStats<float> RunningStatsF;
+
+}  // namespace um6
+
+#endif  // UM6_STATISTICS_H
@@ -0,0 +1,149 @@
+/**
+ *
+ *  \file
+ *  \brief      Output of samples on a fixed-phase timer, independent of when
+ *              they arrive from the serial port.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef UM6_TIMED_OUTPUT_H
+#define UM6_TIMED_OUTPUT_H
+
+#include <stdint.h>
+
+#include <boost/thread/mutex.hpp>
+#include <string>
+
+#include "um6/sample.h"
+
+namespace um6
+{
+
+/**
+ * Holds the two most recent complete samples, written by the driver thread as
+ * each cycle completes and read by a thread publishing at fixed times. A read
+ * yields the newest sample, or one interpolated or extrapolated to the time
+ * asked for, along with the age of the newest data that went into it.
+ */
+class SampleHold
+{
+public:
+  enum Mode
+  {
+    /**
+     * The newest sample, unchanged and with its own stamp. */
+    LATEST,
+
+    /**
+     * Linear between the two newest samples when the time falls between
+     * them, otherwise the nearer of the two. */
+    INTERPOLATE,
+
+    /**
+     * As INTERPOLATE, but also projected linearly past the newest sample, by
+     * at most the configured limit. */
+    EXTRAPOLATE
+  };
+
+  explicit SampleHold(Mode mode, double max_extrapolation = 0.0);
+
+  void put(const Sample& sample);
+
+  /**
+   * Fills in the sample for a time, in seconds since the epoch, returning
+   * false if no sample has arrived yet. The age is that time less the stamp
+   * of the newest sample held, and is negative for a time before it. */
+  bool get(double stamp, Sample* sample, double* age) const;
+
+  /**
+   * Forgets the samples held, such as after a reconnect. */
+  void reset();
+
+  /**
+   * Parses "latest", "interpolate" or "extrapolate", returning false for
+   * anything else. */
+  static bool parseMode(const std::string& name, Mode* mode);
+
+private:
+  Mode mode_;
+  double max_extrapolation_;
+  mutable boost::mutex mutex_;
+  Sample previous_, newest_;
+  int count_;
+};
+
+/**
+ * Fills in the sample a fraction of the way from one sample to another, where
+ * a fraction above one extrapolates. Angles are taken the short way round, and
+ * the quaternion is normalised; the covariance is the later sample's.
+ */
+void blendSamples(const Sample& from, const Sample& to, double fraction, Sample* sample);
+
+/**
+ * Ticks at a fixed period and phase of CLOCK_REALTIME, so that ticks line up
+ * with those of other processes given the same period and phase, such as a
+ * control loop's. Sleeps with clock_nanosleep to absolute times, so that the
+ * error in one wait never carries into the next.
+ */
+class PhaseTimer
+{
+public:
+  /**
+   * Throws std::runtime_error for a zero period, or a phase not less than the
+   * period. */
+  PhaseTimer(uint64_t period_ns, uint64_t phase_ns);
+
+  /**
+   * The first tick strictly after a time. */
+  uint64_t next(uint64_t now_ns) const;
+
+  /**
+   * Sleeps until the tick after the last one returned, and returns its time
+   * in nanoseconds since the epoch. If that tick has already passed, skips to
+   * the next one still to come and counts those missed. */
+  uint64_t wait();
+
+  uint64_t missed() const
+  {
+    return missed_;
+  }
+
+  static uint64_t now();
+
+private:
+  uint64_t period_ns_;
+  uint64_t phase_ns_;
+  uint64_t last_;
+  uint64_t missed_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_TIMED_OUTPUT_H
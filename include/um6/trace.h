@@ -0,0 +1,115 @@
+/**
+ *
+ *  \file
+ *  \brief      Static (USDT) tracepoints for the packet and publish pipeline.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_TRACE_H
+#define UM6_TRACE_H
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Tracepoints are compiled in when <sys/sdt.h> is available, and cost a
+ * single nop until a tracer attaches to them, for example:
+ *
+ *   bpftrace -e 'usdt:/path/to/um6_driver:um6:checksum_bad { @[arg1] = count(); }'
+ *
+ * The first argument of every probe is CLOCK_MONOTONIC in nanoseconds, read
+ * only while a tracer is attached. Remaining arguments are listed with each
+ * probe below.
+ */
+#ifdef UM6_HAVE_SDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define UM6_TRACE_SEMAPHORE(name) \
+  extern "C" __extension__ volatile uint16_t um6_##name##_semaphore \
+  __attribute__((unused)) __attribute__((section(".probes")))
+
+#define UM6_TRACE_ENABLED(name) __builtin_expect(um6_##name##_semaphore, 0)
+
+#define UM6_TRACE0(name) \
+  do { if (UM6_TRACE_ENABLED(name)) DTRACE_PROBE1(um6, name, um6::traceClock()); } while (0)
+#define UM6_TRACE1(name, a) \
+  do { if (UM6_TRACE_ENABLED(name)) DTRACE_PROBE2(um6, name, um6::traceClock(), a); } while (0)
+#define UM6_TRACE2(name, a, b) \
+  do { if (UM6_TRACE_ENABLED(name)) DTRACE_PROBE3(um6, name, um6::traceClock(), a, b); } while (0)
+#define UM6_TRACE3(name, a, b, c) \
+  do { if (UM6_TRACE_ENABLED(name)) DTRACE_PROBE4(um6, name, um6::traceClock(), a, b, c); } while (0)
+
+#else
+
+#define UM6_TRACE_SEMAPHORE(name) struct um6_##name##_unused_semaphore
+#define UM6_TRACE_ENABLED(name) false
+#define UM6_TRACE0(name) do {} while (0)
+#define UM6_TRACE1(name, a) do {} while (0)
+#define UM6_TRACE2(name, a, b) do {} while (0)
+#define UM6_TRACE3(name, a, b, c) do {} while (0)
+
+#endif  // UM6_HAVE_SDT
+
+// Packet start found: type, address, junk bytes skipped to find it.
+UM6_TRACE_SEMAPHORE(header_found);
+// Checksum matched or did not: address, data length in bytes.
+UM6_TRACE_SEMAPHORE(checksum_ok);
+UM6_TRACE_SEMAPHORE(checksum_bad);
+// Received data copied into the register array: address, length in bytes.
+UM6_TRACE_SEMAPHORE(write_raw);
+// Serial read timed out before a full packet arrived: no arguments.
+UM6_TRACE_SEMAPHORE(receive_timeout);
+// Final packet of a broadcast group received: message stamp in nanoseconds.
+UM6_TRACE_SEMAPHORE(cycle_complete);
+// Message handed to roscpp: topic name, message stamp in nanoseconds.
+UM6_TRACE_SEMAPHORE(message_published);
+// Command written to the port: address, packet length in bytes.
+UM6_TRACE_SEMAPHORE(command_sent);
+// Command acknowledged by the device: address, attempt number.
+UM6_TRACE_SEMAPHORE(ack_received);
+// Shock or rotation detected ahead of its cycle: event type, magnitude in thousandths.
+UM6_TRACE_SEMAPHORE(event_detected);
+
+namespace um6
+{
+
+inline uint64_t traceClock()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+}  // namespace um6
+
+#endif  // UM6_TRACE_H
@@ -0,0 +1,210 @@
+/**
+ *
+ *  \file
+ *  \brief      Synthetic motion for an emulated device: scripted trajectories
+ *              and models of sensor noise and bias.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef UM6_TRAJECTORY_H
+#define UM6_TRAJECTORY_H
+
+#include <stdint.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <istream>
+#include <vector>
+
+#include "um6/sample.h"
+
+namespace um6
+{
+
+/**
+ * One stretch of a scripted trajectory, over which the motion is steady: a
+ * constant body rate, with vibration, a temperature ramp and a magnetic
+ * disturbance overlaid. A segment with nothing set is a stationary period.
+ */
+struct TrajectorySegment
+{
+  TrajectorySegment();
+
+  double duration;
+
+  /**
+   * Angular rate about the body's x, y and z axes, in rad/s. */
+  double rate[3];
+
+  /**
+   * Sinusoidal acceleration on each body axis, in g, at a frequency in Hz. */
+  double vibration_amplitude;
+  double vibration_frequency;
+
+  /**
+   * Change of temperature, in degrees C per second. */
+  double temperature_rate;
+
+  /**
+   * Added to the earth's field, in the world frame and the same normalised
+   * units as the magnetometer channels. */
+  double mag_disturbance[3];
+};
+
+/**
+ * Reads a trajectory script: one segment per line, as its duration in seconds
+ * followed by any of
+ *
+ *     rate=X,Y,Z  vibration=AMPLITUDE,FREQUENCY  temperature_rate=R  mag=X,Y,Z
+ *
+ * with # starting a comment. Throws std::runtime_error, naming the line, for
+ * anything it cannot parse.
+ */
+std::vector<TrajectorySegment> parseTrajectory(std::istream& in);
+
+/**
+ * Error model for one three-axis sensor, in the units of its channels. The
+ * bias is the starting bias on every axis, which then wanders as a random walk
+ * and moves with temperature away from the starting temperature.
+ */
+struct SensorNoise
+{
+  SensorNoise();
+
+  /**
+   * Standard deviation of the white noise on each reading. */
+  double white;
+
+  double bias;
+
+  /**
+   * Standard deviation of the bias's random walk after one second. */
+  double bias_walk;
+
+  /**
+   * Change of bias per degree C. */
+  double bias_temperature;
+};
+
+/**
+ * Error models for each sensor. The default is noiseless.
+ */
+struct NoiseModel
+{
+  NoiseModel();
+
+  SensorNoise gyro, accel, mag;
+
+  /**
+   * Standard deviation of the white noise on the temperature. */
+  double temperature;
+};
+
+/**
+ * Plays out a trajectory script, producing at each step the true state and
+ * what the device would measure of it. Orientation is integrated exactly
+ * within each segment, and the accelerometer and magnetometer readings follow
+ * from it, so that every channel agrees with every other. The orientation
+ * channels of the measurement are the true ones, as the device's own
+ * estimator is not emulated. Once the script has run out the device sits
+ * still.
+ */
+class TrajectoryGenerator
+{
+public:
+  TrajectoryGenerator(const std::vector<TrajectorySegment>& script, const NoiseModel& noise, uint32_t seed,
+                      double temperature = 25.0);
+
+  /**
+   * Advances by dt seconds, and fills in the true and measured samples at the
+   * new time, stamped with the seconds since the start. */
+  void step(double dt, Sample* truth, Sample* measured);
+
+  double time() const
+  {
+    return time_;
+  }
+
+  /**
+   * Total length of the script, in seconds. */
+  double duration() const;
+
+  bool finished() const
+  {
+    return time_ >= duration();
+  }
+
+  /**
+   * The bias on each axis of the gyro, accelerometer and magnetometer, as of
+   * the last step. */
+  const double* gyroBias() const
+  {
+    return bias_[GYRO];
+  }
+  const double* accelBias() const
+  {
+    return bias_[ACCEL];
+  }
+  const double* magBias() const
+  {
+    return bias_[MAG];
+  }
+
+private:
+  enum { GYRO, ACCEL, MAG, NUM_SENSORS };
+
+  void advance(double dt);
+  const TrajectorySegment& current() const;
+  double gaussian();
+
+  std::vector<TrajectorySegment> script_;
+  NoiseModel noise_;
+  boost::random::mt19937 random_;
+  boost::random::normal_distribution<double> normal_;
+
+  double time_;
+  size_t segment_;
+  double segment_start_;
+
+  /**
+   * Orientation of the body in the world frame, x, y, z, w. */
+  double q_[4];
+  double temperature_;
+  double start_temperature_;
+
+  /**
+   * The part of each bias which has wandered away from the starting bias. */
+  double walk_[NUM_SENSORS][3];
+  double bias_[NUM_SENSORS][3];
+};
+
+}  // namespace um6
+
+#endif  // UM6_TRAJECTORY_H
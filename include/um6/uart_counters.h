@@ -0,0 +1,92 @@
+/**
+ *
+ *  \file
+ *  \brief      Kernel UART error counters for the serial port.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#ifndef UM6_UART_COUNTERS_H
+#define UM6_UART_COUNTERS_H
+
+#include <stdint.h>
+
+#include <string>
+
+namespace um6
+{
+
+/**
+ * Reads the kernel's error counters for a serial port (TIOCGICOUNT). Bytes
+ * lost to these never reach userspace, and would otherwise show up only as
+ * bad checksums and resyncs. The port is opened a second time, read-only,
+ * alongside the driver's own connection; not every driver supports the
+ * counters, and pseudoterminals don't.
+ */
+class UartCounters
+{
+public:
+  struct Counts
+  {
+    uint32_t overrun;      // UART FIFO overrun.
+    uint32_t frame;        // Framing error, usually a baud mismatch or noise.
+    uint32_t parity;
+    uint32_t brk;          // Break condition.
+    uint32_t buf_overrun;  // Kernel tty buffer full.
+  };
+
+  explicit UartCounters(const std::string& port);
+  ~UartCounters();
+
+  /**
+   * Returns false if the port couldn't be opened, or its driver doesn't
+   * keep counters. */
+  bool read(Counts* counts) const;
+
+  bool supported() const
+  {
+    return supported_;
+  }
+
+  static const int NUM_COUNTS = 5;
+
+  /**
+   * Counts in the order of the struct, for iterating over. */
+  static uint32_t get(const Counts& counts, int index);
+  static const char* name(int index);
+
+private:
+  int fd_;
+  bool supported_;
+};
+
+}  // namespace um6
+
+#endif  // UM6_UART_COUNTERS_H
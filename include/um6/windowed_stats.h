@@ -0,0 +1,96 @@
+/**
+ *
+ *  \file
+ *  \brief      Statistics of every channel over tumbling windows of samples.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#ifndef UM6_WINDOWED_STATS_H
+#define UM6_WINDOWED_STATS_H
+
+#include "um6/sample.h"
+#include "um6/statistics.h"
+
+namespace um6
+{
+
+/**
+ * Mean, standard deviation and extremes of each channel over consecutive,
+ * non-overlapping windows of time, updated in O(1) per sample. Windows are
+ * aligned to whole multiples of their length since the epoch, so that every
+ * device's windows line up.
+ */
+class WindowedStats
+{
+public:
+  /**
+   * Throws std::runtime_error unless the window, in seconds, is positive. */
+  explicit WindowedStats(double window);
+
+  /**
+   * Adds a sample, first closing the window in progress if the sample falls
+   * outside it. Returns true when a window was closed, whose statistics are
+   * then those returned by channel. */
+  bool add(const Sample& sample);
+
+  /**
+   * Of the last window closed. */
+  const RunningStats& channel(int c) const
+  {
+    return closed_[c];
+  }
+
+  /**
+   * Start of the last window closed, in seconds since the epoch. */
+  double start() const
+  {
+    return closed_start_;
+  }
+
+  double window() const
+  {
+    return window_;
+  }
+
+  /**
+   * Discards the window in progress, such as after a reconnect. */
+  void reset();
+
+private:
+  double window_;
+  double start_;
+  double closed_start_;
+  RunningStats current_[Sample::NUM_CHANNELS];
+  RunningStats closed_[Sample::NUM_CHANNELS];
+};
+
+}  // namespace um6
+
+#endif  // UM6_WINDOWED_STATS_H
@@ -0,0 +1,312 @@
+/**
+ *
+ *  \file
+ *  \brief      Entry point for um6_allan, which characterizes gyro and accelerometer
+ *              noise from recorded data by Allan deviation, and recommends
+ *              covariance and EKF variance values for the driver.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <boost/thread.hpp>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "um6/allan_variance.h"
+#include "um6/archive.h"
+#include "um6/framer.h"
+#include "um6/register_log.h"
+#include "um6/registers.h"
+#include "um6/sample.h"
+
+// As in the driver, arrival of this packet completes a cycle.
+const uint8_t TRIGGER_PACKET = UM6_TEMPERATURE;
+
+const int AXES[] =
+{
+  um6::Sample::GYRO_X, um6::Sample::GYRO_Y, um6::Sample::GYRO_Z,
+  um6::Sample::ACCEL_X, um6::Sample::ACCEL_Y, um6::Sample::ACCEL_Z
+};
+const size_t NUM_AXES = sizeof(AXES) / sizeof(AXES[0]);
+
+// Upper bounds on -j and -d, well past any useful number of cores or points.
+const long MAX_THREADS = 1024;
+const long MAX_PER_DECADE = 1000;
+
+/**
+ * Loads the gyro and accelerometer axes of every sample in a recording, which
+ * may be an archive, a register-frame log, or a raw serial stream. Returns the
+ * sample period, either from the stamps, or from the given rate for raw streams.
+ */
+static double load(const std::string& path, double rate, std::vector<std::vector<double> >* signals)
+{
+  signals->assign(NUM_AXES, std::vector<double>());
+
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file)
+  {
+    throw std::runtime_error("Unable to open " + path + ".");
+  }
+  char magic[8] = { 0 };
+  file.read(magic, sizeof(magic));
+
+  if (memcmp(magic, "UM6ARCH", 8) == 0)
+  {
+    file.close();
+    um6::ArchiveReader reader(path);
+    for (size_t c = 0; c < reader.chunks(); c++)
+    {
+      for (size_t a = 0; a < NUM_AXES; a++)
+      {
+        const float* column = reader.column(c, AXES[a]);
+        (*signals)[a].insert((*signals)[a].end(), column, column + reader.chunkCount(c));
+      }
+    }
+    if (reader.size() < 2) return 1.0;
+    um6::Sample first, last;
+    reader.sample(0, &first);
+    reader.sample(reader.size() - 1, &last);
+    return (last.stamp - first.stamp) / (reader.size() - 1);
+  }
+
+  file.seekg(0);
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  const uint8_t* d = data.empty() ? NULL : &data[0];
+  um6::Registers registers;
+  um6::Sample s;
+
+  if (memcmp(magic, "UM6RLOG", 8) == 0)
+  {
+    um6::RegisterLogDecoder decoder;
+    size_t pos = decoder.header(d, data.size());
+    std::vector<uint32_t> words(decoder.config().register_count);
+    uint64_t first_ns = 0, last_ns = 0, stamp_ns;
+    size_t frames = 0;
+    while (pos < data.size())
+    {
+      size_t consumed;
+      try
+      {
+        consumed = decoder.decode(d + pos, data.size() - pos, &stamp_ns, &words[0]);
+      }
+      catch(const std::runtime_error& e)
+      {
+        decoder.resync();
+        pos = decoder.findKeyframe(d, data.size(), pos + 1);
+        continue;
+      }
+      if (consumed == 0) break;
+      pos += consumed;
+
+      registers.write_raw(decoder.config().first_register,
+                          std::string(reinterpret_cast<const char*>(&words[0]), words.size() * 4));
+      um6::decodeSample(registers, 0.0, &s);
+      for (size_t a = 0; a < NUM_AXES; a++)
+      {
+        (*signals)[a].push_back(s.channel[AXES[a]]);
+      }
+      if (frames++ == 0) first_ns = stamp_ns;
+      last_ns = stamp_ns;
+    }
+    return frames > 1 ? (last_ns - first_ns) * 1e-9 / (frames - 1) : 1.0;
+  }
+
+  um6::Framer framer;
+  size_t pos = 0;
+  while (pos < data.size())
+  {
+    size_t consumed = 0;
+    int16_t address;
+    try
+    {
+      address = framer.parse(d + pos, data.size() - pos, &consumed, &registers);
+    }
+    catch(const std::range_error& e)
+    {
+      pos += consumed;
+      continue;
+    }
+    if (address == um6::Framer::NEED_MORE) break;
+    pos += consumed;
+    if (address == TRIGGER_PACKET)
+    {
+      um6::decodeSample(registers, 0.0, &s);
+      for (size_t a = 0; a < NUM_AXES; a++)
+      {
+        (*signals)[a].push_back(s.channel[AXES[a]]);
+      }
+    }
+  }
+  return 1.0 / rate;
+}
+
+/**
+ * Parses a whole decimal number from 1 to max, returning false for anything else.
+ */
+static bool parseCount(const char* text, long max, unsigned int* value)
+{
+  char* end;
+  errno = 0;
+  long parsed = strtol(text, &end, 10);
+  if (errno != 0 || end == text || *end != '\0' || parsed < 1 || parsed > max) return false;
+  *value = static_cast<unsigned int>(parsed);
+  return true;
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr,
+          "Usage: %s [options] INPUT\n"
+          "Computes Allan deviation of the gyro and accelerometer axes of a recording\n"
+          "taken with the sensor stationary, and recommends noise parameters.\n\n"
+          "  -o PATH     write the deviation curves as CSV\n"
+          "  -j THREADS  worker threads (default: number of cores)\n"
+          "  -d POINTS   cluster sizes per decade (default 10)\n"
+          "  -r HZ       broadcast rate of raw streams, which carry no stamps (default 20)\n", name);
+}
+
+int main(int argc, char **argv)
+{
+  std::string output;
+  unsigned int threads = boost::thread::hardware_concurrency();
+  unsigned int per_decade = 10;
+  double rate = 20.0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "o:j:d:r:h")) != -1)
+  {
+    switch (opt)
+    {
+    case 'o': output = optarg; break;
+    case 'j':
+      if (!parseCount(optarg, MAX_THREADS, &threads))
+      {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'd':
+      if (!parseCount(optarg, MAX_PER_DECADE, &per_decade))
+      {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'r': rate = atof(optarg); break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1 || rate <= 0 || per_decade == 0)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+  if (threads < 1) threads = 1;
+
+  std::vector<std::vector<double> > signals;
+  double tau0;
+  try
+  {
+    tau0 = load(argv[optind], rate, &signals);
+  }
+  catch(const std::exception& e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  if (signals[0].size() < 3 || tau0 <= 0)
+  {
+    fprintf(stderr, "Not enough samples in %s.\n", argv[optind]);
+    return 1;
+  }
+  fprintf(stderr, "%zu samples at %.6f s (%.2f Hz), %.1f minutes.\n",
+          signals[0].size(), tau0, 1.0 / tau0, signals[0].size() * tau0 / 60);
+
+  std::vector<um6::AllanCurve> curves;
+  um6::allanDeviationCurves(signals, tau0, threads, &curves, per_decade);
+
+  if (!output.empty())
+  {
+    FILE* f = fopen(output.c_str(), "w");
+    if (!f)
+    {
+      fprintf(stderr, "Unable to open %s for writing.\n", output.c_str());
+      return 1;
+    }
+    fprintf(f, "tau");
+    for (size_t a = 0; a < NUM_AXES; a++)
+    {
+      fprintf(f, ",%s", um6::Sample::channelName(AXES[a]));
+    }
+    fprintf(f, "\n");
+    for (size_t p = 0; p < curves[0].tau.size(); p++)
+    {
+      fprintf(f, "%.6g", curves[0].tau[p]);
+      for (size_t a = 0; a < NUM_AXES; a++)
+      {
+        fprintf(f, ",%.6g", curves[a].adev[p]);
+      }
+      fprintf(f, "\n");
+    }
+    fclose(f);
+  }
+
+  // White noise with random walk coefficient N has a per-sample variance of N^2 / tau0.
+  double variance[NUM_AXES];
+  printf("%-10s %16s %16s %12s %16s\n", "axis", "random walk", "bias instab.", "at tau (s)", "sample variance");
+  for (size_t a = 0; a < NUM_AXES; a++)
+  {
+    um6::AllanNoise noise = um6::fitAllanNoise(curves[a]);
+    variance[a] = noise.angle_random_walk * noise.angle_random_walk / tau0;
+    printf("%-10s %16.6g %16.6g %12.4g %16.6g\n", um6::Sample::channelName(AXES[a]),
+           noise.angle_random_walk, noise.bias_instability, noise.bias_instability_tau, variance[a]);
+  }
+
+  double gyro_variance = (variance[0] + variance[1] + variance[2]) / 3;
+  double accel_variance = (variance[3] + variance[4] + variance[5]) / 3;
+  printf("\n# Recommended driver parameters. The covariances are in the units of the\n"
+         "# published messages; the EKF variances are in the device's units, deg/s and g.\n");
+  printf("angular_velocity_covariance: %.6g\n", gyro_variance);
+  printf("linear_acceleration_covariance: %.6g\n", accel_variance);
+  printf("ekf_process_variance: %.6g\n", gyro_variance * TO_DEGREES * TO_DEGREES);
+  printf("ekf_accel_variance: %.6g\n", accel_variance);
+  return 0;
+}
@@ -0,0 +1,231 @@
+/**
+ *
+ *  \file
+ *  \brief      Implementation of Allan variance computation and noise fitting.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/allan_variance.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <limits>
+#include <vector>
+
+namespace um6
+{
+
+std::vector<uint64_t> allanClusterSizes(size_t samples, unsigned int per_decade)
+{
+  std::vector<uint64_t> sizes;
+  if (samples < 3) return sizes;
+  uint64_t max_m = (samples - 1) / 2;
+  for (unsigned int i = 0; ; i++)
+  {
+    uint64_t m = static_cast<uint64_t>(pow(10.0, static_cast<double>(i) / per_decade));
+    if (m > max_m) break;
+    if (sizes.empty() || m != sizes.back()) sizes.push_back(m);
+  }
+  return sizes;
+}
+
+void allanIntegrate(const double* samples, size_t count, double tau0, std::vector<double>* theta)
+{
+  double mean = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    mean += samples[i];
+  }
+  mean = count > 0 ? mean / count : 0;
+
+  // A constant offset doesn't change the result, and removing it keeps the
+  // running sum small enough not to swamp short-cluster differences.
+  theta->resize(count + 1);
+  double sum = 0;
+  (*theta)[0] = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    sum += (samples[i] - mean) * tau0;
+    (*theta)[i + 1] = sum;
+  }
+}
+
+double allanVariance(const std::vector<double>& theta, uint64_t m, double tau0)
+{
+  size_t n = theta.size() - 1;
+  if (m == 0 || n < 2 * m + 1) return 0;
+
+  const double* t = &theta[0];
+  size_t terms = n + 1 - 2 * m;
+  double sum = 0;
+  for (size_t k = 0; k < terms; k++)
+  {
+    double d = t[k + 2 * m] - 2 * t[k + m] + t[k];
+    sum += d * d;
+  }
+  double tau = m * tau0;
+  return sum / (2 * tau * tau * terms);
+}
+
+namespace
+{
+
+struct CurveTask
+{
+  size_t signal;
+  size_t point;
+};
+
+class CurveWorker
+{
+public:
+  CurveWorker(const std::vector<std::vector<double> >& thetas, const std::vector<uint64_t>& sizes,
+              double tau0, const std::vector<CurveTask>& tasks, std::vector<AllanCurve>* curves)
+    : thetas_(thetas), sizes_(sizes), tau0_(tau0), tasks_(tasks), curves_(curves), next_(0)
+  {
+  }
+
+  void operator()()
+  {
+    while (true)
+    {
+      size_t task;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        if (next_ >= tasks_.size()) return;
+        task = next_++;
+      }
+      const CurveTask& t = tasks_[task];
+      (*curves_)[t.signal].adev[t.point] = sqrt(allanVariance(thetas_[t.signal], sizes_[t.point], tau0_));
+    }
+  }
+
+private:
+  const std::vector<std::vector<double> >& thetas_;
+  const std::vector<uint64_t>& sizes_;
+  double tau0_;
+  const std::vector<CurveTask>& tasks_;
+  std::vector<AllanCurve>* curves_;
+  boost::mutex mutex_;
+  size_t next_;
+};
+
+}  // namespace
+
+void allanDeviationCurves(const std::vector<std::vector<double> >& signals, double tau0,
+                          unsigned int threads, std::vector<AllanCurve>* curves,
+                          unsigned int per_decade)
+{
+  curves->clear();
+  curves->resize(signals.size());
+  if (signals.empty()) return;
+
+  std::vector<std::vector<double> > thetas(signals.size());
+  for (size_t s = 0; s < signals.size(); s++)
+  {
+    allanIntegrate(signals[s].empty() ? NULL : &signals[s][0], signals[s].size(), tau0, &thetas[s]);
+  }
+
+  // Signals are assumed to be equally long, as they are axes of one sensor.
+  size_t samples = signals[0].size();
+  for (size_t s = 1; s < signals.size(); s++)
+  {
+    samples = std::min(samples, signals[s].size());
+  }
+  std::vector<uint64_t> sizes = allanClusterSizes(samples, per_decade);
+
+  // Largest clusters first, as they're the quickest and the scheduling then
+  // finishes with a tail of the smallest tasks.
+  std::vector<CurveTask> tasks;
+  for (size_t p = sizes.size(); p-- > 0;)
+  {
+    for (size_t s = 0; s < signals.size(); s++)
+    {
+      CurveTask t = { s, p };
+      tasks.push_back(t);
+    }
+  }
+  for (size_t s = 0; s < signals.size(); s++)
+  {
+    (*curves)[s].adev.resize(sizes.size());
+    (*curves)[s].tau.resize(sizes.size());
+    for (size_t p = 0; p < sizes.size(); p++)
+    {
+      (*curves)[s].tau[p] = sizes[p] * tau0;
+    }
+  }
+
+  CurveWorker worker(thetas, sizes, tau0, tasks, curves);
+  boost::thread_group group;
+  for (unsigned int i = 1; i < threads; i++)
+  {
+    group.create_thread(boost::ref(worker));
+  }
+  worker();
+  group.join_all();
+}
+
+AllanNoise fitAllanNoise(const AllanCurve& curve)
+{
+  AllanNoise noise;
+  noise.angle_random_walk = 0;
+  noise.bias_instability = 0;
+  noise.bias_instability_tau = 0;
+  if (curve.tau.empty()) return noise;
+
+  // Along a line of slope -1/2, adev * sqrt(tau) is the line's value at
+  // tau = 1 s, which is the random walk coefficient. Average it over the points
+  // where the curve is close to that slope.
+  double sum = 0;
+  unsigned int points = 0;
+  for (size_t i = 0; i + 1 < curve.tau.size(); i++)
+  {
+    if (curve.adev[i] <= 0 || curve.adev[i + 1] <= 0) continue;
+    double slope = log(curve.adev[i + 1] / curve.adev[i]) / log(curve.tau[i + 1] / curve.tau[i]);
+    if (slope > -0.7 && slope < -0.3)
+    {
+      sum += curve.adev[i] * sqrt(curve.tau[i]);
+      points++;
+    }
+  }
+  noise.angle_random_walk = points > 0 ? sum / points : curve.adev[0] * sqrt(curve.tau[0]);
+
+  // Bias instability is read off the minimum of the curve, scaled by the
+  // flicker noise factor sqrt(2 ln 2 / pi).
+  size_t min = std::min_element(curve.adev.begin(), curve.adev.end()) - curve.adev.begin();
+  noise.bias_instability = curve.adev[min] / sqrt(2 * log(2.0) / M_PI);
+  noise.bias_instability_tau = curve.tau[min];
+  return noise;
+}
+
+}  // namespace um6
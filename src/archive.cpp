@@ -0,0 +1,428 @@
+/**
+ *
+ *  \file
+ *  \brief      Implementation of the columnar sample archive writer and reader.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/archive.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ros/console.h"
+#include "um6/cpu_accounting.h"
+
+namespace um6
+{
+
+static const char ARCHIVE_MAGIC[8] = { 'U', 'M', '6', 'A', 'R', 'C', 'H', '\0' };
+static const uint32_t ARCHIVE_VERSION = 1;
+
+const uint32_t ArchiveWriter::MAX_PENDING_CHUNKS = 8;
+const uint32_t ArchiveWriter::MAX_CHUNK_SAMPLES = 1u << 20;
+
+static uint64_t chunkBytes(uint64_t chunk_samples)
+{
+  return sizeof(ArchiveChunkHeader) + chunk_samples * (sizeof(double) + Sample::NUM_CHANNELS * sizeof(float));
+}
+
+static uint32_t roundChunkSamples(uint32_t chunk_samples)
+{
+  if (chunk_samples < 1 || chunk_samples > ArchiveWriter::MAX_CHUNK_SAMPLES)
+  {
+    std::ostringstream message;
+    message << "Archive chunk size must be from 1 to " << ArchiveWriter::MAX_CHUNK_SAMPLES << " samples.";
+    throw std::runtime_error(message.str());
+  }
+  return (chunk_samples + 15) & ~15u;
+}
+
+static bool writeAll(int fd, const void* data, size_t length, off_t offset)
+{
+  const char* p = reinterpret_cast<const char*>(data);
+  while (length > 0)
+  {
+    ssize_t written = ::pwrite(fd, p, length, offset);
+    if (written < 0)
+    {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (written == 0)
+    {
+      errno = EIO;
+      return false;
+    }
+    p += written;
+    offset += written;
+    length -= written;
+  }
+  return true;
+}
+
+ArchiveWriter::ArchiveWriter(const std::string& path, uint32_t chunk_samples, bool realtime)
+  : fd_(-1), chunk_samples_(roundChunkSamples(chunk_samples)),
+    chunk_bytes_(chunkBytes(chunk_samples_)), fill_(0), realtime_(realtime), current_(NULL),
+    dropped_chunks_(0), chunks_written_(0), closing_(false)
+{
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0)
+  {
+    throw std::runtime_error("Unable to open archive " + path + ": " + strerror(errno));
+  }
+
+  ArchiveFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+  header.version = ARCHIVE_VERSION;
+  header.channels = Sample::NUM_CHANNELS;
+  header.chunk_samples = chunk_samples_;
+  header.chunk_bytes = chunk_bytes_;
+  if (!writeAll(fd_, &header, sizeof(header), 0))
+  {
+    ::close(fd_);
+    throw std::runtime_error("Unable to write archive header to " + path + ".");
+  }
+
+  current_ = new std::vector<char>(chunk_bytes_);
+  thread_ = boost::thread(&ArchiveWriter::writeLoop, this);
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+  close();
+}
+
+void ArchiveWriter::append(const Sample& sample)
+{
+  char* chunk = &(*current_)[0];
+  double* stamps = reinterpret_cast<double*>(chunk + sizeof(ArchiveChunkHeader));
+  float* columns = reinterpret_cast<float*>(stamps + chunk_samples_);
+
+  stamps[fill_] = sample.stamp;
+  for (int c = 0; c < Sample::NUM_CHANNELS; c++)
+  {
+    columns[c * chunk_samples_ + fill_] = sample.channel[c];
+  }
+
+  if (++fill_ == chunk_samples_)
+  {
+    handOff();
+  }
+}
+
+void ArchiveWriter::handOff()
+{
+  ArchiveChunkHeader* header = reinterpret_cast<ArchiveChunkHeader*>(&(*current_)[0]);
+  const double* stamps = reinterpret_cast<const double*>(header + 1);
+  header->count = fill_;
+  header->reserved = 0;
+  header->first_stamp = stamps[0];
+  header->last_stamp = stamps[fill_ - 1];
+  fill_ = 0;
+
+  boost::mutex::scoped_lock lock(mutex_);
+  if (realtime_ && pending_.size() >= MAX_PENDING_CHUNKS)
+  {
+    // Writer thread can't keep up; reuse this chunk's buffer for the next one.
+    dropped_chunks_++;
+    return;
+  }
+  while (pending_.size() >= MAX_PENDING_CHUNKS)
+  {
+    cond_.wait(lock);
+  }
+  pending_.push_back(current_);
+  if (spare_.empty())
+  {
+    current_ = new std::vector<char>(chunk_bytes_);
+  }
+  else
+  {
+    current_ = spare_.back();
+    spare_.pop_back();
+  }
+  cond_.notify_all();
+}
+
+void ArchiveWriter::writeLoop()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  while (true)
+  {
+    while (pending_.empty() && !closing_)
+    {
+      cond_.wait(lock);
+    }
+    if (pending_.empty()) break;
+
+    std::vector<char>* chunk = pending_.front();
+    pending_.pop_front();
+
+    // Each chunk goes at its own offset, so that one which fails part way is
+    // cut off again and the stride of those which follow is kept.
+    lock.unlock();
+    off_t offset = sizeof(ArchiveFileHeader) + static_cast<off_t>(chunks_written_) * chunk_bytes_;
+    if (writeAll(fd_, &(*chunk)[0], chunk->size(), offset))
+    {
+      chunks_written_++;
+    }
+    else
+    {
+      ROS_ERROR("Failed writing chunk to archive: %s", strerror(errno));
+      dropped_chunks_++;
+      if (ftruncate(fd_, offset) != 0)
+      {
+        ROS_ERROR("Failed truncating archive after a failed write: %s", strerror(errno));
+      }
+    }
+    lock.lock();
+
+    spare_.push_back(chunk);
+    cond_.notify_all();
+  }
+}
+
+void ArchiveWriter::close()
+{
+  if (fd_ < 0) return;
+
+  if (fill_ > 0)
+  {
+    // Zero the unused tail of each column so the file contents are deterministic.
+    char* chunk = &(*current_)[0];
+    double* stamps = reinterpret_cast<double*>(chunk + sizeof(ArchiveChunkHeader));
+    float* columns = reinterpret_cast<float*>(stamps + chunk_samples_);
+    std::fill(stamps + fill_, stamps + chunk_samples_, 0.0);
+    for (int c = 0; c < Sample::NUM_CHANNELS; c++)
+    {
+      std::fill(columns + c * chunk_samples_ + fill_, columns + (c + 1) * chunk_samples_, 0.0f);
+    }
+    handOff();
+  }
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    closing_ = true;
+    cond_.notify_all();
+  }
+  thread_.join();
+
+  ::close(fd_);
+  fd_ = -1;
+
+  delete current_;
+  current_ = NULL;
+  for (size_t i = 0; i < spare_.size(); i++)
+  {
+    delete spare_[i];
+  }
+  spare_.clear();
+}
+
+size_t ArchiveWriter::pendingChunks()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return pending_.size();
+}
+
+uint64_t ArchiveWriter::writerCpuNanoseconds()
+{
+  if (fd_ < 0) return 0;
+  return CpuAccounting::threadCpuNanoseconds(thread_.native_handle());
+}
+
+ArchiveReader::ArchiveReader(const std::string& path)
+  : map_(NULL), map_length_(0), chunks_(0), chunk_samples_(0), chunk_bytes_(0)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw std::runtime_error("Unable to open archive " + path + ": " + strerror(errno));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ArchiveFileHeader))
+  {
+    ::close(fd);
+    throw std::runtime_error("Archive " + path + " is truncated.");
+  }
+  map_length_ = st.st_size;
+
+  void* map = mmap(NULL, map_length_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+  {
+    throw std::runtime_error("Unable to map archive " + path + ": " + strerror(errno));
+  }
+  map_ = reinterpret_cast<const uint8_t*>(map);
+
+  const ArchiveFileHeader* header = reinterpret_cast<const ArchiveFileHeader*>(map_);
+  if (memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != ARCHIVE_VERSION ||
+      header->channels != Sample::NUM_CHANNELS ||
+      header->chunk_samples == 0 || header->chunk_samples > ArchiveWriter::MAX_CHUNK_SAMPLES ||
+      header->chunk_bytes != chunkBytes(header->chunk_samples))
+  {
+    munmap(const_cast<uint8_t*>(map_), map_length_);
+    throw std::runtime_error("File " + path + " is not a compatible archive.");
+  }
+  chunk_samples_ = header->chunk_samples;
+  chunk_bytes_ = header->chunk_bytes;
+
+  // A chunk cut short by a crash mid-write is ignored.
+  chunks_ = (map_length_ - sizeof(ArchiveFileHeader)) / chunk_bytes_;
+  // Indexing by sample relies on every chunk but the last being full.
+  for (size_t chunk = 0; chunk < chunks_; chunk++)
+  {
+    if (chunkCount(chunk) > chunk_samples_)
+    {
+      munmap(const_cast<uint8_t*>(map_), map_length_);
+      throw std::runtime_error("Archive " + path + " has a chunk which overflows its columns.");
+    }
+    if (chunk + 1 < chunks_ && chunkCount(chunk) < chunk_samples_)
+    {
+      munmap(const_cast<uint8_t*>(map_), map_length_);
+      throw std::runtime_error("Archive " + path + " has a partial chunk before its last.");
+    }
+  }
+}
+
+ArchiveReader::~ArchiveReader()
+{
+  munmap(const_cast<uint8_t*>(map_), map_length_);
+}
+
+const ArchiveChunkHeader* ArchiveReader::chunkHeader(size_t chunk) const
+{
+  return reinterpret_cast<const ArchiveChunkHeader*>(
+           map_ + sizeof(ArchiveFileHeader) + chunk * chunk_bytes_);
+}
+
+const double* ArchiveReader::stamps(size_t chunk) const
+{
+  return reinterpret_cast<const double*>(chunkHeader(chunk) + 1);
+}
+
+const float* ArchiveReader::column(size_t chunk, int channel) const
+{
+  return reinterpret_cast<const float*>(stamps(chunk) + chunk_samples_) + channel * chunk_samples_;
+}
+
+size_t ArchiveReader::size() const
+{
+  if (chunks_ == 0) return 0;
+  return (chunks_ - 1) * chunk_samples_ + chunkCount(chunks_ - 1);
+}
+
+size_t ArchiveReader::find(double stamp) const
+{
+  // Binary search the chunk headers for the first chunk which ends at or after stamp.
+  size_t lo = 0, hi = chunks_;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (chunkHeader(mid)->last_stamp < stamp)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  if (lo == chunks_) return size();
+
+  const double* s = stamps(lo);
+  return lo * chunk_samples_ + (std::lower_bound(s, s + chunkCount(lo), stamp) - s);
+}
+
+void ArchiveReader::sample(size_t index, Sample* sample) const
+{
+  if (index >= size())
+  {
+    throw std::out_of_range("Sample index beyond end of archive.");
+  }
+  size_t chunk = index / chunk_samples_;
+  size_t offset = index % chunk_samples_;
+
+  sample->stamp = stamps(chunk)[offset];
+  for (int c = 0; c < Sample::NUM_CHANNELS; c++)
+  {
+    sample->channel[c] = column(chunk, c)[offset];
+  }
+  memset(sample->orientation_covariance, 0, sizeof(sample->orientation_covariance));
+}
+
+size_t ArchiveReader::scan(double start, double end, size_t decimation, int channel,
+                           std::vector<double>* stamps_out, std::vector<float>* values_out) const
+{
+  if (channel < 0 || channel >= Sample::NUM_CHANNELS)
+  {
+    throw std::out_of_range("No such channel in archive.");
+  }
+  if (decimation == 0) decimation = 1;
+
+  size_t appended = 0;
+  size_t index = find(start);
+  size_t total = size();
+  while (index < total)
+  {
+    size_t chunk = index / chunk_samples_;
+    size_t offset = index % chunk_samples_;
+    const double* s = stamps(chunk);
+    const float* v = column(chunk, channel);
+    uint32_t count = chunkCount(chunk);
+
+    for (; offset < count; offset += decimation)
+    {
+      if (s[offset] >= end) return appended;
+      if (stamps_out) stamps_out->push_back(s[offset]);
+      if (values_out) values_out->push_back(v[offset]);
+      appended++;
+    }
+    index = chunk * chunk_samples_ + offset;
+  }
+  return appended;
+}
+
+}  // namespace um6
@@ -0,0 +1,248 @@
+/**
+ *
+ *  \file
+ *  \brief      Rate-limited logging through a lock-free queue.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/async_log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+
+#include "ros/console.h"
+
+namespace um6
+{
+
+namespace
+{
+
+uint64_t monotonicNanoseconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+void rosconsoleSink(AsyncLog::Severity severity, const char* text)
+{
+  switch (severity)
+  {
+  case AsyncLog::INFO:
+    ROS_LOG(ros::console::levels::Info, ROSCONSOLE_DEFAULT_NAME, "%s", text);
+    break;
+  case AsyncLog::WARN:
+    ROS_LOG(ros::console::levels::Warn, ROSCONSOLE_DEFAULT_NAME, "%s", text);
+    break;
+  default:
+    ROS_LOG(ros::console::levels::Error, ROSCONSOLE_DEFAULT_NAME, "%s", text);
+    break;
+  }
+}
+
+AsyncLog::Sink sink_ = rosconsoleSink;
+
+void emit(AsyncLog::Severity severity, const char* text)
+{
+  sink_(severity, text);
+}
+
+/**
+ * Bounded multi-producer queue after Vyukov: each cell's sequence number says
+ * whether it is free for the producer at that position, or filled for the
+ * consumer. There is a single consumer, the drain thread.
+ */
+class Queue
+{
+public:
+  explicit Queue(size_t capacity) : dequeue_pos_(0), enqueue_pos_(0)
+  {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    cells_.reset(new Cell[size]);
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; i++)
+    {
+      cells_[i].sequence.store(i, boost::memory_order_relaxed);
+    }
+  }
+
+  bool push(AsyncLog::Severity severity, const char* text)
+  {
+    size_t pos = enqueue_pos_.load(boost::memory_order_relaxed);
+    Cell* cell;
+    for (;;)
+    {
+      cell = &cells_[pos & mask_];
+      size_t sequence = cell->sequence.load(boost::memory_order_acquire);
+      intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (difference == 0)
+      {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed)) break;
+      }
+      else if (difference < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = enqueue_pos_.load(boost::memory_order_relaxed);
+      }
+    }
+    cell->severity = severity;
+    strncpy(cell->text, text, AsyncLog::MAX_TEXT);
+    cell->text[AsyncLog::MAX_TEXT] = '\0';
+    cell->sequence.store(pos + 1, boost::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Passes on everything queued, returning the number of messages. */
+  size_t drain()
+  {
+    size_t count = 0;
+    for (;;)
+    {
+      Cell* cell = &cells_[dequeue_pos_ & mask_];
+      if (cell->sequence.load(boost::memory_order_acquire) != dequeue_pos_ + 1) break;
+      emit(cell->severity, cell->text);
+      cell->sequence.store(dequeue_pos_ + mask_ + 1, boost::memory_order_release);
+      dequeue_pos_++;
+      count++;
+    }
+    return count;
+  }
+
+private:
+  struct Cell
+  {
+    boost::atomic<size_t> sequence;
+    AsyncLog::Severity severity;
+    char text[AsyncLog::MAX_TEXT + 1];
+  };
+
+  boost::scoped_array<Cell> cells_;
+  size_t mask_;
+  size_t dequeue_pos_;
+  boost::atomic<size_t> enqueue_pos_;
+};
+
+const int DRAIN_INTERVAL_MS = 50;
+
+boost::atomic<Queue*> queue_(NULL);
+boost::atomic<bool> running_(false);
+boost::atomic<uint64_t> dropped_(0);
+boost::thread* thread_ = NULL;
+
+void drainLoop(Queue* queue)
+{
+  while (running_.load(boost::memory_order_acquire))
+  {
+    queue->drain();
+    boost::this_thread::sleep(boost::posix_time::milliseconds(DRAIN_INTERVAL_MS));
+  }
+}
+
+}  // namespace
+
+void AsyncLog::log(Site* site, Severity severity, double period, const char* format, ...)
+{
+  uint64_t now = monotonicNanoseconds();
+  uint64_t next = site->next_ns.load(boost::memory_order_relaxed);
+  if (now < next || !site->next_ns.compare_exchange_strong(next, now + static_cast<uint64_t>(period * 1e9)))
+  {
+    site->suppressed.fetch_add(1, boost::memory_order_relaxed);
+    return;
+  }
+
+  char text[MAX_TEXT + 1];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+
+  uint32_t suppressed = site->suppressed.exchange(0, boost::memory_order_relaxed);
+  if (suppressed > 0 && length >= 0 && static_cast<size_t>(length) < MAX_TEXT)
+  {
+    snprintf(text + length, sizeof(text) - length, " (%u similar suppressed)", suppressed);
+  }
+
+  Queue* queue = queue_.load(boost::memory_order_acquire);
+  if (!queue)
+  {
+    emit(severity, text);
+  }
+  else if (!queue->push(severity, text))
+  {
+    dropped_.fetch_add(1, boost::memory_order_relaxed);
+  }
+}
+
+void AsyncLog::start(size_t capacity)
+{
+  if (thread_) return;
+  Queue* queue = new Queue(capacity);
+  running_.store(true, boost::memory_order_release);
+  queue_.store(queue, boost::memory_order_release);
+  thread_ = new boost::thread(drainLoop, queue);
+}
+
+void AsyncLog::stop()
+{
+  if (!thread_) return;
+  running_.store(false, boost::memory_order_release);
+  thread_->join();
+  delete thread_;
+  thread_ = NULL;
+
+  // Anything queued since the thread's last pass goes out from here.
+  Queue* queue = queue_.exchange(NULL, boost::memory_order_acq_rel);
+  queue->drain();
+  delete queue;
+}
+
+uint64_t AsyncLog::dropped()
+{
+  return dropped_.load(boost::memory_order_relaxed);
+}
+
+void AsyncLog::setSink(Sink sink)
+{
+  sink_ = sink ? sink : rosconsoleSink;
+}
+
+}  // namespace um6
@@ -0,0 +1,188 @@
+/**
+ *
+ *  \file
+ *  \brief      Times the double, float and fixed-point decode paths, so they
+ *              can be compared on each target processor.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <string>
+
+#include "um6/fixed_sample.h"
+#include "um6/registers.h"
+#include "um6/sample.h"
+#include "um6/trace.h"
+
+// Distinct register contents to cycle through, so nothing is constant folded.
+const size_t FRAMES = 64;
+
+static void report(const char* name, uint64_t start_ns, size_t iterations, double checksum)
+{
+  double ns = static_cast<double>(um6::traceClock() - start_ns) / iterations;
+  printf("%-28s %10.1f ns/cycle  %12.0f cycles/s  (checksum %g)\n", name, ns, 1e9 / ns, checksum);
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "Times decoding a cycle of registers through the double, float and fixed-point\n"
+          "paths, with and without low-pass filtering.\n\n"
+          "  -n CYCLES  cycles to time per path (default 10000000)\n"
+          "  -s SHIFT   low-pass smoothing factor of 2^-SHIFT (default 3)\n", name);
+}
+
+int main(int argc, char **argv)
+{
+  size_t iterations = 10000000;
+  int shift = 3;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:h")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n': iterations = strtoul(optarg, NULL, 10); break;
+    case 's': shift = atoi(optarg); break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || iterations == 0 || shift < 0 || shift > um6::FixedLowPass::MAX_SHIFT)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  boost::ptr_vector<um6::Registers> frames;
+  srand(1);
+  for (size_t f = 0; f < FRAMES; f++)
+  {
+    um6::Registers* r = new um6::Registers();
+    frames.push_back(r);
+    for (int i = 0; i < 3; i++)
+    {
+      r->gyro.set(i, rand());
+      r->accel.set(i, rand());
+      r->mag.set(i, rand());
+      r->euler.set(i, rand());
+    }
+    for (int i = 0; i < 4; i++) r->quat.set(i, rand());
+    r->temperature.set(0, 20.0 + f * 0.1);
+  }
+
+  um6::Sample s;
+  um6::SampleF single;
+  um6::FixedSample fixed;
+  double checksum;
+  uint64_t start;
+
+  checksum = 0;
+  start = um6::traceClock();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    um6::decodeSample(frames[i % FRAMES], i, &s);
+    checksum += s.channel[i % um6::Sample::NUM_CHANNELS];
+  }
+  report("double decode", start, iterations, checksum);
+
+  um6::LowPass<double> lowpass_double(1.0 / (1 << shift));
+  checksum = 0;
+  start = um6::traceClock();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    um6::decodeSample(frames[i % FRAMES], i, &s);
+    lowpass_double.filter(&s);
+    checksum += s.channel[i % um6::Sample::NUM_CHANNELS];
+  }
+  report("double decode + low-pass", start, iterations, checksum);
+
+  checksum = 0;
+  start = um6::traceClock();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    um6::decodeSample(frames[i % FRAMES], i, &single);
+    checksum += single.channel[i % um6::Sample::NUM_CHANNELS];
+  }
+  report("float decode", start, iterations, checksum);
+
+  um6::LowPass<float> lowpass_float(1.0f / (1 << shift));
+  checksum = 0;
+  start = um6::traceClock();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    um6::decodeSample(frames[i % FRAMES], i, &single);
+    lowpass_float.filter(&single);
+    checksum += single.channel[i % um6::Sample::NUM_CHANNELS];
+  }
+  report("float decode + low-pass", start, iterations, checksum);
+
+  int64_t fixed_checksum = 0;
+  start = um6::traceClock();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    um6::decodeFixedSample(frames[i % FRAMES], i, &fixed);
+    fixed_checksum += fixed.channel[i % um6::FixedSample::NUM_CHANNELS];
+  }
+  report("fixed decode", start, iterations, fixed_checksum);
+
+  um6::FixedLowPass lowpass(shift);
+  fixed_checksum = 0;
+  start = um6::traceClock();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    um6::decodeFixedSample(frames[i % FRAMES], i, &fixed);
+    lowpass.filter(&fixed);
+    fixed_checksum += fixed.channel[i % um6::FixedSample::NUM_CHANNELS];
+  }
+  report("fixed decode + low-pass", start, iterations, fixed_checksum);
+
+  // What the driver pays per cycle on the fixed-point path, conversion for messages included.
+  lowpass.reset();
+  checksum = 0;
+  start = um6::traceClock();
+  for (size_t i = 0; i < iterations; i++)
+  {
+    um6::decodeFixedSample(frames[i % FRAMES], i, &fixed);
+    lowpass.filter(&fixed);
+    um6::toSample(fixed, &s);
+    checksum += s.channel[i % um6::Sample::NUM_CHANNELS];
+  }
+  report("fixed + low-pass + toSample", start, iterations, checksum);
+
+  return 0;
+}
@@ -41,7 +41,10 @@
 
 #include "ros/console.h"
 #include "serial/serial.h"
+#include "um6/async_log.h"
+#include "um6/flight_recorder.h"
 #include "um6/registers.h"
+#include "um6/trace.h"
 
 namespace um6
 {
@@ -59,15 +62,16 @@ int16_t Comms::receive(Registers* registers = NULL)
     size_t available = serial_->available();
     if (available > 255)
     {
-      ROS_WARN_STREAM("Serial read buffer is " << available << ", now flushing in an attempt to catch up.");
+      UM6_WARN_ASYNC("Serial read buffer is %zu, now flushing in an attempt to catch up.", available);
       serial_->flushInput();
     }
 
     // Optimistically assume that the next five bytes on the wire are a packet header.
     uint8_t header_bytes[5];
-    serial_->read(header_bytes, 5);
+    counters_.bytes += serial_->read(header_bytes, 5);
 
     uint8_t type, address;
+    size_t junk_bytes = 0;
     if (memcmp(header_bytes, "snp", 3) == 0)
     {
       // Optimism win.
@@ -77,19 +81,30 @@ int16_t Comms::receive(Registers* registers = NULL)
     else
     {
       // Optimism fail. Search the serial stream for a header.
+      counters_.resyncs++;
       std::string snp;
-      serial_->readline(snp, 96, "snp");
-      if (!boost::algorithm::ends_with(snp, "snp")) throw SerialTimeout();
-      if (snp.length() > 3)
+      counters_.bytes += serial_->readline(snp, 96, "snp");
+      bool found = boost::algorithm::ends_with(snp, "snp");
+      junk_bytes = 5 + snp.length() - (found ? 3 : 0);
+      counters_.junk_bytes += junk_bytes;
+      if (recorder_)
       {
-        ROS_WARN_STREAM_COND(!first_spin_,
-                             "Discarded " << 5 + snp.length() - 3 << " junk byte(s) preceeding packet.");
+        std::string junk(reinterpret_cast<char*>(header_bytes), 5);
+        junk += snp.substr(0, junk_bytes - 5);
+        recorder_->record(FlightRecorder::RX_JUNK, junk.data(), junk.length());
+      }
+      if (!found) throw SerialTimeout();
+      if (snp.length() > 3 && !first_spin_)
+      {
+        UM6_WARN_ASYNC("Discarded %zu junk byte(s) preceeding packet.", junk_bytes);
       }
       if (serial_->read(&type, 1) != 1) throw SerialTimeout();
       if (serial_->read(&address, 1) != 1) throw SerialTimeout();
+      counters_.bytes += 2;
     }
 
     first_spin_ = false;
+    UM6_TRACE3(header_found, type, address, junk_bytes);
 
     uint16_t checksum_calculated = 's' + 'n' + 'p' + type + address;
     std::string data;
@@ -108,6 +123,7 @@ int16_t Comms::receive(Registers* registers = NULL)
 
       // Read data bytes initially into a buffer so that we can compute the checksum.
       if (serial_->read(data, data_length * 4) != data_length * 4) throw SerialTimeout();
+      counters_.bytes += data.length();
       BOOST_FOREACH(uint8_t ch, data)
       {
         checksum_calculated += ch;
@@ -124,17 +140,32 @@ int16_t Comms::receive(Registers* registers = NULL)
     {
       throw SerialTimeout();
     }
+    counters_.bytes += 2;
+    if (recorder_)
+    {
+      uint8_t packet[5 + 15 * 4 + 2] = { 's', 'n', 'p', type, address };
+      memcpy(packet + 5, data.data(), data.length());
+      memcpy(packet + 5 + data.length(), &checksum_transmitted, 2);
+      recorder_->record(ntohs(checksum_transmitted) == checksum_calculated ?
+                        FlightRecorder::RX_PACKET : FlightRecorder::RX_BAD_CHECKSUM,
+                        packet, 5 + data.length() + 2);
+    }
     checksum_transmitted = ntohs(checksum_transmitted);
     if (checksum_transmitted != checksum_calculated)
     {
+      UM6_TRACE2(checksum_bad, address, data.length());
+      counters_.bad_checksums++;
       throw BadChecksum();
     }
+    UM6_TRACE2(checksum_ok, address, data.length());
+    counters_.packets++;
 
     // Copy data from checksum buffer into registers, if specified.
     // Note that byte-order correction (as necessary) happens at access-time.
     if ((data.length() > 0) && registers)
     {
       registers->write_raw(address, data);
+      UM6_TRACE2(write_raw, address, data.length());
     }
 
     // Successful packet read, return address byte.
@@ -142,11 +173,14 @@ int16_t Comms::receive(Registers* registers = NULL)
   }
   catch(const SerialTimeout& e)
   {
-    ROS_WARN("Timed out waiting for packet from device.");
+    UM6_WARN_ASYNC("Timed out waiting for packet from device.");
+    UM6_TRACE0(receive_timeout);
+    counters_.timeouts++;
+    if (recorder_) recorder_->event("Timed out waiting for packet from device.");
   }
   catch(const BadChecksum& e)
   {
-    ROS_WARN("Discarding packet due to bad checksum.");
+    UM6_WARN_ASYNC("Discarding packet due to bad checksum.");
   }
   return -1;
 }
@@ -192,7 +226,10 @@ void Comms::send(const Accessor_& r) const
 {
   uint8_t address = r.index;
   std::string data(reinterpret_cast<char*>(r.raw()), r.length * 4);
-  serial_->write(message(r.index, data));
+  std::string msg(message(r.index, data));
+  if (recorder_) recorder_->record(FlightRecorder::TX_PACKET, msg.data(), msg.length());
+  serial_->write(msg);
+  UM6_TRACE2(command_sent, address, msg.length());
 }
 
 bool Comms::sendWaitAck(const Accessor_& r)
@@ -208,6 +245,7 @@ bool Comms::sendWaitAck(const Accessor_& r)
       if (received == r.index)
       {
         ROS_DEBUG("Message %02x ack received.", received);
+        UM6_TRACE2(ack_received, r.index, t + 1);
         return true;
       }
       else if (received == -1)
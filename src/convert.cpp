@@ -0,0 +1,567 @@
+/**
+ *
+ *  \file
+ *  \brief      Entry point for um6_convert, which converts recorded raw serial
+ *              streams and register-frame logs to CSV or columnar archives,
+ *              summarizing them along the way. Chunks of the input are processed
+ *              in parallel, and the results merged in order.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "um6/archive.h"
+#include "um6/framer.h"
+#include "um6/register_log.h"
+#include "um6/registers.h"
+#include "um6/sample.h"
+#include "um6/statistics.h"
+
+// As in the driver, arrival of this packet completes a cycle.
+const uint8_t TRIGGER_PACKET = UM6_TEMPERATURE;
+
+// Bytes parsed ahead of each raw chunk, to align the framer with the stream
+// and to fill the registers with one complete cycle before the chunk begins.
+const size_t WARMUP_BYTES = 2048;
+
+// Upper bound on -j, well past any useful number of cores.
+const long MAX_THREADS = 1024;
+
+struct Options
+{
+  std::string input;
+  std::string output;
+  std::string format;
+  unsigned int threads;
+  size_t chunk_bytes;
+  double rate;
+  bool stats;
+};
+
+/**
+ * A contiguous piece of the input, and everything produced from it. A chunk
+ * owns the packets or frames which start within [begin, end).
+ */
+struct Chunk
+{
+  size_t begin, end;
+  bool done;
+
+  std::vector<um6::Sample> samples;
+  um6::RunningStats stats[um6::Sample::NUM_CHANNELS];
+
+  // Preformatted CSV, one line per sample. For raw streams, the leading stamp
+  // field is left off, to be added at merge time.
+  std::string csv;
+  std::vector<size_t> csv_lines;
+
+  uint64_t packets, bad_checksums, resyncs, junk_bytes, errors;
+};
+
+class Converter
+{
+public:
+  Converter(const Options& options, const uint8_t* data, size_t length)
+    : options_(options), data_(data), length_(length), frames_(false), next_chunk_(0), merged_chunk_(0)
+  {
+    try
+    {
+      frames_ = frames_decoder_.header(data_, length_) > 0;
+    }
+    catch(const std::runtime_error& e)
+    {
+      // Not a register-frame log, so treat it as a raw stream.
+    }
+  }
+
+  bool isFrameLog() const
+  {
+    return frames_;
+  }
+
+  void split();
+  void run();
+
+  std::deque<Chunk> chunks;
+
+private:
+  void worker();
+  void process(Chunk* chunk);
+  void processRaw(Chunk* chunk);
+  void processFrames(Chunk* chunk);
+  void finish(Chunk* chunk);
+  bool isHeader(size_t pos) const;
+
+  const Options& options_;
+  const uint8_t* data_;
+  size_t length_;
+  bool frames_;
+  um6::RegisterLogDecoder frames_decoder_;
+
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  size_t next_chunk_;
+  size_t merged_chunk_;
+};
+
+bool Converter::isHeader(size_t pos) const
+{
+  return pos + 3 <= length_ && memcmp(data_ + pos, "snp", 3) == 0;
+}
+
+/**
+ * Divides the input into chunks, with each boundary moved forward to the next
+ * point at which a parser can resynchronize: a packet header in a raw stream,
+ * or a keyframe in a register-frame log.
+ */
+void Converter::split()
+{
+  size_t start = frames_ ? um6::RegisterLogHeader::SIZE : 0;
+  size_t begin = start;
+  while (begin < length_)
+  {
+    size_t end = begin + options_.chunk_bytes;
+    if (end >= length_)
+    {
+      end = length_;
+    }
+    else if (frames_)
+    {
+      end = frames_decoder_.findKeyframe(data_, length_, end);
+    }
+    else
+    {
+      while (end < length_ && !isHeader(end)) end++;
+    }
+
+    Chunk c;
+    c.begin = begin;
+    c.end = end;
+    c.done = false;
+    c.packets = c.bad_checksums = c.resyncs = c.junk_bytes = c.errors = 0;
+    chunks.push_back(c);
+    begin = end;
+  }
+}
+
+void Converter::processRaw(Chunk* chunk)
+{
+  um6::Framer framer;
+  um6::Registers registers;
+
+  size_t pos = 0;
+  if (chunk->begin > WARMUP_BYTES)
+  {
+    pos = chunk->begin - WARMUP_BYTES;
+    while (pos < chunk->begin && !isHeader(pos)) pos++;
+  }
+
+  um6::Framer at_begin;
+  bool started = false;
+  while (pos < length_)
+  {
+    if (!started && pos >= chunk->begin)
+    {
+      at_begin = framer;
+      started = true;
+    }
+    if (pos >= chunk->end) break;
+
+    size_t consumed = 0;
+    int16_t address;
+    try
+    {
+      address = framer.parse(data_ + pos, length_ - pos, &consumed, &registers);
+    }
+    catch(const std::range_error& e)
+    {
+      // Packet addressed beyond the register array. The driver would bail
+      // and reconnect; here, just skip it.
+      if (started) chunk->errors++;
+      pos += consumed;
+      continue;
+    }
+    if (address == um6::Framer::NEED_MORE) break;
+
+    bool owned = pos >= chunk->begin;
+    pos += consumed;
+    if (owned && address == TRIGGER_PACKET)
+    {
+      um6::Sample s;
+      // Raw streams carry no time; stamps are filled in once the sample's
+      // position in the whole log is known.
+      um6::decodeSample(registers, 0.0, &s);
+      chunk->samples.push_back(s);
+    }
+  }
+
+  if (!started) at_begin = framer;
+  chunk->packets = framer.packets() - at_begin.packets();
+  chunk->bad_checksums = framer.badChecksums() - at_begin.badChecksums();
+  chunk->resyncs = framer.resyncs() - at_begin.resyncs();
+  chunk->junk_bytes = framer.junkBytes() - at_begin.junkBytes();
+}
+
+void Converter::processFrames(Chunk* chunk)
+{
+  um6::RegisterLogDecoder decoder(frames_decoder_);
+  decoder.resync();
+  const um6::RegisterLogHeader& config = decoder.config();
+  um6::Registers registers;
+  std::vector<uint32_t> words(config.register_count);
+
+  size_t pos = chunk->begin;
+  while (pos < chunk->end)
+  {
+    uint64_t stamp_ns;
+    size_t consumed;
+    try
+    {
+      consumed = decoder.decode(data_ + pos, chunk->end - pos, &stamp_ns, &words[0]);
+    }
+    catch(const std::runtime_error& e)
+    {
+      chunk->errors++;
+      decoder.resync();
+      pos = decoder.findKeyframe(data_, chunk->end, pos + 1);
+      continue;
+    }
+    if (consumed == 0) break;
+    pos += consumed;
+    chunk->packets++;
+
+    registers.write_raw(config.first_register,
+                        std::string(reinterpret_cast<const char*>(&words[0]), words.size() * 4));
+    um6::Sample s;
+    um6::decodeSample(registers, stamp_ns * 1e-9, &s);
+    chunk->samples.push_back(s);
+  }
+}
+
+void Converter::process(Chunk* chunk)
+{
+  if (frames_)
+  {
+    processFrames(chunk);
+  }
+  else
+  {
+    processRaw(chunk);
+  }
+
+  for (size_t i = 0; i < chunk->samples.size(); i++)
+  {
+    const um6::Sample& s = chunk->samples[i];
+    for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+    {
+      chunk->stats[c].add(s.channel[c]);
+    }
+
+    if (options_.format == "csv")
+    {
+      char field[32];
+      chunk->csv_lines.push_back(chunk->csv.length());
+      if (frames_)
+      {
+        int n = snprintf(field, sizeof(field), "%.6f", s.stamp);
+        chunk->csv.append(field, n);
+      }
+      for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+      {
+        int n = snprintf(field, sizeof(field), ",%.9g", s.channel[c]);
+        chunk->csv.append(field, n);
+      }
+      chunk->csv.push_back('\n');
+    }
+  }
+  if (options_.format != "archive")
+  {
+    // Only the archive needs the samples themselves at merge time.
+    std::vector<um6::Sample>().swap(chunk->samples);
+  }
+}
+
+void Converter::worker()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  while (true)
+  {
+    // Don't run too far ahead of the merge, to bound memory use.
+    while (next_chunk_ < chunks.size() && next_chunk_ >= merged_chunk_ + 2 * options_.threads)
+    {
+      cond_.wait(lock);
+    }
+    if (next_chunk_ >= chunks.size()) return;
+    Chunk* chunk = &chunks[next_chunk_++];
+
+    lock.unlock();
+    process(chunk);
+    lock.lock();
+
+    chunk->done = true;
+    cond_.notify_all();
+  }
+}
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+void Converter::run()
+{
+  FILE* csv = NULL;
+  boost::scoped_ptr<um6::ArchiveWriter> archive;
+  if (options_.format == "csv")
+  {
+    csv = options_.output == "-" ? stdout : fopen(options_.output.c_str(), "w");
+    if (!csv)
+    {
+      throw std::runtime_error("Unable to open " + options_.output + " for writing.");
+    }
+    fprintf(csv, "stamp");
+    for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+    {
+      fprintf(csv, ",%s", um6::Sample::channelName(c));
+    }
+    fprintf(csv, "\n");
+  }
+  else if (options_.format == "archive")
+  {
+    archive.reset(new um6::ArchiveWriter(options_.output));
+  }
+
+  double start = now();
+  boost::thread_group threads;
+  for (unsigned int i = 0; i < options_.threads; i++)
+  {
+    threads.create_thread(boost::bind(&Converter::worker, this));
+  }
+
+  um6::RunningStats stats[um6::Sample::NUM_CHANNELS];
+  uint64_t samples = 0, packets = 0, bad_checksums = 0, resyncs = 0, junk_bytes = 0, errors = 0;
+  for (size_t i = 0; i < chunks.size(); i++)
+  {
+    Chunk* chunk = &chunks[i];
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while (!chunk->done) cond_.wait(lock);
+    }
+
+    if (csv && frames_)
+    {
+      fwrite(chunk->csv.data(), 1, chunk->csv.length(), csv);
+    }
+    else if (csv)
+    {
+      for (size_t l = 0; l < chunk->csv_lines.size(); l++)
+      {
+        size_t line_begin = chunk->csv_lines[l];
+        size_t line_end = l + 1 < chunk->csv_lines.size() ? chunk->csv_lines[l + 1] : chunk->csv.length();
+        fprintf(csv, "%.6f", (samples + l) / options_.rate);
+        fwrite(chunk->csv.data() + line_begin, 1, line_end - line_begin, csv);
+      }
+    }
+    if (archive)
+    {
+      for (size_t s = 0; s < chunk->samples.size(); s++)
+      {
+        if (!frames_) chunk->samples[s].stamp = (samples + s) / options_.rate;
+        archive->append(chunk->samples[s]);
+      }
+    }
+
+    for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+    {
+      stats[c].merge(chunk->stats[c]);
+    }
+    samples += chunk->stats[0].count();
+    packets += chunk->packets;
+    bad_checksums += chunk->bad_checksums;
+    resyncs += chunk->resyncs;
+    junk_bytes += chunk->junk_bytes;
+    errors += chunk->errors;
+
+    // Release the chunk's memory, and let the workers move ahead.
+    std::vector<um6::Sample>().swap(chunk->samples);
+    std::string().swap(chunk->csv);
+    std::vector<size_t>().swap(chunk->csv_lines);
+    boost::mutex::scoped_lock lock(mutex_);
+    merged_chunk_ = i + 1;
+    cond_.notify_all();
+  }
+  threads.join_all();
+
+  if (csv && csv != stdout) fclose(csv);
+  if (archive) archive->close();
+  double elapsed = now() - start;
+
+  fprintf(stderr, "%s: %zu bytes in %zu chunks on %u threads.\n", options_.input.c_str(),
+          length_, chunks.size(), options_.threads);
+  fprintf(stderr, "%llu %s, %llu bad checksums, %llu resyncs, %llu junk bytes, %llu errors.\n",
+          static_cast<unsigned long long>(packets), frames_ ? "frames" : "packets",
+          static_cast<unsigned long long>(bad_checksums), static_cast<unsigned long long>(resyncs),
+          static_cast<unsigned long long>(junk_bytes), static_cast<unsigned long long>(errors));
+  fprintf(stderr, "%llu samples in %.3f s: %.0f samples/s, %.1f MB/s.\n",
+          static_cast<unsigned long long>(samples), elapsed, samples / elapsed, length_ / elapsed / 1e6);
+
+  if (options_.stats)
+  {
+    printf("%-12s %14s %14s %14s %14s\n", "channel", "mean", "stddev", "min", "max");
+    for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+    {
+      printf("%-12s %14.6g %14.6g %14.6g %14.6g\n", um6::Sample::channelName(c),
+             stats[c].mean(), stats[c].stddev(), stats[c].min(), stats[c].max());
+    }
+  }
+}
+
+/**
+ * Parses a whole decimal number from 1 to max, returning false for anything else.
+ */
+static bool parseCount(const char* text, long max, unsigned int* value)
+{
+  char* end;
+  errno = 0;
+  long parsed = strtol(text, &end, 10);
+  if (errno != 0 || end == text || *end != '\0' || parsed < 1 || parsed > max) return false;
+  *value = static_cast<unsigned int>(parsed);
+  return true;
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr,
+          "Usage: %s [options] INPUT\n"
+          "Converts a raw UM6 serial stream or register-frame log.\n\n"
+          "  -f FORMAT   output format: csv, archive or none (default none)\n"
+          "  -o PATH     output path, or - for stdout with csv (default -)\n"
+          "  -j THREADS  worker threads (default: number of cores)\n"
+          "  -c BYTES    input chunk size (default 8388608)\n"
+          "  -r HZ       broadcast rate used to stamp raw streams (default 20)\n"
+          "  -s          print summary statistics of each channel\n", name);
+}
+
+int main(int argc, char **argv)
+{
+  Options options;
+  options.output = "-";
+  options.format = "none";
+  options.threads = boost::thread::hardware_concurrency();
+  options.chunk_bytes = 8 << 20;
+  options.rate = 20.0;
+  options.stats = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:o:j:c:r:sh")) != -1)
+  {
+    switch (opt)
+    {
+    case 'f': options.format = optarg; break;
+    case 'o': options.output = optarg; break;
+    case 'j':
+      if (!parseCount(optarg, MAX_THREADS, &options.threads))
+      {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'c': options.chunk_bytes = strtoul(optarg, NULL, 10); break;
+    case 'r': options.rate = atof(optarg); break;
+    case 's': options.stats = true; break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1 || options.rate <= 0 || options.chunk_bytes == 0 ||
+      (options.format != "csv" && options.format != "archive" && options.format != "none") ||
+      (options.format == "archive" && options.output == "-"))
+  {
+    usage(argv[0]);
+    return 1;
+  }
+  if (options.threads < 1) options.threads = 1;
+  options.input = argv[optind];
+
+  int fd = open(options.input.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    fprintf(stderr, "Unable to open %s: %s\n", options.input.c_str(), strerror(errno));
+    return 1;
+  }
+  size_t length = st.st_size;
+  const uint8_t* data = NULL;
+  if (length > 0)
+  {
+    void* map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+      fprintf(stderr, "Unable to map %s: %s\n", options.input.c_str(), strerror(errno));
+      return 1;
+    }
+    madvise(map, length, MADV_SEQUENTIAL);
+    data = reinterpret_cast<const uint8_t*>(map);
+  }
+  close(fd);
+
+  try
+  {
+    Converter converter(options, data, length);
+    converter.split();
+    converter.run();
+  }
+  catch(const std::exception& e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
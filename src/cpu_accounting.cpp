@@ -0,0 +1,94 @@
+/**
+ *
+ *  \file
+ *  \brief      Per-stage thread CPU accounting.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/cpu_accounting.h"
+
+#include <string.h>
+#include <time.h>
+
+namespace um6
+{
+
+CpuAccounting::CpuAccounting() : stage_(NUM_STAGES), stage_start_ns_(0)
+{
+  memset(&totals_, 0, sizeof(totals_));
+}
+
+void CpuAccounting::enter(Stage stage)
+{
+  uint64_t now = threadCpuNanoseconds();
+  if (stage_ != NUM_STAGES)
+  {
+    totals_.cpu_ns[stage_] += now - stage_start_ns_;
+  }
+  stage_ = stage;
+  stage_start_ns_ = now;
+}
+
+CpuAccounting::Snapshot CpuAccounting::snapshot() const
+{
+  Snapshot s = totals_;
+  if (stage_ != NUM_STAGES)
+  {
+    s.cpu_ns[stage_] += threadCpuNanoseconds() - stage_start_ns_;
+  }
+  return s;
+}
+
+const char* CpuAccounting::stageName(int stage)
+{
+  static const char* names[NUM_STAGES] = { "read", "decode", "publish" };
+  return names[stage];
+}
+
+uint64_t CpuAccounting::threadCpuNanoseconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+uint64_t CpuAccounting::threadCpuNanoseconds(pthread_t thread)
+{
+  clockid_t clock;
+  struct timespec ts;
+  if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0)
+  {
+    return 0;
+  }
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+}  // namespace um6
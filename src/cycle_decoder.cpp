@@ -0,0 +1,92 @@
+/**
+ *
+ *  \file
+ *  \brief      Decoding of each completed cycle in the configured precision.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/cycle_decoder.h"
+
+#include "um6/registers.h"
+
+namespace um6
+{
+
+CycleDecoder::CycleDecoder(Precision precision, int lowpass_shift)
+  : precision_(precision), filtering_(lowpass_shift > 0),
+    lowpass_(1.0 / (1 << lowpass_shift)), lowpass_float_(1.0f / (1 << lowpass_shift)),
+    lowpass_fixed_(lowpass_shift)
+{}
+
+void CycleDecoder::decode(const Registers& registers, const ros::Time& stamp, Sample* sample)
+{
+  switch (precision_)
+  {
+  case DOUBLE:
+    decodeSample(registers, stamp.toSec(), sample);
+    if (filtering_) lowpass_.filter(sample);
+    break;
+  case FLOAT:
+    {
+      SampleF single;
+      decodeSample(registers, stamp.toSec(), &single);
+      if (filtering_) lowpass_float_.filter(&single);
+      convertSample(single, sample);
+    }
+    break;
+  case FIXED:
+    {
+      FixedSample fixed;
+      decodeFixedSample(registers, stamp.toNSec(), &fixed);
+      if (filtering_) lowpass_fixed_.filter(&fixed);
+      toSample(fixed, sample);
+    }
+    break;
+  }
+}
+
+void CycleDecoder::reset()
+{
+  lowpass_.reset();
+  lowpass_float_.reset();
+  lowpass_fixed_.reset();
+}
+
+bool CycleDecoder::parsePrecision(const std::string& name, Precision* precision)
+{
+  if (name == "double") *precision = DOUBLE;
+  else if (name == "float") *precision = FLOAT;
+  else if (name == "fixed") *precision = FIXED;
+  else return false;
+  return true;
+}
+
+}  // namespace um6
@@ -0,0 +1,337 @@
+/**
+ *
+ *  \file
+ *  \brief      Emulates a UM6 broadcasting a scripted trajectory, to a file or
+ *              a pseudo-terminal the driver can be pointed at.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "um6/comms.h"
+#include "um6/registers.h"
+#include "um6/sample.h"
+#include "um6/timed_output.h"
+#include "um6/trace.h"
+#include "um6/trajectory.h"
+
+// Played when no script is given: a little of everything the generator does.
+static const char DEFAULT_SCRIPT[] =
+  "5                                       # Settle.\n"
+  "4 rate=0,0,0.3927                       # Quarter turn left.\n"
+  "3 vibration=0.3,25                      # Engine running.\n"
+  "2 rate=0.5236,0,0                       # Roll right 60 degrees.\n"
+  "2 rate=-0.5236,0,0 vibration=0.1,40     # And back.\n"
+  "10 temperature_rate=0.5                 # Warming up.\n"
+  "3 mag=0.2,-0.1,0.05                     # Passing a steel beam.\n"
+  "5\n";
+
+static void usage(const char* name)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "Emulates a UM6 broadcasting a scripted trajectory, writing its byte stream to a\n"
+          "pseudo-terminal or a file, and the ground truth to a CSV file beside it.\n\n"
+          "  -s SCRIPT    trajectory script (default: a built-in demonstration)\n"
+          "  -o OUTPUT    file to write the stream to, or \"pty\" for a pseudo-terminal,\n"
+          "               whose name is printed, to point the driver's ~port at (default pty)\n"
+          "  -t TRUTH     CSV file of the true state and biases each cycle\n"
+          "  -r RATE      cycles per second (default 100)\n"
+          "  -d SECONDS   length of run (default: the script's length)\n"
+          "  -f           write as fast as possible, rather than at RATE in real time;\n"
+          "               the default for a file\n"
+          "  -n SEED      seed of the noise (default 1)\n"
+          "  -G W,B,R,T   gyro white noise, bias, bias random walk and bias per degree C\n"
+          "  -A W,B,R,T   the same for the accelerometer\n"
+          "  -M W,B,R,T   the same for the magnetometer\n"
+          "  -T SIGMA     temperature noise\n", name);
+}
+
+static bool parseNoise(const char* arg, um6::SensorNoise* noise)
+{
+  char extra;
+  return sscanf(arg, "%lf,%lf,%lf,%lf%c", &noise->white, &noise->bias, &noise->bias_walk,
+                &noise->bias_temperature, &extra) == 4;
+}
+
+static std::string registers(const um6::Registers& r, uint8_t index, uint8_t count)
+{
+  uint32_t words[16];
+  r.read_raw(index, count, words);
+  return std::string(reinterpret_cast<const char*>(words), count * 4);
+}
+
+/**
+ * The packets the device broadcasts each cycle, in the order it sends them,
+ * with the temperature which completes a cycle last.
+ */
+static void cycle(const um6::Registers& r, std::string* out)
+{
+  out->clear();
+  *out += um6::Comms::message(UM6_GYRO_PROC_XY, registers(r, UM6_GYRO_PROC_XY, 2));
+  *out += um6::Comms::message(UM6_ACCEL_PROC_XY, registers(r, UM6_ACCEL_PROC_XY, 2));
+  *out += um6::Comms::message(UM6_MAG_PROC_XY, registers(r, UM6_MAG_PROC_XY, 2));
+  *out += um6::Comms::message(UM6_EULER_PHI_THETA, registers(r, UM6_EULER_PHI_THETA, 2));
+  *out += um6::Comms::message(UM6_QUAT_AB, registers(r, UM6_QUAT_AB, 2));
+  *out += um6::Comms::message(UM6_ERROR_COV_00, registers(r, UM6_ERROR_COV_00, 15));
+  *out += um6::Comms::message(UM6_ERROR_COV_33, registers(r, UM6_ERROR_COV_33, 1));
+  *out += um6::Comms::message(UM6_TEMPERATURE, registers(r, UM6_TEMPERATURE, 1));
+}
+
+/**
+ * Acknowledges each packet the driver has written, as the device would, so
+ * that the driver's configuration goes through. What was written is otherwise
+ * ignored.
+ */
+static void acknowledge(int fd, std::string* pending, std::string* out)
+{
+  char buffer[256];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) pending->append(buffer, n);
+
+  size_t start;
+  while ((start = pending->find("snp")) != std::string::npos && pending->size() >= start + 5)
+  {
+    uint8_t type = (*pending)[start + 3], address = (*pending)[start + 4];
+    size_t length = 0;
+    if (type & um6::Comms::PACKET_HAS_DATA)
+    {
+      length = 4;
+      if (type & um6::Comms::PACKET_IS_BATCH)
+      {
+        length = 4 * ((type >> um6::Comms::PACKET_BATCH_LENGTH_OFFSET) & um6::Comms::PACKET_BATCH_LENGTH_MASK);
+      }
+    }
+    if (pending->size() < start + 5 + length + 2) break;
+    *out += um6::Comms::message(address, "");
+    pending->erase(0, start + 5 + length + 2);
+  }
+}
+
+static bool writeAll(int fd, const std::string& data)
+{
+  size_t written = 0;
+  while (written < data.size())
+  {
+    ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n > 0)
+    {
+      written += n;
+    }
+    else if (errno == EAGAIN)
+    {
+      // Nobody is reading the pseudo-terminal yet.
+      usleep(1000);
+    }
+    else if (errno != EINTR)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  std::string script_path, output = "pty", truth_path;
+  double rate = 100.0, duration = -1;
+  bool fast = false, fast_given = false;
+  uint32_t seed = 1;
+  um6::NoiseModel noise;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:o:t:r:d:fn:G:A:M:T:h")) != -1)
+  {
+    bool ok = true;
+    switch (opt)
+    {
+    case 's': script_path = optarg; break;
+    case 'o': output = optarg; break;
+    case 't': truth_path = optarg; break;
+    case 'r': rate = atof(optarg); break;
+    case 'd': duration = atof(optarg); break;
+    case 'f': fast = fast_given = true; break;
+    case 'n': seed = strtoul(optarg, NULL, 10); break;
+    case 'G': ok = parseNoise(optarg, &noise.gyro); break;
+    case 'A': ok = parseNoise(optarg, &noise.accel); break;
+    case 'M': ok = parseNoise(optarg, &noise.mag); break;
+    case 'T': noise.temperature = atof(optarg); break;
+    default: ok = false;
+    }
+    if (!ok)
+    {
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || !(rate > 0))
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<um6::TrajectorySegment> script;
+  try
+  {
+    if (script_path.empty())
+    {
+      std::istringstream in(DEFAULT_SCRIPT);
+      script = um6::parseTrajectory(in);
+    }
+    else
+    {
+      std::ifstream in(script_path.c_str());
+      if (!in)
+      {
+        fprintf(stderr, "Unable to open %s.\n", script_path.c_str());
+        return 1;
+      }
+      script = um6::parseTrajectory(in);
+    }
+  }
+  catch(const std::runtime_error& e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  um6::TrajectoryGenerator generator(script, noise, seed);
+  if (duration < 0) duration = generator.duration();
+
+  int fd;
+  bool pty = (output == "pty");
+  if (pty)
+  {
+    fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+    {
+      perror("Unable to open a pseudo-terminal");
+      return 1;
+    }
+    // Raw, as a serial port would be, until whoever opens it says otherwise.
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+      cfmakeraw(&tio);
+      tcsetattr(fd, TCSANOW, &tio);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    printf("%s\n", ptsname(fd));
+    fflush(stdout);
+  }
+  else
+  {
+    fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+      perror(output.c_str());
+      return 1;
+    }
+    if (!fast_given) fast = true;
+  }
+
+  FILE* truth_file = NULL;
+  if (!truth_path.empty())
+  {
+    truth_file = fopen(truth_path.c_str(), "w");
+    if (!truth_file)
+    {
+      perror(truth_path.c_str());
+      return 1;
+    }
+    fprintf(truth_file, "wall_time,time");
+    for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++) fprintf(truth_file, ",%s", um6::Sample::channelName(c));
+    static const char* sensors[] = { "gyro", "accel", "mag" };
+    for (int s = 0; s < 3; s++)
+    {
+      fprintf(truth_file, ",%s_bias_x,%s_bias_y,%s_bias_z", sensors[s], sensors[s], sensors[s]);
+    }
+    fprintf(truth_file, "\n");
+  }
+
+  um6::PhaseTimer timer(static_cast<uint64_t>(1e9 / rate + 0.5), 0);
+  um6::Registers r;
+  um6::Sample truth, measured;
+  std::string out, pending;
+  const uint64_t cycles = static_cast<uint64_t>(duration * rate + 0.5);
+  uint64_t bytes = 0, truth_ns = 0;
+  uint64_t start_ns = um6::traceClock();
+  for (uint64_t i = 0; i < cycles; i++)
+  {
+    uint64_t wall_ns = fast ? um6::PhaseTimer::now() : timer.wait();
+    generator.step(1.0 / rate, &truth, &measured);
+    um6::encodeSample(measured, &r);
+    cycle(r, &out);
+    if (pty) acknowledge(fd, &pending, &out);
+    if (!writeAll(fd, out))
+    {
+      perror("Unable to write");
+      return 1;
+    }
+    bytes += out.size();
+
+    if (truth_file)
+    {
+      uint64_t truth_start = um6::traceClock();
+      fprintf(truth_file, "%.9f,%.6f", wall_ns * 1e-9, truth.stamp);
+      for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++) fprintf(truth_file, ",%.9g", truth.channel[c]);
+      const double* biases[] = { generator.gyroBias(), generator.accelBias(), generator.magBias() };
+      for (int s = 0; s < 3; s++)
+      {
+        fprintf(truth_file, ",%.9g,%.9g,%.9g", biases[s][0], biases[s][1], biases[s][2]);
+      }
+      fprintf(truth_file, "\n");
+      truth_ns += um6::traceClock() - truth_start;
+    }
+  }
+  double seconds = (um6::traceClock() - start_ns) * 1e-9;
+
+  if (truth_file) fclose(truth_file);
+  close(fd);
+  fprintf(stderr, "%llu cycles, %llu bytes in %.3fs: %.0f cycles/s, %.2f MB/s",
+          static_cast<unsigned long long>(cycles), static_cast<unsigned long long>(bytes), seconds,
+          cycles / seconds, bytes / seconds * 1e-6);
+  if (truth_file) fprintf(stderr, ", of which %.3fs writing truth", truth_ns * 1e-9);
+  if (!fast) fprintf(stderr, ", %llu late", static_cast<unsigned long long>(timer.missed()));
+  fprintf(stderr, ".\n");
+  return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ *
+ *  \file
+ *  \brief      Detection of shocks and rapid rotations from single packets, ahead
+ *              of the rest of their cycle.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#include "um6/event_detector.h"
+
+#include <math.h>
+
+namespace um6
+{
+
+EventDetector::EventDetector(double shock_threshold, double rotation_threshold, double holdoff)
+  : holdoff_(holdoff)
+{
+  Registers r;
+  const double thresholds[NUM_TYPES] = { shock_threshold, rotation_threshold };
+  const double scales[NUM_TYPES] = { r.accel.scale(), r.gyro.scale() };
+  for (int t = 0; t < NUM_TYPES; t++)
+  {
+    Detector& d = detectors_[t];
+    d.enabled = thresholds[t] > 0;
+    d.armed = true;
+    d.threshold = thresholds[t];
+    d.last_event = -holdoff;
+    double counts = thresholds[t] / scales[t];
+    d.threshold_squared = static_cast<int64_t>(counts * counts);
+  }
+}
+
+bool EventDetector::check(int16_t address, const Registers& r, double now, Event* event)
+{
+  if (address == UM6_ACCEL_PROC_XY && detectors_[SHOCK].enabled)
+  {
+    return check(SHOCK, r.accel, now, event);
+  }
+  if (address == UM6_GYRO_PROC_XY && detectors_[ROTATION].enabled)
+  {
+    return check(ROTATION, r.gyro, now, event);
+  }
+  return false;
+}
+
+bool EventDetector::check(Type type, const Accessor<int16_t>& reg, double now, Event* event)
+{
+  Detector& d = detectors_[type];
+  int64_t f0 = reg.get(0), f1 = reg.get(1), f2 = reg.get(2);
+  int64_t squared = f0 * f0 + f1 * f1 + f2 * f2;
+  if (squared <= d.threshold_squared)
+  {
+    if (!d.armed && now - d.last_event >= holdoff_) d.armed = true;
+    return false;
+  }
+  if (!d.armed) return false;
+
+  d.armed = false;
+  d.last_event = now;
+  event->type = type;
+  event->magnitude = sqrt(static_cast<double>(squared)) * reg.scale();
+
+  // NED -> ENU conversion, as in decodeSample.
+  event->vector[0] = f1 * reg.scale();
+  event->vector[1] = f0 * reg.scale();
+  event->vector[2] = -f2 * reg.scale();
+  return true;
+}
+
+void EventDetector::reset()
+{
+  for (int t = 0; t < NUM_TYPES; t++)
+  {
+    detectors_[t].armed = true;
+    detectors_[t].last_event = -holdoff_;
+  }
+}
+
+const char* EventDetector::typeName(Type type)
+{
+  static const char* names[NUM_TYPES] = { "shock", "rotation" };
+  return type >= 0 && type < NUM_TYPES ? names[type] : "unknown";
+}
+
+}  // namespace um6
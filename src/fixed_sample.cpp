@@ -0,0 +1,124 @@
+/**
+ *
+ *  \file
+ *  \brief      Fixed-point decode, frame conversion and filtering.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/fixed_sample.h"
+
+#include <stdexcept>
+
+#include "um6/registers.h"
+
+namespace um6
+{
+
+void decodeFixedSample(const Registers& r, uint64_t stamp_ns, FixedSample* s)
+{
+  s->stamp_ns = stamp_ns;
+
+  // NED -> ENU conversion, as in decodeSample.
+  s->channel[Sample::GYRO_X] = toQ16(r.gyro.get(1), FixedScale::GYRO);
+  s->channel[Sample::GYRO_Y] = toQ16(r.gyro.get(0), FixedScale::GYRO);
+  s->channel[Sample::GYRO_Z] = -toQ16(r.gyro.get(2), FixedScale::GYRO);
+
+  s->channel[Sample::ACCEL_X] = toQ16(r.accel.get(1), FixedScale::ACCEL);
+  s->channel[Sample::ACCEL_Y] = toQ16(r.accel.get(0), FixedScale::ACCEL);
+  s->channel[Sample::ACCEL_Z] = -toQ16(r.accel.get(2), FixedScale::ACCEL);
+
+  s->channel[Sample::MAG_X] = toQ16(r.mag.get(1), FixedScale::MAG);
+  s->channel[Sample::MAG_Y] = toQ16(r.mag.get(0), FixedScale::MAG);
+  s->channel[Sample::MAG_Z] = -toQ16(r.mag.get(2), FixedScale::MAG);
+
+  s->channel[Sample::ROLL] = toQ16(r.euler.get(1), FixedScale::EULER);
+  s->channel[Sample::PITCH] = toQ16(r.euler.get(0), FixedScale::EULER);
+  s->channel[Sample::YAW] = -toQ16(r.euler.get(2), FixedScale::EULER);
+
+  // IMU outputs [w,x,y,z] NED, convert to [x,y,z,w] ENU
+  s->channel[Sample::QUAT_X] = toQ16(r.quat.get(2), FixedScale::QUAT);
+  s->channel[Sample::QUAT_Y] = toQ16(r.quat.get(1), FixedScale::QUAT);
+  s->channel[Sample::QUAT_Z] = -toQ16(r.quat.get(3), FixedScale::QUAT);
+  s->channel[Sample::QUAT_W] = toQ16(r.quat.get(0), FixedScale::QUAT);
+
+  // Byte copies only; the conversion to double is left to toSample.
+  s->temperature = r.temperature.get(0);
+  static const uint8_t cov_fields[9] = { 5, 6, 7, 9, 10, 11, 13, 14, 15 };
+  for (uint8_t i = 0; i < 9; i++)
+  {
+    s->orientation_covariance[i] = r.covariance.get(cov_fields[i]);
+  }
+}
+
+void toSample(const FixedSample& f, Sample* s)
+{
+  s->stamp = f.stamp_ns * 1e-9;
+  for (int i = 0; i < FixedSample::NUM_CHANNELS; i++)
+  {
+    s->channel[i] = fromQ16(f.channel[i]);
+  }
+  s->channel[Sample::TEMPERATURE] = f.temperature;
+  for (int i = 0; i < 9; i++)
+  {
+    s->orientation_covariance[i] = f.orientation_covariance[i];
+  }
+}
+
+FixedLowPass::FixedLowPass(int shift) : shift_(shift), primed_(false)
+{
+  if (shift < 0 || shift > MAX_SHIFT)
+  {
+    throw std::runtime_error("Low-pass shift must be between 0 and 8.");
+  }
+}
+
+void FixedLowPass::filter(FixedSample* s)
+{
+  q16_t* x = s->channel + FIRST;
+  if (!primed_)
+  {
+    for (int i = 0; i <= LAST - FIRST; i++)
+    {
+      state_[i] = x[i] * (1 << shift_);
+    }
+    primed_ = true;
+    return;
+  }
+
+  // state = y * 2^shift, so y += (x - y) * 2^-shift becomes state += x - y.
+  for (int i = 0; i <= LAST - FIRST; i++)
+  {
+    state_[i] += x[i] - (state_[i] >> shift_);
+    x[i] = state_[i] >> shift_;
+  }
+}
+
+}  // namespace um6
@@ -0,0 +1,299 @@
+/**
+ *
+ *  \file
+ *  \brief      Implementation of the packet flight recorder.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/flight_recorder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+namespace um6
+{
+
+const size_t FlightRecorder::MAX_PAYLOAD;
+
+static uint64_t clockNs(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+FlightRecorder::FlightRecorder(size_t capacity, double window, const std::string& default_path)
+  : records_(new Record[std::max<size_t>(capacity, 1)]), capacity_(std::max<size_t>(capacity, 1)),
+    next_(0), window_ns_(window * 1e9)
+{
+  for (size_t i = 0; i < capacity_; i++)
+  {
+    records_[i].sequence.store(0);
+  }
+  strncpy(default_path_, default_path.c_str(), sizeof(default_path_) - 1);
+  default_path_[sizeof(default_path_) - 1] = '\0';
+}
+
+void FlightRecorder::record(RecordType type, const void* data, size_t length)
+{
+  uint32_t ticket = next_.fetch_add(1, boost::memory_order_relaxed);
+  Record& r = records_[ticket % capacity_];
+
+  // Mark the slot busy while it's rewritten, so a concurrent dump skips it.
+  r.sequence.store(0, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_release);
+
+  r.type = type;
+  r.length = std::min(length, MAX_PAYLOAD);
+  r.stamp_ns = clockNs(CLOCK_MONOTONIC);
+  memcpy(r.data, data, r.length);
+
+  r.sequence.store(ticket + 1, boost::memory_order_release);
+}
+
+namespace
+{
+
+/**
+ * Minimal buffered text output onto a file descriptor, since stdio isn't
+ * safe to use from a signal handler.
+ */
+class DumpWriter
+{
+public:
+  explicit DumpWriter(int fd) : fd_(fd), used_(0), ok_(true)
+  {
+  }
+
+  void put(const char* s)
+  {
+    while (*s) putc(*s++);
+  }
+
+  void putc(char c)
+  {
+    if (used_ == sizeof(buffer_)) flush();
+    buffer_[used_++] = c;
+  }
+
+  void putStamp(uint64_t ns)
+  {
+    putDecimal(ns / 1000000000ull, 1);
+    putc('.');
+    putDecimal(ns % 1000000000ull, 9);
+  }
+
+  void putDecimal(uint64_t value, int min_digits)
+  {
+    char digits[24];
+    int n = 0;
+    do
+    {
+      digits[n++] = '0' + value % 10;
+      value /= 10;
+    }
+    while (value > 0 || n < min_digits);
+    while (n > 0) putc(digits[--n]);
+  }
+
+  void putHex(uint8_t byte)
+  {
+    static const char hex[] = "0123456789abcdef";
+    putc(hex[byte >> 4]);
+    putc(hex[byte & 0xF]);
+  }
+
+  bool flush()
+  {
+    const char* p = buffer_;
+    while (used_ > 0 && ok_)
+    {
+      ssize_t written = ::write(fd_, p, used_);
+      if (written <= 0)
+      {
+        ok_ = false;
+        break;
+      }
+      p += written;
+      used_ -= written;
+    }
+    used_ = 0;
+    return ok_;
+  }
+
+private:
+  int fd_;
+  char buffer_[4096];
+  size_t used_;
+  bool ok_;
+};
+
+const char* typeName(uint8_t type)
+{
+  switch (type)
+  {
+    case FlightRecorder::RX_PACKET: return "rx";
+    case FlightRecorder::RX_BAD_CHECKSUM: return "rx-bad-checksum";
+    case FlightRecorder::RX_JUNK: return "rx-junk";
+    case FlightRecorder::TX_PACKET: return "tx";
+    case FlightRecorder::EVENT: return "event";
+  }
+  return "unknown";
+}
+
+}  // namespace
+
+bool FlightRecorder::dump(const char* path) const
+{
+  char tmp_path[PATH_MAX + 8];
+  size_t path_length = strlen(path);
+  if (path_length == 0 || path_length >= PATH_MAX) return false;
+  memcpy(tmp_path, path, path_length);
+  memcpy(tmp_path + path_length, ".tmp", 5);
+
+  // The temporary file is always created afresh and never through a link, since its name is predictable. One left
+  // behind by an interrupted dump is unlinked (which removes a link rather than following it) and the create retried.
+  const int flags = O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW;
+  int fd = ::open(tmp_path, flags, 0644);
+  if (fd < 0 && errno == EEXIST && unlink(tmp_path) == 0)
+  {
+    fd = ::open(tmp_path, flags, 0644);
+  }
+  if (fd < 0) return false;
+
+  uint64_t now = clockNs(CLOCK_MONOTONIC);
+  DumpWriter out(fd);
+  out.put("# um6 flight recorder dump. Stamps are CLOCK_MONOTONIC; at ");
+  out.putStamp(now);
+  out.put(" the realtime clock read ");
+  out.putStamp(clockNs(CLOCK_REALTIME));
+  out.put(".\n");
+
+  uint32_t end = next_.load(boost::memory_order_acquire);
+  uint32_t count = std::min<uint32_t>(end, capacity_);
+  for (uint32_t i = end - count; i != end; i++)
+  {
+    const Record& r = records_[i % capacity_];
+    uint32_t sequence = r.sequence.load(boost::memory_order_acquire);
+    if (sequence != i + 1) continue;
+
+    uint8_t type = r.type;
+    uint8_t length = std::min<uint8_t>(r.length, MAX_PAYLOAD);
+    uint64_t stamp_ns = r.stamp_ns;
+    uint8_t data[MAX_PAYLOAD];
+    memcpy(data, r.data, length);
+
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    if (r.sequence.load(boost::memory_order_relaxed) != sequence) continue;
+    if (now - stamp_ns > window_ns_) continue;
+
+    out.putStamp(stamp_ns);
+    out.putc(' ');
+    out.put(typeName(type));
+    for (uint8_t b = 0; b < length; b++)
+    {
+      if (type == EVENT)
+      {
+        if (b == 0) out.putc(' ');
+        out.putc(data[b] >= ' ' && data[b] <= '~' ? data[b] : '.');
+      }
+      else
+      {
+        out.putc(' ');
+        out.putHex(data[b]);
+      }
+    }
+    out.putc('\n');
+  }
+
+  bool ok = out.flush();
+  ok = (fsync(fd) == 0) && ok;
+  ok = (::close(fd) == 0) && ok;
+  if (!ok || rename(tmp_path, path) != 0)
+  {
+    unlink(tmp_path);
+    return false;
+  }
+  return true;
+}
+
+static FlightRecorder* signal_recorder = NULL;
+
+bool FlightRecorder::requestPath(const std::string& name, std::string* path) const
+{
+  if (name.empty())
+  {
+    *path = default_path_;
+    return true;
+  }
+  if (name.find('/') != std::string::npos || name[0] == '.') return false;
+
+  const char* slash = strrchr(default_path_, '/');
+  *path = slash ? std::string(default_path_, slash + 1) + name : name;
+  return true;
+}
+
+static void dumpOnSignal(int signum)
+{
+  if (signal_recorder)
+  {
+    signal_recorder->dump();
+  }
+  // The handler was installed with SA_RESETHAND, so this gets the default action.
+  raise(signum);
+}
+
+void FlightRecorder::installSignalHandlers(FlightRecorder* recorder)
+{
+  signal_recorder = recorder;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = dumpOnSignal;
+  action.sa_flags = SA_RESETHAND | SA_NODEFER;
+  sigemptyset(&action.sa_mask);
+
+  const int signals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE };
+  for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++)
+  {
+    sigaction(signals[i], &action, NULL);
+  }
+}
+
+}  // namespace um6
@@ -0,0 +1,131 @@
+/**
+ *
+ *  \file
+ *  \brief      Implementation of buffer-based packet framing.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/framer.h"
+
+#include <string.h>
+
+#include <string>
+
+#include "um6/comms.h"
+#include "um6/registers.h"
+
+namespace um6
+{
+
+const int16_t Framer::NEED_MORE = -2;
+const size_t Framer::SEARCH_LENGTH = 96;
+
+int16_t Framer::parse(const uint8_t* data, size_t length, size_t* consumed, Registers* registers)
+{
+  *consumed = 0;
+
+  // Optimistically assume that the next five bytes are a packet header.
+  if (length < 5) return NEED_MORE;
+  size_t pos = 5;
+
+  uint8_t type, address;
+  if (memcmp(data, "snp", 3) == 0)
+  {
+    type = data[3];
+    address = data[4];
+  }
+  else
+  {
+    // As Serial::readline, read up to SEARCH_LENGTH bytes, stopping early at "snp".
+    size_t searched = 0;
+    bool found = false;
+    while (searched < SEARCH_LENGTH)
+    {
+      if (pos + searched >= length) return NEED_MORE;
+      searched++;
+      if (searched >= 3 && memcmp(data + pos + searched - 3, "snp", 3) == 0)
+      {
+        found = true;
+        break;
+      }
+    }
+    pos += searched;
+    resyncs_++;
+    junk_bytes_ += 5 + searched - (found ? 3 : 0);
+    if (!found)
+    {
+      *consumed = pos;
+      return -1;
+    }
+    if (pos + 2 > length) return NEED_MORE;
+    type = data[pos++];
+    address = data[pos++];
+  }
+
+  uint16_t checksum_calculated = 's' + 'n' + 'p' + type + address;
+  size_t data_bytes = 0;
+  if (type & Comms::PACKET_HAS_DATA)
+  {
+    uint8_t data_length = 1;
+    if (type & Comms::PACKET_IS_BATCH)
+    {
+      data_length = (type >> Comms::PACKET_BATCH_LENGTH_OFFSET) & Comms::PACKET_BATCH_LENGTH_MASK;
+    }
+    data_bytes = data_length * 4;
+  }
+  if (pos + data_bytes + 2 > length) return NEED_MORE;
+
+  const uint8_t* packet_data = data + pos;
+  for (size_t i = 0; i < data_bytes; i++)
+  {
+    checksum_calculated += packet_data[i];
+  }
+  pos += data_bytes;
+
+  uint16_t checksum_transmitted = (data[pos] << 8) | data[pos + 1];
+  pos += 2;
+  *consumed = pos;
+
+  if (checksum_transmitted != checksum_calculated)
+  {
+    bad_checksums_++;
+    return -1;
+  }
+
+  packets_++;
+  if (data_bytes > 0 && registers)
+  {
+    registers->write_raw(address, std::string(reinterpret_cast<const char*>(packet_data), data_bytes));
+  }
+  return address;
+}
+
+}  // namespace um6
@@ -0,0 +1,352 @@
+/**
+ *
+ *  \file
+ *  \brief      Per-stage latency histograms and Chrome trace export.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/latency.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+
+#include "um6/firmware_registers.h"
+#include "um6/trace.h"
+
+namespace um6
+{
+
+namespace
+{
+const int HALF_BITS = LatencyHistogram::SUB_BUCKET_BITS - 1;
+const uint64_t SUB_BUCKETS = 1ull << LatencyHistogram::SUB_BUCKET_BITS;
+const uint64_t HALF_SUB_BUCKETS = SUB_BUCKETS >> 1;
+const int HIGHEST_BIT = 40;
+
+int highestBit(uint64_t v)
+{
+  int bit = 0;
+  while (v >>= 1) bit++;
+  return bit;
+}
+}  // namespace
+
+const size_t LatencyHistogram::BUCKET_COUNT =
+  (HIGHEST_BIT - SUB_BUCKET_BITS + 2) * HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+
+LatencyHistogram::LatencyHistogram() : counts_(BUCKET_COUNT)
+{
+  reset();
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t ns)
+{
+  if (ns < SUB_BUCKETS) return ns;
+  int bit = highestBit(ns);
+  if (bit > HIGHEST_BIT) return BUCKET_COUNT - 1;
+  int shift = bit - SUB_BUCKET_BITS + 1;
+  return shift * HALF_SUB_BUCKETS + (ns >> shift);
+}
+
+uint64_t LatencyHistogram::bucketLowest(size_t index)
+{
+  if (index < SUB_BUCKETS) return index;
+  uint64_t shift = (index >> HALF_BITS) - 1;
+  return (index - shift * HALF_SUB_BUCKETS) << shift;
+}
+
+uint64_t LatencyHistogram::bucketHighest(size_t index)
+{
+  if (index < SUB_BUCKETS) return index;
+  uint64_t shift = (index >> HALF_BITS) - 1;
+  return bucketLowest(index) + (1ull << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+  counts_[bucketIndex(ns)]++;
+  count_++;
+  total_ += ns;
+  if (ns < min_) min_ = ns;
+  if (ns > max_) max_ = ns;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+  for (size_t i = 0; i < BUCKET_COUNT; i++)
+  {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  total_ += other.total_;
+  if (other.min_ < min_) min_ = other.min_;
+  if (other.max_ > max_) max_ = other.max_;
+}
+
+void LatencyHistogram::reset()
+{
+  std::fill(counts_.begin(), counts_.end(), 0);
+  count_ = 0;
+  total_ = 0;
+  min_ = std::numeric_limits<uint64_t>::max();
+  max_ = 0;
+}
+
+uint64_t LatencyHistogram::min() const
+{
+  return count_ > 0 ? min_ : 0;
+}
+
+double LatencyHistogram::mean() const
+{
+  return count_ > 0 ? total_ / count_ : 0;
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const
+{
+  if (count_ == 0) return 0;
+  uint64_t rank = static_cast<uint64_t>(percent / 100.0 * count_ + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > count_) rank = count_;
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKET_COUNT; i++)
+  {
+    seen += counts_[i];
+    if (seen >= rank)
+    {
+      uint64_t highest = bucketHighest(i);
+      return highest < max_ ? highest : max_;
+    }
+  }
+  return max_;
+}
+
+LatencyTracer::LatencyTracer(size_t trace_capacity)
+  : traces_(trace_capacity), next_trace_(0), trace_count_(0), in_cycle_(false)
+{
+}
+
+void LatencyTracer::mark(Mark m)
+{
+  mark(m, traceClock());
+}
+
+void LatencyTracer::mark(Mark m, uint64_t ns)
+{
+  if (m == FIRST_PACKET)
+  {
+    in_cycle_ = true;
+  }
+  else if (!in_cycle_)
+  {
+    return;
+  }
+  current_.stamp[m] = ns;
+
+  if (m == SPUN)
+  {
+    in_cycle_ = false;
+    for (int stage = 0; stage < NUM_STAGES; stage++)
+    {
+      histograms_[stage].record(current_.stamp[stage + 1] - current_.stamp[stage]);
+    }
+    histograms_[NUM_STAGES].record(current_.stamp[SPUN] - current_.stamp[FIRST_PACKET]);
+
+    if (!traces_.empty())
+    {
+      traces_[next_trace_] = current_;
+      next_trace_ = (next_trace_ + 1) % traces_.size();
+      if (trace_count_ < traces_.size()) trace_count_++;
+    }
+  }
+}
+
+const char* LatencyTracer::stageName(int stage)
+{
+  static const char* names[NUM_STAGES + 1] =
+  {
+    "receive", "decode", "publish", "log", "spin", "total"
+  };
+  return names[stage];
+}
+
+void LatencyTracer::writeSummary(std::ostream& out) const
+{
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(1);
+  for (int stage = 0; stage <= NUM_STAGES; stage++)
+  {
+    const LatencyHistogram& h = histograms_[stage];
+    out << stageName(stage) << ": n=" << h.count()
+        << " mean=" << h.mean() / 1e3
+        << "us p50=" << h.percentile(50) / 1e3
+        << "us p90=" << h.percentile(90) / 1e3
+        << "us p99=" << h.percentile(99) / 1e3
+        << "us max=" << h.max() / 1e3 << "us\n";
+  }
+  out.flags(flags);
+}
+
+void LatencyTracer::writeChromeTrace(std::ostream& out) const
+{
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  size_t oldest = (next_trace_ + traces_.size() - trace_count_) % (traces_.empty() ? 1 : traces_.size());
+  for (size_t t = 0; t < trace_count_; t++)
+  {
+    const Trace& trace = traces_[(oldest + t) % traces_.size()];
+    for (int stage = 0; stage < NUM_STAGES; stage++)
+    {
+      out << (first ? "\n" : ",\n");
+      first = false;
+      out << "{\"name\":\"" << stageName(stage) << "\",\"cat\":\"um6\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+          << ",\"ts\":" << trace.stamp[stage] / 1e3
+          << ",\"dur\":" << (trace.stamp[stage + 1] - trace.stamp[stage]) / 1e3 << "}";
+    }
+  }
+  out << "\n]}\n";
+  out.flags(flags);
+}
+
+void LatencyTracer::reset()
+{
+  for (int stage = 0; stage <= NUM_STAGES; stage++)
+  {
+    histograms_[stage].reset();
+  }
+  next_trace_ = 0;
+  trace_count_ = 0;
+  in_cycle_ = false;
+}
+
+ChannelLatency::ChannelLatency()
+{
+  discard();
+}
+
+int ChannelLatency::arrived(int16_t address, uint64_t ns)
+{
+  int channel = channelOf(address);
+  if (channel >= 0)
+  {
+    arrival_[channel] = ns;
+    pending_[channel] = true;
+    pending_early_[channel] = true;
+  }
+  return channel;
+}
+
+void ChannelLatency::publishedEarly(Channel channel, uint64_t ns)
+{
+  if (!pending_early_[channel]) return;
+  pending_early_[channel] = false;
+  early_[channel].record(ns - arrival_[channel]);
+}
+
+void ChannelLatency::published(uint64_t ns)
+{
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+  {
+    if (!pending_[channel]) continue;
+    cycle_[channel].record(ns - arrival_[channel]);
+  }
+  discard();
+}
+
+void ChannelLatency::discard()
+{
+  std::fill(pending_, pending_ + NUM_CHANNELS, false);
+  std::fill(pending_early_, pending_early_ + NUM_CHANNELS, false);
+}
+
+int ChannelLatency::channelOf(int16_t address)
+{
+  switch (address)
+  {
+  case UM6_GYRO_PROC_XY: return GYRO;
+  case UM6_ACCEL_PROC_XY: return ACCEL;
+  case UM6_MAG_PROC_XY: return MAG;
+  case UM6_EULER_PHI_THETA: return EULER;
+  case UM6_QUAT_AB: return QUAT;
+  case UM6_ERROR_COV_00:
+  case UM6_ERROR_COV_33: return COVARIANCE;
+  case UM6_TEMPERATURE: return TEMPERATURE;
+  default: return -1;
+  }
+}
+
+const char* ChannelLatency::channelName(int channel)
+{
+  static const char* names[NUM_CHANNELS] =
+  {
+    "gyro", "accel", "mag", "euler", "quat", "covariance", "temperature"
+  };
+  return names[channel];
+}
+
+void ChannelLatency::writeSummary(std::ostream& out) const
+{
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(1);
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+  {
+    const LatencyHistogram& h = cycle_[channel];
+    if (h.count() == 0) continue;
+    out << channelName(channel) << ": n=" << h.count()
+        << " mean=" << h.mean() / 1e3
+        << "us p99=" << h.percentile(99) / 1e3 << "us";
+    const LatencyHistogram& e = early_[channel];
+    if (e.count() > 0)
+    {
+      out << " early mean=" << e.mean() / 1e3
+          << "us p99=" << e.percentile(99) / 1e3
+          << "us saved=" << (h.mean() - e.mean()) / 1e3 << "us";
+    }
+    out << "\n";
+  }
+  out.flags(flags);
+}
+
+void ChannelLatency::reset()
+{
+  discard();
+  for (int channel = 0; channel < NUM_CHANNELS; channel++)
+  {
+    cycle_[channel].reset();
+    early_[channel].reset();
+  }
+}
+
+}  // namespace um6
@@ -0,0 +1,189 @@
+/**
+ *
+ *  \file
+ *  \brief      Link quality estimate and baud rate fallback policy.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/link_quality.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace um6
+{
+
+namespace
+{
+const uint32_t BAUD_RATES[] = { 9600, 14400, 19200, 38400, 57600, 115200 };
+const int NUM_BAUD_RATES = sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]);
+
+// The UM6 broadcasts at 20Hz plus 280/255Hz per count of the rate field.
+const double BROADCAST_MIN_HZ = 20.0;
+const double BROADCAST_HZ_PER_COUNT = 280.0 / 255.0;
+
+const double MAX_PROBE_BACKOFF = 8.0;
+}  // namespace
+
+int baudRateCode(uint32_t baud)
+{
+  for (int code = 0; code < NUM_BAUD_RATES; code++)
+  {
+    if (BAUD_RATES[code] == baud) return code;
+  }
+  return -1;
+}
+
+bool broadcastRateField(uint32_t baud, size_t bytes_per_cycle, double utilisation, uint8_t* field)
+{
+  double max_hz = baud / 10.0 * utilisation / bytes_per_cycle;
+  double counts = floor((max_hz - BROADCAST_MIN_HZ) / BROADCAST_HZ_PER_COUNT);
+  *field = static_cast<uint8_t>(std::max(0.0, std::min(255.0, counts)));
+  return counts >= 0;
+}
+
+double broadcastRateHz(uint8_t field)
+{
+  return BROADCAST_MIN_HZ + field * BROADCAST_HZ_PER_COUNT;
+}
+
+LinkQuality::LinkQuality(double time_constant)
+  : time_constant_(time_constant), quality_(1.0), junk_rate_(0), resync_rate_(0), last_time_(0)
+{
+  memset(&last_, 0, sizeof(last_));
+}
+
+void LinkQuality::reset(const Comms::Counters& counters, double now)
+{
+  quality_ = 1.0;
+  junk_rate_ = 0;
+  resync_rate_ = 0;
+  last_ = counters;
+  last_time_ = now;
+}
+
+void LinkQuality::restore(double quality, double junk_rate, double resync_rate)
+{
+  quality_ = std::max(0.0, std::min(1.0, quality));
+  junk_rate_ = std::max(0.0, junk_rate);
+  resync_rate_ = std::max(0.0, resync_rate);
+}
+
+void LinkQuality::update(const Comms::Counters& counters, double now)
+{
+  double dt = now - last_time_;
+  if (dt <= 0) return;
+
+  uint64_t good = counters.packets - last_.packets;
+  uint64_t bad = (counters.bad_checksums - last_.bad_checksums) + (counters.resyncs - last_.resyncs);
+  uint64_t timeouts = counters.timeouts - last_.timeouts;
+  double alpha = 1.0 - exp(-dt / time_constant_);
+
+  if (good + bad > 0)
+  {
+    quality_ += alpha * (static_cast<double>(good) / (good + bad) - quality_);
+  }
+  else if (timeouts > 0)
+  {
+    quality_ += alpha * (0.0 - quality_);
+  }
+  junk_rate_ += alpha * ((counters.junk_bytes - last_.junk_bytes) / dt - junk_rate_);
+  resync_rate_ += alpha * ((counters.resyncs - last_.resyncs) / dt - resync_rate_);
+
+  last_ = counters;
+  last_time_ = now;
+}
+
+BaudController::BaudController(const std::vector<uint32_t>& rates, double threshold, double hold,
+                               double probe_interval)
+  : rates_(rates), threshold_(threshold), hold_(hold), base_probe_interval_(probe_interval),
+    probe_interval_(probe_interval), index_(0), last_change_(0), below_since_(-1), probing_(false)
+{
+}
+
+void BaudController::reset(uint32_t baud, double now)
+{
+  index_ = std::find(rates_.begin(), rates_.end(), baud) - rates_.begin();
+  if (index_ >= rates_.size()) index_ = 0;
+  last_change_ = now;
+  below_since_ = -1;
+  probing_ = false;
+}
+
+void BaudController::setProbeInterval(double probe_interval)
+{
+  probe_interval_ = std::max(base_probe_interval_, std::min(base_probe_interval_ * MAX_PROBE_BACKOFF, probe_interval));
+}
+
+void BaudController::linkLost()
+{
+  // A probe which failed makes the next one wait longer.
+  if (probing_)
+  {
+    probe_interval_ = std::min(probe_interval_ * 2, base_probe_interval_ * MAX_PROBE_BACKOFF);
+  }
+  probing_ = false;
+}
+
+uint32_t BaudController::update(double quality, double now)
+{
+  if (quality < threshold_)
+  {
+    if (below_since_ < 0) below_since_ = now;
+    if (now - below_since_ < hold_ || index_ + 1 >= rates_.size()) return 0;
+
+    linkLost();
+    index_++;
+    below_since_ = -1;
+    last_change_ = now;
+    return rates_[index_];
+  }
+
+  below_since_ = -1;
+  if (probing_ && now - last_change_ >= 2 * hold_)
+  {
+    probing_ = false;
+    probe_interval_ = base_probe_interval_;
+  }
+  if (!probing_ && index_ > 0 && now - last_change_ >= probe_interval_)
+  {
+    index_--;
+    probing_ = true;
+    last_change_ = now;
+    return rates_[index_];
+  }
+  return 0;
+}
+
+}  // namespace um6
@@ -32,22 +32,73 @@
  * Please send comments, questions, or patches to code@clearpathrobotics.com
  *
  */
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <fstream>
+#include <sstream>
 #include <string>
+#include <vector>
 
+#include "diagnostic_updater/diagnostic_updater.h"
 #include "geometry_msgs/Vector3Stamped.h"
 #include "ros/ros.h"
 #include "sensor_msgs/Imu.h"
 #include "serial/serial.h"
 #include "std_msgs/Float32.h"
 #include "std_msgs/Header.h"
+#include "um6/archive.h"
+#include "um6/fan_out.h"
+#include "um6/async_log.h"
 #include "um6/comms.h"
+#include "um6/cpu_accounting.h"
+#include "um6/cycle_decoder.h"
+#include "um6/deadband.h"
+#include "um6/event_detector.h"
+#include "um6/DumpFlightRecorder.h"
+#include "um6/DumpLatencyTrace.h"
+#include "um6/fixed_sample.h"
+#include "um6/flight_recorder.h"
+#include "um6/latency.h"
+#include "um6/link_quality.h"
+#include "um6/messages.h"
+#include "um6/metrics.h"
+#include "um6/register_log.h"
 #include "um6/registers.h"
 #include "um6/Reset.h"
+#include "um6/sample.h"
+#include "um6/snapshot.h"
+#include "um6/timed_output.h"
+#include "um6/windowed_stats.h"
+#include "um6/trace.h"
+#include "um6/uart_counters.h"
 
 // Don't try to be too clever. Arrival of this message triggers
 // us to publish everything we have.
 const uint8_t TRIGGER_PACKET = UM6_TEMPERATURE;
 
+// First message of each broadcast group, which the device sends in register order.
+const uint8_t CYCLE_START_PACKET = UM6_GYRO_PROC_XY;
+
+// Consecutive failed reads after which the link is considered lost.
+const uint32_t LINK_LOST_FAILURES = 20;
+
+// Range of data registers captured each cycle by the register log.
+const uint8_t LOGGED_REGISTERS_START = UM6_GYRO_PROC_XY;
+const uint8_t LOGGED_REGISTERS_COUNT = UM6_TEMPERATURE - UM6_GYRO_PROC_XY + 1;
+
+// Bytes broadcast per cycle for the outputs enabled below: five two-register
+// packets, the covariance matrix as packets of fifteen and one registers, and
+// the temperature.
+const size_t BROADCAST_BYTES_PER_CYCLE = 5 * (7 + 2 * 4) + (7 + 15 * 4) + (7 + 4) + (7 + 4);
+
+// Rates to fall back through when the link is poor, fastest first. Only those
+// with room for the enabled outputs at the slowest broadcast rate are used.
+const uint32_t BAUD_LADDER[] = { 115200, 57600, 38400, 19200 };
+
 /**
  * Function generalizes the process of writing an XYZ vector into consecutive
  * fields in UM6 registers.
@@ -79,6 +130,25 @@ void configureVector3(um6::Comms* sensor, const um6::Accessor<RegT>& reg,
   }
 }
 
+/**
+ * Function generalizes the process of writing a single float configuration
+ * register, when it is given as a parameter.
+ */
+void configureFloat(um6::Comms* sensor, const um6::Accessor<float>& reg,
+                    std::string param, std::string human_name)
+{
+  double value;
+  if (ros::param::get(param, value))
+  {
+    ROS_INFO_STREAM("Configuring " << human_name << " to " << value);
+    reg.set(0, value);
+    if (!sensor->sendWaitAck(reg))
+    {
+      throw std::runtime_error("Unable to configure " + human_name + ".");
+    }
+  }
+}
+
 /**
  * Function generalizes the process of commanding the UM6 via one of its command
  * registers.
@@ -94,21 +164,48 @@ void sendCommand(um6::Comms* sensor, const um6::Accessor<RegT>& reg, std::string
 }
 
 
+/**
+ * Value of the communication register which enables the outputs we require, at
+ * the given baud rate and broadcast rate field.
+ */
+uint32_t communicationRegister(uint32_t baud, uint8_t broadcast_rate)
+{
+  int baud_code = um6::baudRateCode(baud);
+  if (baud_code < 0)
+  {
+    throw std::runtime_error("Baud rate is not supported by the device.");
+  }
+  return UM6_BROADCAST_ENABLED |
+         UM6_GYROS_PROC_ENABLED | UM6_ACCELS_PROC_ENABLED | UM6_MAG_PROC_ENABLED |
+         UM6_QUAT_ENABLED | UM6_EULER_ENABLED | UM6_COV_ENABLED | UM6_TEMPERATURE_ENABLED |
+         baud_code << UM6_BAUD_START_BIT | broadcast_rate;
+}
+
+/**
+ * Moves the device, and then the port, to a new baud rate. The device switches
+ * as soon as it has taken the register write, so there is no acknowledgement
+ * to wait for.
+ */
+void switchBaud(um6::Comms* sensor, serial::Serial* ser, uint32_t baud, uint8_t broadcast_rate)
+{
+  um6::Registers r;
+  r.communication.set(0, communicationRegister(baud, broadcast_rate));
+  sensor->send(r.communication);
+  ser->flush();
+  ser->setBaudrate(baud);
+  ser->flushInput();
+}
+
 /**
  * Send configuration messages to the UM6, critically, to turn on the value outputs
  * which we require, and inject necessary configuration parameters.
  */
-void configureSensor(um6::Comms* sensor)
+void configureSensor(um6::Comms* sensor, uint32_t baud, uint8_t broadcast_rate)
 {
   um6::Registers r;
 
   // Enable outputs we need.
-  const uint8_t UM6_BAUD_115200 = 0x5;
-  uint32_t comm_reg = UM6_BROADCAST_ENABLED |
-                      UM6_GYROS_PROC_ENABLED | UM6_ACCELS_PROC_ENABLED | UM6_MAG_PROC_ENABLED |
-                      UM6_QUAT_ENABLED | UM6_EULER_ENABLED | UM6_COV_ENABLED | UM6_TEMPERATURE_ENABLED |
-                      UM6_BAUD_115200 << UM6_BAUD_START_BIT;
-  r.communication.set(0, comm_reg);
+  r.communication.set(0, communicationRegister(baud, broadcast_rate));
   if (!sensor->sendWaitAck(r.communication))
   {
     throw std::runtime_error("Unable to set communication register.");
@@ -154,6 +251,11 @@ void configureSensor(um6::Comms* sensor)
   configureVector3(sensor, r.mag_bias, "~mag_bias", "magnetic bias vector");
   configureVector3(sensor, r.accel_bias, "~accel_bias", "accelerometer bias vector");
   configureVector3(sensor, r.gyro_bias, "~gyro_bias", "gyroscope bias vector");
+
+  // EKF noise parameters, as recommended by um6_allan.
+  configureFloat(sensor, r.ekf_process_variance, "~ekf_process_variance", "EKF process variance");
+  configureFloat(sensor, r.ekf_accel_variance, "~ekf_accel_variance", "EKF accelerometer variance");
+  configureFloat(sensor, r.ekf_mag_variance, "~ekf_mag_variance", "EKF magnetometer variance");
 }
 
 
@@ -169,80 +271,580 @@ bool handleResetService(um6::Comms* sensor,
 }
 
 /**
- * Uses the register accessors to grab data from the IMU, and populate
- * the ROS messages which are output.
+ * Records the reason for a dump as a final event, and writes out the recorder.
+ */
+void dumpFlightRecorder(um6::FlightRecorder* recorder, const std::string& reason)
+{
+  if (!recorder) return;
+  recorder->event(reason);
+  if (recorder->dump())
+  {
+    ROS_WARN_STREAM("Dumped recent packets to " << recorder->defaultPath());
+  }
+  else
+  {
+    ROS_ERROR_STREAM("Unable to dump recent packets to " << recorder->defaultPath());
+  }
+}
+
+bool handleDumpFlightRecorderService(um6::FlightRecorder* recorder,
+                                     const um6::DumpFlightRecorder::Request& req,
+                                     um6::DumpFlightRecorder::Response& resp)
+{
+  if (!recorder->requestPath(req.path, &resp.path))
+  {
+    ROS_WARN_STREAM("Refusing to dump recent packets to " << req.path << ", which isn't a plain file name.");
+    resp.path = req.path;
+    resp.success = false;
+    return true;
+  }
+  recorder->event("Dump requested by service call.");
+  resp.success = recorder->dump(resp.path.c_str());
+  return true;
+}
+
+bool handleDumpLatencyTraceService(const um6::LatencyTracer* tracer, const um6::ChannelLatency* channels,
+                                   const um6::DumpLatencyTrace::Request& req,
+                                   um6::DumpLatencyTrace::Response& resp)
+{
+  std::ostringstream summary;
+  tracer->writeSummary(summary);
+  channels->writeSummary(summary);
+  resp.summary = summary.str();
+  resp.success = true;
+  if (!req.path.empty())
+  {
+    std::ofstream out(req.path.c_str());
+    tracer->writeChromeTrace(out);
+    out.close();
+    resp.success = !out.fail();
+  }
+  return true;
+}
+
+/**
+ * Topics which are published only when they change, of those publishMsgs
+ * otherwise publishes every cycle.
+ */
+enum
+{
+  PUBLISH_MAG = 1 << 0,
+  PUBLISH_TEMPERATURE = 1 << 1,
+  PUBLISH_ALL = PUBLISH_MAG | PUBLISH_TEMPERATURE
+};
+
+/**
+ * A decoded sample with the time its cycle completed, as handed to the
+ * consumers of a fan-out.
+ */
+struct StampedSample
+{
+  uint64_t stamp_ns;
+  um6::Sample sample;
+
+  /**
+   * Of the change-triggered topics, those to publish. */
+  int topics;
+};
+
+/**
+ * Diagnostic task reporting the CPU time spent per sample in each stage, and
+ * per byte received, over the period since it last ran.
+ */
+class CpuCostTask
+{
+public:
+  CpuCostTask(const um6::CpuAccounting* cpu, um6::ArchiveWriter* archive)
+    : cpu_(cpu), archive_(archive), last_(cpu->snapshot()), last_writer_ns_(0), fan_out_(NULL)
+  {
+  }
+
+  /**
+   * Charges the threads of each consumer of a fan-out, which take over
+   * publishing or archiving from the driver thread. */
+  void addFanOut(const um6::FanOut<StampedSample>* fan_out)
+  {
+    fan_out_ = fan_out;
+    last_consumer_ns_.assign(fan_out->size(), 0);
+  }
+
+  /**
+   * Charges another thread of the driver's, such as the one publishing on a
+   * timer, which must outlive the updater's last run. */
+  void addThread(const std::string& name, pthread_t thread)
+  {
+    thread_names_.push_back(name);
+    threads_.push_back(thread);
+    last_thread_ns_.push_back(0);
+  }
+
+  void run(diagnostic_updater::DiagnosticStatusWrapper& stat)
+  {
+    um6::CpuAccounting::Snapshot now = cpu_->snapshot();
+    uint64_t samples = now.samples - last_.samples;
+    uint64_t bytes = now.bytes - last_.bytes;
+    if (samples == 0)
+    {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "No samples processed.");
+    }
+    else
+    {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Samples processed.");
+    }
+    double per_sample = samples > 0 ? 1e-3 / samples : 0;
+
+    uint64_t total_ns = 0;
+    for (int stage = 0; stage < um6::CpuAccounting::NUM_STAGES; stage++)
+    {
+      uint64_t ns = now.cpu_ns[stage] - last_.cpu_ns[stage];
+      total_ns += ns;
+      stat.addf(std::string(um6::CpuAccounting::stageName(stage)) + " CPU us/sample", "%.2f", ns * per_sample);
+    }
+    if (archive_)
+    {
+      uint64_t writer_ns = archive_->writerCpuNanoseconds();
+      stat.addf("archive CPU us/sample", "%.2f", (writer_ns - last_writer_ns_) * per_sample);
+      total_ns += writer_ns - last_writer_ns_;
+      last_writer_ns_ = writer_ns;
+    }
+    for (size_t i = 0; i < last_consumer_ns_.size(); i++)
+    {
+      uint64_t consumer_ns = fan_out_->cpuNanoseconds(i) - last_consumer_ns_[i];
+      stat.addf(fan_out_->name(i) + " consumer CPU us/sample", "%.2f", consumer_ns * per_sample);
+      total_ns += consumer_ns;
+      last_consumer_ns_[i] += consumer_ns;
+    }
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      uint64_t thread_ns = um6::CpuAccounting::threadCpuNanoseconds(threads_[i]) - last_thread_ns_[i];
+      stat.addf(thread_names_[i] + " CPU us/sample", "%.2f", thread_ns * per_sample);
+      total_ns += thread_ns;
+      last_thread_ns_[i] += thread_ns;
+    }
+    stat.addf("total CPU us/sample", "%.2f", total_ns * per_sample);
+    stat.addf("total CPU us/byte", "%.3f", bytes > 0 ? total_ns * 1e-3 / bytes : 0.0);
+    stat.add("samples", samples);
+    stat.add("bytes", bytes);
+    last_ = now;
+  }
+
+private:
+  const um6::CpuAccounting* cpu_;
+  um6::ArchiveWriter* archive_;
+  um6::CpuAccounting::Snapshot last_;
+  uint64_t last_writer_ns_;
+  const um6::FanOut<StampedSample>* fan_out_;
+  std::vector<uint64_t> last_consumer_ns_;
+  std::vector<std::string> thread_names_;
+  std::vector<pthread_t> threads_;
+  std::vector<uint64_t> last_thread_ns_;
+};
+
+/**
+ * Diagnostic task comparing the kernel's UART error counts with the driver's
+ * checksum failures and resyncs over the period since it last ran, to tell
+ * bytes dropped before they reach userspace apart from corruption on the line.
+ */
+class LinkErrorsTask
+{
+public:
+  LinkErrorsTask() : comms_(NULL), uart_(NULL), uart_valid_(false)
+  {
+  }
+
+  /**
+   * Called on each new connection, before the updater next runs. */
+  void connect(const um6::Comms* comms, const um6::UartCounters* uart)
+  {
+    comms_ = comms;
+    uart_ = uart;
+    last_link_ = comms->counters();
+    uart_valid_ = uart->read(&last_uart_);
+  }
+
+  void disconnect()
+  {
+    comms_ = NULL;
+    uart_ = NULL;
+  }
+
+  void run(diagnostic_updater::DiagnosticStatusWrapper& stat)
+  {
+    if (!comms_ || !uart_)
+    {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Not connected.");
+      return;
+    }
+
+    const um6::Comms::Counters& link = comms_->counters();
+    uint64_t link_errors = (link.bad_checksums - last_link_.bad_checksums) + (link.resyncs - last_link_.resyncs);
+    stat.add("checksum errors", link.bad_checksums - last_link_.bad_checksums);
+    stat.add("resyncs", link.resyncs - last_link_.resyncs);
+    stat.add("junk bytes", link.junk_bytes - last_link_.junk_bytes);
+    last_link_ = link;
+
+    uint64_t uart_errors = 0;
+    um6::UartCounters::Counts uart;
+    if (uart_valid_ && uart_->read(&uart))
+    {
+      for (int i = 0; i < um6::UartCounters::NUM_COUNTS; i++)
+      {
+        uint32_t errors = um6::UartCounters::get(uart, i) - um6::UartCounters::get(last_uart_, i);
+        uart_errors += errors;
+        stat.add(std::string("UART ") + um6::UartCounters::name(i) + " errors", errors);
+      }
+      last_uart_ = uart;
+    }
+    else
+    {
+      stat.add("UART errors", "unavailable");
+    }
+
+    if (link_errors == 0 && uart_errors == 0)
+    {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "No link errors.");
+    }
+    else if (uart_errors > 0)
+    {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::WARN,
+                   "Kernel UART errors: bytes dropped before reaching the driver. Check baud rate and buffering.");
+    }
+    else if (uart_valid_)
+    {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::WARN,
+                   "Link errors without UART errors: corruption on the line or at the device.");
+    }
+    else
+    {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Link errors; kernel UART counters unavailable.");
+    }
+  }
+
+private:
+  const um6::Comms* comms_;
+  const um6::UartCounters* uart_;
+  bool uart_valid_;
+  um6::Comms::Counters last_link_;
+  um6::UartCounters::Counts last_uart_;
+};
+
+/**
+ * The driver's counters and histograms, copied periodically into a Metrics
+ * instance for a MetricsServer to render.
+ */
+class DriverMetrics
+{
+public:
+  DriverMetrics() : fan_out_(NULL)
+  {
+    bytes_ = metrics_.add("um6_bytes_received_total", "", um6::Metrics::COUNTER,
+                          "Bytes read from the serial port, including junk.");
+    packets_ = metrics_.add("um6_packets_total", "", um6::Metrics::COUNTER, "Packets received with a good checksum.");
+    bad_checksums_ = metrics_.add("um6_checksum_errors_total", "", um6::Metrics::COUNTER,
+                                  "Packets discarded for a bad checksum.");
+    timeouts_ = metrics_.add("um6_timeouts_total", "", um6::Metrics::COUNTER,
+                             "Serial reads which timed out before a full packet arrived.");
+    resyncs_ = metrics_.add("um6_resyncs_total", "", um6::Metrics::COUNTER,
+                            "Times the stream was searched for the next packet header.");
+    junk_bytes_ = metrics_.add("um6_junk_bytes_total", "", um6::Metrics::COUNTER,
+                               "Bytes skipped while searching for a packet header.");
+    samples_ = metrics_.add("um6_samples_total", "", um6::Metrics::COUNTER, "Complete samples published.");
+    connections_ = metrics_.add("um6_connections_total", "", um6::Metrics::COUNTER, "Serial port connections made.");
+    status_ = metrics_.add("um6_status", "", um6::Metrics::GAUGE, "Most recent value of the status register.");
+
+    static const double quantiles[] = { 0.5, 0.9, 0.99 };
+    for (int stage = 0; stage <= um6::LatencyTracer::NUM_STAGES; stage++)
+    {
+      std::string label = std::string("stage=\"") + um6::LatencyTracer::stageName(stage) + "\"";
+      for (int q = 0; q < 3; q++)
+      {
+        std::ostringstream labels;
+        labels << label << ",quantile=\"" << quantiles[q] << "\"";
+        latency_quantiles_[stage][q] = metrics_.add("um6_stage_latency_seconds", labels.str(),
+                                                    um6::Metrics::SUMMARY, "Time spent in each stage of a cycle.");
+      }
+      latency_sum_[stage] = metrics_.add("um6_stage_latency_seconds_sum", label, um6::Metrics::SUMMARY, "");
+      latency_count_[stage] = metrics_.add("um6_stage_latency_seconds_count", label, um6::Metrics::SUMMARY, "");
+    }
+
+    for (int stage = 0; stage < um6::CpuAccounting::NUM_STAGES; stage++)
+    {
+      cpu_[stage] = metrics_.add("um6_cpu_seconds_total",
+                                 std::string("stage=\"") + um6::CpuAccounting::stageName(stage) + "\"",
+                                 um6::Metrics::COUNTER, "Driver thread CPU time spent in each stage.");
+    }
+    archive_cpu_ = metrics_.add("um6_archive_cpu_seconds_total", "", um6::Metrics::COUNTER,
+                                "CPU time of the archive writer thread.");
+    archive_pending_ = metrics_.add("um6_archive_pending_chunks", "", um6::Metrics::GAUGE,
+                                    "Full archive chunks queued for the writer thread.");
+    archive_dropped_ = metrics_.add("um6_archive_dropped_chunks_total", "", um6::Metrics::COUNTER,
+                                    "Archive chunks dropped because the writer thread fell behind.");
+    for (int i = 0; i < um6::UartCounters::NUM_COUNTS; i++)
+    {
+      uart_[i] = metrics_.add("um6_uart_errors_total", std::string("type=\"") + um6::UartCounters::name(i) + "\"",
+                              um6::Metrics::COUNTER, "Errors counted by the kernel serial driver.");
+    }
+    memset(&totals_, 0, sizeof(totals_));
+    memset(&last_, 0, sizeof(last_));
+    memset(uart_totals_, 0, sizeof(uart_totals_));
+    memset(&uart_last_, 0, sizeof(uart_last_));
+  }
+
+  const um6::Metrics* metrics() const
+  {
+    return &metrics_;
+  }
+
+  /**
+   * Exports the drops and lag of each consumer of a fan-out. Called before the
+   * metrics are served. */
+  void addFanOut(const um6::FanOut<StampedSample>* fan_out)
+  {
+    fan_out_ = fan_out;
+    for (size_t i = 0; i < fan_out->size(); i++)
+    {
+      std::string label = std::string("consumer=\"") + fan_out->name(i) + "\"";
+      fan_out_dropped_.push_back(metrics_.add("um6_fanout_dropped_total", label, um6::Metrics::COUNTER,
+                                              "Samples a consumer lost by falling behind."));
+      fan_out_lag_.push_back(metrics_.add("um6_fanout_lag", label, um6::Metrics::GAUGE,
+                                          "Samples queued for a consumer but not yet taken."));
+      fan_out_cpu_.push_back(metrics_.add("um6_fanout_cpu_seconds_total", label, um6::Metrics::COUNTER,
+                                          "CPU time of a consumer's thread."));
+    }
+  }
+
+  /**
+   * Exports the CPU time of another thread of the driver's. The metric is
+   * added here, before serving starts, and the thread given to threadStarted
+   * once it is running, in the same order. It must outlive the last update. */
+  void addThread(const std::string& name)
+  {
+    thread_cpu_.push_back(metrics_.add("um6_thread_cpu_seconds_total", "thread=\"" + name + "\"",
+                                       um6::Metrics::COUNTER, "CPU time of a thread other than the driver thread."));
+  }
+
+  void threadStarted(pthread_t thread)
+  {
+    threads_.push_back(thread);
+  }
+
+  /**
+   * Called on each new connection, whose counters start again from zero. The
+   * kernel's UART counts, if available, are read at the same time. */
+  void connected(const um6::UartCounters::Counts* uart)
+  {
+    memset(&last_, 0, sizeof(last_));
+    if (uart) uart_last_ = *uart;
+    metrics_.set(connections_, metrics_.get(connections_) + 1);
+  }
+
+  void update(const um6::Comms::Counters& link, const um6::UartCounters::Counts* uart,
+              const um6::Registers& registers, const um6::LatencyTracer& latency,
+              const um6::CpuAccounting& cpu, um6::ArchiveWriter* archive)
+  {
+    if (uart)
+    {
+      for (int i = 0; i < um6::UartCounters::NUM_COUNTS; i++)
+      {
+        uart_totals_[i] += um6::UartCounters::get(*uart, i) - um6::UartCounters::get(uart_last_, i);
+        metrics_.set(uart_[i], uart_totals_[i]);
+      }
+      uart_last_ = *uart;
+    }
+
+    // Accumulate across connections, so that the exported counters never go backwards.
+    totals_.bytes += link.bytes - last_.bytes;
+    totals_.packets += link.packets - last_.packets;
+    totals_.bad_checksums += link.bad_checksums - last_.bad_checksums;
+    totals_.timeouts += link.timeouts - last_.timeouts;
+    totals_.resyncs += link.resyncs - last_.resyncs;
+    totals_.junk_bytes += link.junk_bytes - last_.junk_bytes;
+    last_ = link;
+
+    metrics_.set(bytes_, totals_.bytes);
+    metrics_.set(packets_, totals_.packets);
+    metrics_.set(bad_checksums_, totals_.bad_checksums);
+    metrics_.set(timeouts_, totals_.timeouts);
+    metrics_.set(resyncs_, totals_.resyncs);
+    metrics_.set(junk_bytes_, totals_.junk_bytes);
+    metrics_.set(status_, registers.status.get(0));
+
+    static const double percents[] = { 50, 90, 99 };
+    for (int stage = 0; stage <= um6::LatencyTracer::NUM_STAGES; stage++)
+    {
+      const um6::LatencyHistogram& h = stage < um6::LatencyTracer::NUM_STAGES ?
+                                       latency.histogram(stage) : latency.total();
+      for (int q = 0; q < 3; q++)
+      {
+        metrics_.set(latency_quantiles_[stage][q], h.percentile(percents[q]) * 1e-9);
+      }
+      metrics_.set(latency_sum_[stage], h.mean() * h.count() * 1e-9);
+      metrics_.set(latency_count_[stage], h.count());
+    }
+
+    um6::CpuAccounting::Snapshot snapshot = cpu.snapshot();
+    metrics_.set(samples_, snapshot.samples);
+    for (int stage = 0; stage < um6::CpuAccounting::NUM_STAGES; stage++)
+    {
+      metrics_.set(cpu_[stage], snapshot.cpu_ns[stage] * 1e-9);
+    }
+    if (archive)
+    {
+      metrics_.set(archive_cpu_, archive->writerCpuNanoseconds() * 1e-9);
+      metrics_.set(archive_pending_, archive->pendingChunks());
+      metrics_.set(archive_dropped_, archive->droppedChunks());
+    }
+    for (size_t i = 0; i < fan_out_dropped_.size(); i++)
+    {
+      metrics_.set(fan_out_dropped_[i], fan_out_->queue(i).dropped());
+      metrics_.set(fan_out_lag_[i], fan_out_->queue(i).lag());
+      metrics_.set(fan_out_cpu_[i], fan_out_->cpuNanoseconds(i) * 1e-9);
+    }
+    for (size_t i = 0; i < threads_.size(); i++)
+    {
+      metrics_.set(thread_cpu_[i], um6::CpuAccounting::threadCpuNanoseconds(threads_[i]) * 1e-9);
+    }
+  }
+
+private:
+  um6::Metrics metrics_;
+  um6::Comms::Counters totals_, last_;
+  size_t bytes_, packets_, bad_checksums_, timeouts_, resyncs_, junk_bytes_;
+  size_t samples_, connections_, status_;
+  size_t latency_quantiles_[um6::LatencyTracer::NUM_STAGES + 1][3];
+  size_t latency_sum_[um6::LatencyTracer::NUM_STAGES + 1];
+  size_t latency_count_[um6::LatencyTracer::NUM_STAGES + 1];
+  size_t cpu_[um6::CpuAccounting::NUM_STAGES];
+  size_t archive_cpu_, archive_pending_, archive_dropped_;
+  const um6::FanOut<StampedSample>* fan_out_;
+  std::vector<size_t> fan_out_dropped_, fan_out_lag_, fan_out_cpu_;
+  std::vector<size_t> thread_cpu_;
+  std::vector<pthread_t> threads_;
+  size_t uart_[um6::UartCounters::NUM_COUNTS];
+  uint64_t uart_totals_[um6::UartCounters::NUM_COUNTS];
+  um6::UartCounters::Counts uart_last_;
+};
+
+/**
+ * Reads the settings for message construction from the parameter server.
+ */
+um6::MessageConfig messageConfig()
+{
+  um6::MessageConfig config;
+  ros::param::param<double>("~angular_velocity_covariance", config.angular_velocity_covariance, 0.0);
+  ros::param::param<double>("~linear_acceleration_covariance", config.linear_acceleration_covariance, 0.0);
+  return config;
+}
+
+/**
+ * Populates and publishes the ROS messages which are output, from a
+ * decoded sample. Change-triggered topics not among those given are skipped.
  */
-void publishMsgs(um6::Registers& r, ros::NodeHandle* n, const std_msgs::Header& header)
+void publishMsgs(const um6::Sample& s, ros::NodeHandle* n, const std_msgs::Header& header,
+                 int topics = PUBLISH_ALL)
 {
   static ros::Publisher imu_pub = n->advertise<sensor_msgs::Imu>("imu/data", 1, false);
   static ros::Publisher mag_pub = n->advertise<geometry_msgs::Vector3Stamped>("imu/mag", 1, false);
   static ros::Publisher rpy_pub = n->advertise<geometry_msgs::Vector3Stamped>("imu/rpy", 1, false);
   static ros::Publisher temp_pub = n->advertise<std_msgs::Float32>("imu/temperature", 1, false);
 
+  static const um6::MessageConfig config = messageConfig();
+
   if (imu_pub.getNumSubscribers() > 0)
   {
     sensor_msgs::Imu imu_msg;
-    imu_msg.header = header;
-
-    // IMU outputs [w,x,y,z] NED, convert to [x,y,z,w] ENU
-    imu_msg.orientation.x = r.quat.get_scaled(2);
-    imu_msg.orientation.y = r.quat.get_scaled(1);
-    imu_msg.orientation.z = -r.quat.get_scaled(3);
-    imu_msg.orientation.w = r.quat.get_scaled(0);
-
-    // IMU reports a 4x4 wxyz covariance, ROS requires only 3x3 xyz.
-    // NED -> ENU conversion req'd?
-    imu_msg.orientation_covariance[0] = r.covariance.get_scaled(5);
-    imu_msg.orientation_covariance[1] = r.covariance.get_scaled(6);
-    imu_msg.orientation_covariance[2] = r.covariance.get_scaled(7);
-    imu_msg.orientation_covariance[3] = r.covariance.get_scaled(9);
-    imu_msg.orientation_covariance[4] = r.covariance.get_scaled(10);
-    imu_msg.orientation_covariance[5] = r.covariance.get_scaled(11);
-    imu_msg.orientation_covariance[6] = r.covariance.get_scaled(13);
-    imu_msg.orientation_covariance[7] = r.covariance.get_scaled(14);
-    imu_msg.orientation_covariance[8] = r.covariance.get_scaled(15);
-
-    // NED -> ENU conversion.
-    imu_msg.angular_velocity.x = r.gyro.get_scaled(1);
-    imu_msg.angular_velocity.y = r.gyro.get_scaled(0);
-    imu_msg.angular_velocity.z = -r.gyro.get_scaled(2);
-
-    // NED -> ENU conversion.
-    imu_msg.linear_acceleration.x = r.accel.get_scaled(1);
-    imu_msg.linear_acceleration.y = r.accel.get_scaled(0);
-    imu_msg.linear_acceleration.z = -r.accel.get_scaled(2);
-
+    um6::imuMessage(s, header, config, &imu_msg);
     imu_pub.publish(imu_msg);
+    UM6_TRACE2(message_published, "imu/data", header.stamp.toNSec());
   }
 
-  if (mag_pub.getNumSubscribers() > 0)
+  if ((topics & PUBLISH_MAG) && mag_pub.getNumSubscribers() > 0)
   {
     geometry_msgs::Vector3Stamped mag_msg;
-    mag_msg.header = header;
-    mag_msg.vector.x = r.mag.get_scaled(1);
-    mag_msg.vector.y = r.mag.get_scaled(0);
-    mag_msg.vector.z = -r.mag.get_scaled(2);
+    um6::magMessage(s, header, &mag_msg);
     mag_pub.publish(mag_msg);
+    UM6_TRACE2(message_published, "imu/mag", header.stamp.toNSec());
   }
 
   if (rpy_pub.getNumSubscribers() > 0)
   {
     geometry_msgs::Vector3Stamped rpy_msg;
-    rpy_msg.header = header;
-    rpy_msg.vector.x = r.euler.get_scaled(1);
-    rpy_msg.vector.y = r.euler.get_scaled(0);
-    rpy_msg.vector.z = -r.euler.get_scaled(2);
+    um6::rpyMessage(s, header, &rpy_msg);
     rpy_pub.publish(rpy_msg);
+    UM6_TRACE2(message_published, "imu/rpy", header.stamp.toNSec());
   }
 
-  if (temp_pub.getNumSubscribers() > 0)
+  if ((topics & PUBLISH_TEMPERATURE) && temp_pub.getNumSubscribers() > 0)
   {
     std_msgs::Float32 temp_msg;
-    temp_msg.data = r.temperature.get_scaled(0);
+    um6::temperatureMessage(s, &temp_msg);
     temp_pub.publish(temp_msg);
+    UM6_TRACE2(message_published, "imu/temperature", header.stamp.toNSec());
   }
 }
 
+/**
+ * Publishes on a fixed-phase timer rather than as each cycle completes, from
+ * the samples held, evaluated the given delay before each tick. The age of
+ * the newest data as of the tick goes out alongside.
+ */
+void publishTimed(um6::SampleHold* hold, um6::PhaseTimer* timer, ros::NodeHandle* n, const std::string& frame_id,
+                  double delay)
+{
+  ros::Publisher age_pub = n->advertise<std_msgs::Float32>("imu/sample_age", 1, false);
+  while (ros::ok())
+  {
+    uint64_t tick = timer->wait();
+    um6::Sample sample;
+    double age;
+    if (!hold->get(tick * 1e-9 - delay, &sample, &age)) continue;
+
+    std_msgs::Header header;
+    header.frame_id = frame_id;
+    header.stamp.fromSec(sample.stamp);
+    publishMsgs(sample, n, header);
+
+    std_msgs::Float32 age_msg;
+    age_msg.data = age + delay;
+    age_pub.publish(age_msg);
+  }
+}
+
+/**
+ * Fan-out consumer which publishes each sample on its own thread.
+ */
+void publishStampedSample(const StampedSample& s, ros::NodeHandle* n, const std::string& frame_id)
+{
+  std_msgs::Header header;
+  header.frame_id = frame_id;
+  header.stamp.fromNSec(s.stamp_ns);
+  publishMsgs(s.sample, n, header, s.topics);
+}
+
+/**
+ * Fan-out consumer which archives each sample on its own thread.
+ */
+void archiveStampedSample(const StampedSample& s, um6::ArchiveWriter* archive)
+{
+  archive->append(s.sample);
+}
+
+/**
+ * Reads the fan-out policy for one consumer, where "inline" keeps the work on
+ * the driver thread. Returns false for an unknown policy name.
+ */
+bool fanOutPolicy(const std::string& param, bool* fan_out, um6::FanOutPolicy::Type* policy)
+{
+  std::string name;
+  ros::param::param<std::string>(param, name, "inline");
+  *fan_out = (name != "inline");
+  if (!*fan_out) return true;
+  if (um6::FanOutPolicy::parse(name, policy)) return true;
+  ROS_FATAL_STREAM(param << " must be one of inline, drop_oldest, drop_newest, latest or block, not "
+                   << name << ".");
+  return false;
+}
+
 
 /**
  * Node entry-point. Handles ROS setup, and serial port connection/reconnection.
@@ -267,9 +869,363 @@ int main(int argc, char **argv)
   std_msgs::Header header;
   ros::param::param<std::string>("~frame_id", header.frame_id, "imu_link");
 
+  // Optionally record every decoded sample to a columnar archive.
+  std::string archive_path;
+  int32_t archive_chunk_samples;
+  ros::param::param<std::string>("~archive_path", archive_path, "");
+  ros::param::param<int32_t>("~archive_chunk_samples", archive_chunk_samples, 4096);
+  boost::scoped_ptr<um6::ArchiveWriter> archive;
+  if (!archive_path.empty())
+  {
+    if (archive_chunk_samples < 1 ||
+        static_cast<uint32_t>(archive_chunk_samples) > um6::ArchiveWriter::MAX_CHUNK_SAMPLES)
+    {
+      ROS_FATAL_STREAM("~archive_chunk_samples must be from 1 to " << um6::ArchiveWriter::MAX_CHUNK_SAMPLES << ".");
+      return 1;
+    }
+    try
+    {
+      archive.reset(new um6::ArchiveWriter(archive_path, archive_chunk_samples, true));
+    }
+    catch(const std::runtime_error& e)
+    {
+      ROS_FATAL_STREAM(e.what());
+      return 1;
+    }
+    ROS_INFO_STREAM("Archiving samples to " << archive_path);
+  }
+
+  // Optionally publish the slowly varying topics only when they move by more
+  // than a deadband, or after a maximum interval, rather than every cycle. A
+  // timed publishing mode publishes everything on every tick regardless.
+  double mag_deadband_value, mag_max_interval, temperature_deadband_value, temperature_max_interval;
+  ros::param::param<double>("~mag_deadband", mag_deadband_value, 0.0);
+  ros::param::param<double>("~mag_max_interval", mag_max_interval, 1.0);
+  ros::param::param<double>("~temperature_deadband", temperature_deadband_value, 0.0);
+  ros::param::param<double>("~temperature_max_interval", temperature_max_interval, 1.0);
+  um6::Deadband<int16_t> mag_deadband(mag_deadband_value, mag_max_interval);
+  um6::Deadband<float> temperature_deadband(temperature_deadband_value, temperature_max_interval);
+
+  // Optionally watch each accelerometer and gyro packet for shocks and rapid
+  // rotations, publishing them as soon as they arrive rather than with the cycle.
+  double shock_threshold, rotation_threshold, event_holdoff;
+  ros::param::param<double>("~shock_threshold", shock_threshold, 0.0);
+  ros::param::param<double>("~rotation_threshold", rotation_threshold, 0.0);
+  ros::param::param<double>("~event_holdoff", event_holdoff, 0.1);
+  um6::EventDetector event_detector(shock_threshold, rotation_threshold, event_holdoff);
+  ros::Publisher event_pub;
+  if (event_detector.enabled())
+  {
+    event_pub = n.advertise<um6::ImuEvent>("imu/events", 10, false);
+  }
+
+  // Optionally publish the gyro rates as soon as their packet arrives, rather
+  // than waiting out the rest of the cycle for imu/data, which still carries them.
+  bool early_rate;
+  ros::param::param<bool>("~early_rate", early_rate, false);
+  ros::Publisher rate_pub;
+  if (early_rate)
+  {
+    rate_pub = n.advertise<geometry_msgs::Vector3Stamped>("imu/rate", 1, false);
+  }
+
+  // Optionally publish statistics of every channel once per window, for
+  // monitoring which would otherwise subscribe at the full rate to compute them.
+  double stats_window;
+  ros::param::param<double>("~stats_window", stats_window, 0.0);
+  boost::scoped_ptr<um6::WindowedStats> windowed_stats;
+  ros::Publisher stats_pub;
+  if (stats_window > 0)
+  {
+    windowed_stats.reset(new um6::WindowedStats(stats_window));
+    stats_pub = n.advertise<um6::ChannelStats>("imu/stats", 10, false);
+  }
+
+  // Optionally publish on a timer at a fixed phase, for consumers which run at
+  // one, rather than as each cycle happens to complete.
+  std::string publish_mode, timed_mode_name;
+  double timed_rate, timed_phase, timed_delay, timed_max_extrapolation;
+  ros::param::param<std::string>("~publish_mode", publish_mode, "on_arrival");
+  ros::param::param<double>("~timed_rate", timed_rate, 100.0);
+  ros::param::param<double>("~timed_phase", timed_phase, 0.0);
+  ros::param::param<double>("~timed_delay", timed_delay, 0.0);
+  ros::param::param<std::string>("~timed_mode", timed_mode_name, "latest");
+  ros::param::param<double>("~timed_max_extrapolation", timed_max_extrapolation, 0.05);
+  bool timed = (publish_mode == "timed");
+  um6::SampleHold::Mode timed_mode;
+  if (!timed && publish_mode != "on_arrival")
+  {
+    ROS_FATAL_STREAM("~publish_mode must be one of on_arrival or timed, not " << publish_mode << ".");
+    return 1;
+  }
+  if (!um6::SampleHold::parseMode(timed_mode_name, &timed_mode))
+  {
+    ROS_FATAL_STREAM("~timed_mode must be one of latest, interpolate or extrapolate, not " << timed_mode_name << ".");
+    return 1;
+  }
+  boost::scoped_ptr<um6::SampleHold> timed_hold;
+  boost::scoped_ptr<um6::PhaseTimer> timed_timer;
+  boost::thread timed_thread;
+  if (timed)
+  {
+    try
+    {
+      uint64_t period_ns = timed_rate > 0 ? static_cast<uint64_t>(1e9 / timed_rate + 0.5) : 0;
+      timed_timer.reset(new um6::PhaseTimer(period_ns, static_cast<uint64_t>(timed_phase * 1e9 + 0.5)));
+    }
+    catch(const std::runtime_error& e)
+    {
+      ROS_FATAL_STREAM("~timed_rate and ~timed_phase: " << e.what());
+      return 1;
+    }
+    timed_hold.reset(new um6::SampleHold(timed_mode, timed_max_extrapolation));
+  }
+
+  // Optionally move publishing and archiving off the driver thread, each to a
+  // consumer with its own queue, so that neither can stall reading the port.
+  bool publish_fan_out, archive_fan_out;
+  um6::FanOutPolicy::Type publish_policy, archive_policy;
+  int32_t fan_out_queue_size;
+  double fan_out_block_deadline;
+  if (!fanOutPolicy("~publish_policy", &publish_fan_out, &publish_policy) ||
+      !fanOutPolicy("~archive_policy", &archive_fan_out, &archive_policy))
+  {
+    return 1;
+  }
+  ros::param::param<int32_t>("~fanout_queue_size", fan_out_queue_size, 64);
+  ros::param::param<double>("~fanout_block_deadline", fan_out_block_deadline, 0.005);
+  if (fan_out_queue_size < 1)
+  {
+    ROS_FATAL("~fanout_queue_size must be at least 1.");
+    return 1;
+  }
+  if (!archive) archive_fan_out = false;
+  if (timed && publish_fan_out)
+  {
+    ROS_WARN("~publish_policy has no effect with ~publish_mode timed, which publishes from its own thread.");
+    publish_fan_out = false;
+  }
+  um6::FanOut<StampedSample> fan_out;
+  if (publish_fan_out)
+  {
+    fan_out.add("publish", boost::bind(publishStampedSample, _1, &n, header.frame_id), publish_policy,
+                fan_out_queue_size, fan_out_block_deadline);
+  }
+  if (archive_fan_out)
+  {
+    fan_out.add("archive", boost::bind(archiveStampedSample, _1, archive.get()), archive_policy,
+                fan_out_queue_size, fan_out_block_deadline);
+  }
+  fan_out.start();
+
+  // Optionally record the raw data registers each cycle, delta-compressed.
+  std::string register_log_path;
+  ros::param::param<std::string>("~register_log_path", register_log_path, "");
+  um6::RegisterLogEncoder register_log_encoder(LOGGED_REGISTERS_START, LOGGED_REGISTERS_COUNT);
+  std::string register_log_buffer;
+  FILE* register_log = NULL;
+  if (!register_log_path.empty())
+  {
+    register_log = fopen(register_log_path.c_str(), "wb");
+    if (!register_log)
+    {
+      ROS_FATAL_STREAM("Unable to open register log " << register_log_path);
+      return 1;
+    }
+    setvbuf(register_log, NULL, _IOFBF, 1 << 16);
+    register_log_encoder.header(&register_log_buffer);
+    fwrite(register_log_buffer.data(), 1, register_log_buffer.length(), register_log);
+    ROS_INFO_STREAM("Logging registers to " << register_log_path);
+  }
+
+  // Keep a ring of recent packets and events, to be dumped when things go wrong.
+  int32_t recorder_records;
+  double recorder_seconds;
+  std::string recorder_path;
+  ros::param::param<int32_t>("~flight_recorder_records", recorder_records, 4096);
+  ros::param::param<double>("~flight_recorder_seconds", recorder_seconds, 10.0);
+  ros::param::param<std::string>("~flight_recorder_path", recorder_path, "/tmp/um6_flight_recorder.txt");
+  boost::scoped_ptr<um6::FlightRecorder> recorder;
+  ros::ServiceServer dump_srv;
+  if (recorder_records > 0)
+  {
+    recorder.reset(new um6::FlightRecorder(recorder_records, recorder_seconds, recorder_path));
+    um6::FlightRecorder::installSignalHandlers(recorder.get());
+    dump_srv = n.advertiseService<um6::DumpFlightRecorder::Request, um6::DumpFlightRecorder::Response>(
+                 "dump_flight_recorder", boost::bind(handleDumpFlightRecorderService, recorder.get(), _1, _2));
+  }
+
+  // Time each stage of the receive cycle, keeping recent cycles for export.
+  int32_t latency_trace_cycles;
+  ros::param::param<int32_t>("~latency_trace_cycles", latency_trace_cycles, 1000);
+  um6::LatencyTracer latency(latency_trace_cycles > 0 ? latency_trace_cycles : 0);
+  um6::ChannelLatency channel_latency;
+  ros::ServiceServer latency_srv =
+    n.advertiseService<um6::DumpLatencyTrace::Request, um6::DumpLatencyTrace::Response>(
+      "dump_latency_trace", boost::bind(handleDumpLatencyTraceService, &latency, &channel_latency, _1, _2));
+
+  // Account the CPU cost of each stage, reported through diagnostics.
+  um6::CpuAccounting cpu;
+  CpuCostTask cpu_cost_task(&cpu, archive.get());
+  cpu_cost_task.addFanOut(&fan_out);
+  diagnostic_updater::Updater updater;
+  updater.setHardwareID(port);
+  updater.add("CPU cost", &cpu_cost_task, &CpuCostTask::run);
+  LinkErrorsTask link_errors_task;
+  updater.add("Link errors", &link_errors_task, &LinkErrorsTask::run);
+
+  // Optionally serve metrics for scraping, refreshed once a second.
+  std::string metrics_socket;
+  ros::param::param<std::string>("~metrics_socket", metrics_socket, "");
+  DriverMetrics driver_metrics;
+  driver_metrics.addFanOut(&fan_out);
+  if (timed) driver_metrics.addThread("timed_publish");
+  boost::scoped_ptr<um6::MetricsServer> metrics_server;
+  if (!metrics_socket.empty())
+  {
+    try
+    {
+      metrics_server.reset(new um6::MetricsServer(driver_metrics.metrics(), metrics_socket));
+    }
+    catch(const std::runtime_error& e)
+    {
+      ROS_FATAL_STREAM(e.what());
+      return 1;
+    }
+  }
+
+  // Decode and filter in double, float, or fixed point for processors without an FPU.
+  std::string precision;
+  int32_t lowpass_shift;
+  ros::param::param<std::string>("~precision", precision, "double");
+  ros::param::param<int32_t>("~lowpass_shift", lowpass_shift, 0);
+  if (lowpass_shift < 0 || lowpass_shift > um6::FixedLowPass::MAX_SHIFT)
+  {
+    ROS_FATAL_STREAM("~lowpass_shift must be between 0 and " << um6::FixedLowPass::MAX_SHIFT << ".");
+    return 1;
+  }
+  um6::CycleDecoder::Precision decoder_precision;
+  if (!um6::CycleDecoder::parsePrecision(precision, &decoder_precision))
+  {
+    ROS_FATAL_STREAM("~precision must be one of double, float or fixed, not " << precision << ".");
+    return 1;
+  }
+  um6::CycleDecoder decoder(decoder_precision, lowpass_shift);
+
+  // Optionally step down to slower baud rates when the link is poor, and back up later.
+  bool adaptive_baud;
+  double link_quality_threshold, link_quality_hold, link_probe_interval, link_utilisation;
+  ros::param::param<bool>("~adaptive_baud", adaptive_baud, false);
+  ros::param::param<double>("~link_quality_threshold", link_quality_threshold, 0.98);
+  ros::param::param<double>("~link_quality_hold", link_quality_hold, 5.0);
+  ros::param::param<double>("~link_probe_interval", link_probe_interval, 120.0);
+  ros::param::param<double>("~link_utilisation", link_utilisation, 0.7);
+  std::vector<uint32_t> baud_ladder(1, baud);
+  if (adaptive_baud)
+  {
+    uint8_t field;
+    if (!um6::broadcastRateField(baud, BROADCAST_BYTES_PER_CYCLE, link_utilisation, &field))
+    {
+      ROS_WARN_STREAM("At " << baud << " baud, the enabled outputs need more than " << link_utilisation
+                      << " of the link even at the slowest broadcast rate.");
+    }
+    for (size_t i = 0; i < sizeof(BAUD_LADDER) / sizeof(BAUD_LADDER[0]); i++)
+    {
+      if (BAUD_LADDER[i] >= static_cast<uint32_t>(baud)) continue;
+      if (um6::broadcastRateField(BAUD_LADDER[i], BROADCAST_BYTES_PER_CYCLE, link_utilisation, &field))
+      {
+        baud_ladder.push_back(BAUD_LADDER[i]);
+      }
+      else
+      {
+        ROS_INFO_STREAM("Not stepping down to " << BAUD_LADDER[i] << " baud, which is too slow for the enabled "
+                        "outputs at " << link_utilisation << " of the link.");
+      }
+    }
+  }
+  um6::BaudController baud_controller(baud_ladder, link_quality_threshold, link_quality_hold, link_probe_interval);
+  um6::LinkQuality link_quality(link_quality_hold);
+  uint32_t link_baud = baud;
+  size_t connect_attempt = 0;
+
+  // With adaptive baud, save what has been learned about the link now and
+  // then, and pick up from it on startup if this is the same device. Without
+  // it, there is nothing in a snapshot to pick up.
+  std::string snapshot_path;
+  double snapshot_interval, snapshot_max_age;
+  ros::param::param<std::string>("~snapshot_path", snapshot_path, "");
+  ros::param::param<double>("~snapshot_interval", snapshot_interval, 30.0);
+  ros::param::param<double>("~snapshot_max_age", snapshot_max_age, 3600.0);
+  std::string device = um6::deviceIdentity(port);
+  if (!adaptive_baud)
+  {
+    snapshot_path.clear();
+  }
+  else if (snapshot_path.empty())
+  {
+    snapshot_path = um6::defaultSnapshotPath(device);
+  }
+  um6::DriverSnapshot snapshot;
+  bool restore_link = false;
+  if (!snapshot_path.empty() && um6::loadSnapshot(snapshot_path, &snapshot))
+  {
+    if (snapshot.device != device)
+    {
+      ROS_INFO_STREAM("Snapshot " << snapshot_path << " is of " << snapshot.device << ", not restoring.");
+    }
+    else if (um6::snapshotAge(snapshot) < 0 || um6::snapshotAge(snapshot) > snapshot_max_age)
+    {
+      ROS_INFO_STREAM("Snapshot " << snapshot_path << " was taken " << um6::snapshotAge(snapshot)
+                      << " s ago, outside ~snapshot_max_age, not restoring.");
+    }
+    else if (std::find(baud_ladder.begin(), baud_ladder.end(), snapshot.baud) == baud_ladder.end())
+    {
+      ROS_INFO_STREAM("Snapshot baud rate " << snapshot.baud << " is not on the ladder, not restoring.");
+    }
+    else
+    {
+      ROS_INFO_STREAM("Restoring link state for " << device << " from " << snapshot_path << ": "
+                      << snapshot.baud << " baud, quality " << snapshot.link_quality << ".");
+      link_baud = snapshot.baud;
+      baud_controller.setProbeInterval(snapshot.probe_interval);
+      restore_link = true;
+    }
+  }
+  boost::scoped_ptr<um6::SnapshotWriter> snapshot_writer;
+  if (!snapshot_path.empty() && snapshot_interval > 0)
+  {
+    snapshot_writer.reset(new um6::SnapshotWriter(snapshot_path));
+  }
+
+  // Housekeeping (metrics, link quality, snapshots) happens at most this often.
+  const uint64_t PERIODIC_INTERVAL_NS = 1000000000ull;
+  const double BAUD_SWITCH_TIMEOUT = 2.0;
+
+  // Started only now that every parameter has been checked, since returning
+  // early would leave it running against the hold and timer it was given.
+  if (timed)
+  {
+    timed_thread = boost::thread(publishTimed, timed_hold.get(), timed_timer.get(), &n, header.frame_id,
+                                 timed_delay);
+    cpu_cost_task.addThread("timed publish", timed_thread.native_handle());
+    driver_metrics.threadStarted(timed_thread.native_handle());
+    ROS_INFO_STREAM("Publishing at " << timed_rate << "Hz, phase " << timed_phase << "s.");
+  }
+
+  // Warnings from the serial hot path are rate-limited and passed to rosconsole from another thread.
+  um6::AsyncLog::start();
+
   bool first_failure = true;
   while (ros::ok())
   {
+    // After a failure, the device may have been left at any rate on the ladder,
+    // so try each in turn, starting from the one last configured and working
+    // down from it. A rate off the ladder is followed by the ladder's first.
+    size_t link_index = std::find(baud_ladder.begin(), baud_ladder.end(), link_baud) - baud_ladder.begin();
+    if (link_index >= baud_ladder.size()) link_index = baud_ladder.size() - 1;
+    uint32_t open_baud = connect_attempt == 0 ? link_baud :
+                         baud_ladder[(link_index + connect_attempt) % baud_ladder.size()];
+    ser.setBaudrate(open_baud);
     try
     {
       ser.open();
@@ -285,19 +1241,199 @@ int main(int argc, char **argv)
       try
       {
         um6::Comms sensor(&ser);
-        configureSensor(&sensor);
+        sensor.setFlightRecorder(recorder.get());
+        uint8_t broadcast_rate = 0;
+        if (adaptive_baud)
+        {
+          um6::broadcastRateField(open_baud, BROADCAST_BYTES_PER_CYCLE, link_utilisation, &broadcast_rate);
+        }
+        configureSensor(&sensor, open_baud, broadcast_rate);
+        if (adaptive_baud)
+        {
+          ROS_INFO_STREAM("Configured for " << open_baud << " baud, broadcasting at "
+                          << um6::broadcastRateHz(broadcast_rate) << "Hz.");
+        }
+        link_baud = open_baud;
+        connect_attempt = 0;
         um6::Registers registers;
         ros::ServiceServer srv = n.advertiseService<um6::Reset::Request, um6::Reset::Response>(
                                    "reset", boost::bind(handleResetService, &sensor, _1, _2));
 
+        um6::UartCounters uart(port);
+        um6::UartCounters::Counts uart_counts;
+        if (!uart.read(&uart_counts))
+        {
+          ROS_INFO_STREAM("Kernel UART error counters are not available for " << port << ".");
+        }
+        link_errors_task.connect(&sensor, &uart);
+
+        uint32_t failures = 0;
+        uint64_t bytes_accounted = 0;
+        uint64_t next_periodic_ns = 0;
+        double switch_deadline = 0;
+        uint64_t packets_at_switch = 0;
+        baud_controller.reset(link_baud, um6::traceClock() * 1e-9);
+        link_quality.reset(sensor.counters(), um6::traceClock() * 1e-9);
+        if (restore_link && link_baud == snapshot.baud)
+        {
+          link_quality.restore(snapshot.link_quality, snapshot.junk_rate, snapshot.resync_rate);
+        }
+        restore_link = false;
+        double next_snapshot = um6::traceClock() * 1e-9 + snapshot_interval;
+        decoder.reset();
+        if (timed_hold) timed_hold->reset();
+        if (windowed_stats) windowed_stats->reset();
+        mag_deadband.reset();
+        event_detector.reset();
+        temperature_deadband.reset();
+        channel_latency.discard();
+        latency.abandon();
+        driver_metrics.connected(uart.supported() ? &uart_counts : NULL);
         while (ros::ok())
         {
-          if (sensor.receive(&registers) == TRIGGER_PACKET)
+          if (cpu.stage() != um6::CpuAccounting::READ) cpu.enter(um6::CpuAccounting::READ);
+          int16_t received = sensor.receive(&registers);
+          if (received >= 0)
+          {
+            failures = 0;
+            // A cycle still open when the next begins lost its trigger packet.
+            if (received == CYCLE_START_PACKET) latency.abandon();
+            if (!latency.inCycle()) latency.mark(um6::LatencyTracer::FIRST_PACKET);
+            channel_latency.arrived(received, um6::traceClock());
+            if (early_rate && received == UM6_GYRO_PROC_XY && rate_pub.getNumSubscribers() > 0)
+            {
+              std_msgs::Header rate_header;
+              rate_header.frame_id = header.frame_id;
+              rate_header.stamp = ros::Time::now();
+              geometry_msgs::Vector3Stamped rate_msg;
+              um6::rateMessage(registers, rate_header, &rate_msg);
+              rate_pub.publish(rate_msg);
+              channel_latency.publishedEarly(um6::ChannelLatency::GYRO, um6::traceClock());
+              UM6_TRACE2(message_published, "imu/rate", rate_header.stamp.toNSec());
+            }
+            um6::EventDetector::Event event;
+            if (event_detector.enabled() &&
+                event_detector.check(received, registers, um6::traceClock() * 1e-9, &event))
+            {
+              std_msgs::Header event_header;
+              event_header.frame_id = header.frame_id;
+              event_header.stamp = ros::Time::now();
+              um6::ImuEvent event_msg;
+              um6::imuEventMessage(event, event_header, &event_msg);
+              event_pub.publish(event_msg);
+              UM6_TRACE2(event_detected, event.type, static_cast<int64_t>(event.magnitude * 1000));
+            }
+          }
+          else if (++failures == LINK_LOST_FAILURES)
+          {
+            dumpFlightRecorder(recorder.get(), "Link lost.");
+          }
+
+          if (received == TRIGGER_PACKET)
           {
             // Triggered by arrival of final message in group.
+            latency.mark(um6::LatencyTracer::LAST_PACKET);
+            cpu.enter(um6::CpuAccounting::DECODE);
+            cpu.addSample();
+            cpu.addBytes(sensor.counters().bytes - bytes_accounted);
+            bytes_accounted = sensor.counters().bytes;
             header.stamp = ros::Time::now();
-            publishMsgs(registers, &n, header);
+            UM6_TRACE1(cycle_complete, header.stamp.toNSec());
+            um6::Sample sample;
+            decoder.decode(registers, header.stamp, &sample);
+            latency.mark(um6::LatencyTracer::DECODED);
+            cpu.enter(um6::CpuAccounting::PUBLISH);
+            double cycle_time = um6::traceClock() * 1e-9;
+            int topics = 0;
+            if (mag_deadband.update(registers.mag, cycle_time)) topics |= PUBLISH_MAG;
+            if (temperature_deadband.update(registers.temperature, cycle_time)) topics |= PUBLISH_TEMPERATURE;
+            if (fan_out.size() > 0)
+            {
+              StampedSample stamped;
+              stamped.stamp_ns = header.stamp.toNSec();
+              stamped.sample = sample;
+              stamped.topics = topics;
+              fan_out.push(stamped);
+            }
+            if (timed_hold) timed_hold->put(sample);
+            else if (!publish_fan_out) publishMsgs(sample, &n, header, topics);
+            if (windowed_stats && windowed_stats->add(sample))
+            {
+              um6::ChannelStats stats_msg;
+              um6::channelStatsMessage(*windowed_stats, header, &stats_msg);
+              stats_pub.publish(stats_msg);
+            }
+            uint64_t published_ns = um6::traceClock();
+            latency.mark(um6::LatencyTracer::PUBLISHED, published_ns);
+            channel_latency.published(published_ns);
+            if (archive && !archive_fan_out) archive->append(sample);
+            if (register_log)
+            {
+              register_log_buffer.clear();
+              register_log_encoder.encode(header.stamp.toNSec(), registers, &register_log_buffer);
+              fwrite(register_log_buffer.data(), 1, register_log_buffer.length(), register_log);
+            }
+            latency.mark(um6::LatencyTracer::LOGGED);
             ros::spinOnce();
+            latency.mark(um6::LatencyTracer::SPUN);
+            updater.update();
+          }
+
+          uint64_t now_ns = um6::traceClock();
+          if (now_ns >= next_periodic_ns)
+          {
+            next_periodic_ns = now_ns + PERIODIC_INTERVAL_NS;
+            double now = now_ns * 1e-9;
+            if (metrics_server)
+            {
+              driver_metrics.update(sensor.counters(), uart.read(&uart_counts) ? &uart_counts : NULL,
+                                    registers, latency, cpu, archive.get());
+            }
+
+            if (adaptive_baud)
+            {
+              if (switch_deadline > 0 && now >= switch_deadline)
+              {
+                if (sensor.counters().packets == packets_at_switch)
+                {
+                  throw std::runtime_error("No packets received after changing baud rate.");
+                }
+                switch_deadline = 0;
+              }
+
+              link_quality.update(sensor.counters(), now);
+              uint32_t new_baud = baud_controller.update(link_quality.quality(), now);
+              if (new_baud)
+              {
+                uint8_t rate;
+                um6::broadcastRateField(new_baud, BROADCAST_BYTES_PER_CYCLE, link_utilisation, &rate);
+                ROS_WARN_STREAM("Link quality " << link_quality.quality() << " (" << link_quality.resyncsPerSecond()
+                                << " resyncs/s, " << link_quality.junkBytesPerSecond() << " junk bytes/s); "
+                                << "switching from " << link_baud << " to " << new_baud << " baud, broadcasting at "
+                                << um6::broadcastRateHz(rate) << "Hz.");
+                switchBaud(&sensor, &ser, new_baud, rate);
+                link_baud = new_baud;
+                link_quality.reset(sensor.counters(), now);
+                packets_at_switch = sensor.counters().packets;
+                switch_deadline = now + BAUD_SWITCH_TIMEOUT;
+              }
+            }
+
+            if (snapshot_writer && now >= next_snapshot)
+            {
+              next_snapshot = now + snapshot_interval;
+              snapshot.device = device;
+              snapshot.baud = link_baud;
+              snapshot.probe_interval = baud_controller.probeInterval();
+              snapshot.link_quality = link_quality.quality();
+              snapshot.junk_rate = link_quality.junkBytesPerSecond();
+              snapshot.resync_rate = link_quality.resyncsPerSecond();
+              snapshot_writer->save(snapshot);
+              if (snapshot_writer->failures() > 0)
+              {
+                ROS_WARN_STREAM_ONCE("Unable to save snapshot to " << snapshot_path << ".");
+              }
+            }
           }
         }
       }
@@ -305,6 +1441,10 @@ int main(int argc, char **argv)
       {
         if (ser.isOpen()) ser.close();
         ROS_ERROR_STREAM(e.what());
+        link_errors_task.disconnect();
+        baud_controller.linkLost();
+        connect_attempt++;
+        dumpFlightRecorder(recorder.get(), e.what());
         ROS_INFO("Attempting reconnection after error.");
         ros::Duration(1.0).sleep();
       }
@@ -317,4 +1457,9 @@ int main(int argc, char **argv)
       ros::Duration(1.0).sleep();
     }
   }
+
+  fan_out.stop();
+  if (timed_thread.joinable()) timed_thread.join();
+  if (register_log) fclose(register_log);
+  um6::AsyncLog::stop();
 }
@@ -0,0 +1,133 @@
+/**
+ *
+ *  \file
+ *  \brief      Construction of the ROS messages the driver publishes.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/messages.h"
+
+namespace um6
+{
+
+void imuMessage(const Sample& s, const std_msgs::Header& header, const MessageConfig& config,
+                sensor_msgs::Imu* msg)
+{
+  msg->header = header;
+
+  msg->orientation.x = s.channel[Sample::QUAT_X];
+  msg->orientation.y = s.channel[Sample::QUAT_Y];
+  msg->orientation.z = s.channel[Sample::QUAT_Z];
+  msg->orientation.w = s.channel[Sample::QUAT_W];
+
+  for (int i = 0; i < 9; i++)
+  {
+    msg->orientation_covariance[i] = s.orientation_covariance[i];
+  }
+
+  msg->angular_velocity.x = s.channel[Sample::GYRO_X];
+  msg->angular_velocity.y = s.channel[Sample::GYRO_Y];
+  msg->angular_velocity.z = s.channel[Sample::GYRO_Z];
+
+  msg->linear_acceleration.x = s.channel[Sample::ACCEL_X];
+  msg->linear_acceleration.y = s.channel[Sample::ACCEL_Y];
+  msg->linear_acceleration.z = s.channel[Sample::ACCEL_Z];
+
+  for (int i = 0; i < 9; i += 4)
+  {
+    msg->angular_velocity_covariance[i] = config.angular_velocity_covariance;
+    msg->linear_acceleration_covariance[i] = config.linear_acceleration_covariance;
+  }
+}
+
+void magMessage(const Sample& s, const std_msgs::Header& header, geometry_msgs::Vector3Stamped* msg)
+{
+  msg->header = header;
+  msg->vector.x = s.channel[Sample::MAG_X];
+  msg->vector.y = s.channel[Sample::MAG_Y];
+  msg->vector.z = s.channel[Sample::MAG_Z];
+}
+
+void rpyMessage(const Sample& s, const std_msgs::Header& header, geometry_msgs::Vector3Stamped* msg)
+{
+  msg->header = header;
+  msg->vector.x = s.channel[Sample::ROLL];
+  msg->vector.y = s.channel[Sample::PITCH];
+  msg->vector.z = s.channel[Sample::YAW];
+}
+
+void temperatureMessage(const Sample& s, std_msgs::Float32* msg)
+{
+  msg->data = s.channel[Sample::TEMPERATURE];
+}
+
+void rateMessage(const Registers& r, const std_msgs::Header& header, geometry_msgs::Vector3Stamped* msg)
+{
+  // NED -> ENU conversion, as in decodeSample.
+  msg->header = header;
+  msg->vector.x = r.gyro.get_scaled(1);
+  msg->vector.y = r.gyro.get_scaled(0);
+  msg->vector.z = -r.gyro.get_scaled(2);
+}
+
+void channelStatsMessage(const WindowedStats& stats, const std_msgs::Header& header, ChannelStats* msg)
+{
+  msg->header = header;
+  msg->header.stamp.fromSec(stats.start());
+  msg->window.fromSec(stats.window());
+  msg->count = stats.channel(0).count();
+  msg->channel.resize(Sample::NUM_CHANNELS);
+  msg->mean.resize(Sample::NUM_CHANNELS);
+  msg->stddev.resize(Sample::NUM_CHANNELS);
+  msg->min.resize(Sample::NUM_CHANNELS);
+  msg->max.resize(Sample::NUM_CHANNELS);
+  for (int c = 0; c < Sample::NUM_CHANNELS; c++)
+  {
+    const RunningStats& channel = stats.channel(c);
+    msg->channel[c] = Sample::channelName(c);
+    msg->mean[c] = channel.mean();
+    msg->stddev[c] = channel.stddev();
+    msg->min[c] = channel.min();
+    msg->max[c] = channel.max();
+  }
+}
+
+void imuEventMessage(const EventDetector::Event& event, const std_msgs::Header& header, ImuEvent* msg)
+{
+  msg->header = header;
+  msg->type = event.type == EventDetector::SHOCK ? ImuEvent::SHOCK : ImuEvent::ROTATION;
+  msg->magnitude = event.magnitude;
+  msg->vector.x = event.vector[0];
+  msg->vector.y = event.vector[1];
+  msg->vector.z = event.vector[2];
+}
+
+}  // namespace um6
@@ -0,0 +1,220 @@
+/**
+ *
+ *  \file
+ *  \brief      Driver metrics, served in Prometheus text format over a Unix socket.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/metrics.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "ros/console.h"
+
+namespace um6
+{
+
+namespace
+{
+const int POLL_INTERVAL_MS = 200;
+const int REQUEST_TIMEOUT_MS = 100;
+
+const char* typeName(Metrics::Type type)
+{
+  switch (type)
+  {
+  case Metrics::COUNTER: return "counter";
+  case Metrics::GAUGE: return "gauge";
+  default: return "summary";
+  }
+}
+
+/**
+ * Strips a summary's _count or _sum suffix, so that its parts share one
+ * HELP and TYPE line. */
+std::string family(const Metrics::Type type, const std::string& name)
+{
+  if (type != Metrics::SUMMARY) return name;
+  const char* suffixes[] = { "_count", "_sum" };
+  for (int i = 0; i < 2; i++)
+  {
+    size_t len = strlen(suffixes[i]);
+    if (name.length() > len && name.compare(name.length() - len, len, suffixes[i]) == 0)
+    {
+      return name.substr(0, name.length() - len);
+    }
+  }
+  return name;
+}
+}  // namespace
+
+Metrics::Metrics()
+{
+}
+
+Metrics::~Metrics()
+{
+  for (size_t i = 0; i < values_.size(); i++)
+  {
+    delete values_[i];
+  }
+}
+
+size_t Metrics::add(const std::string& name, const std::string& labels, Type type, const std::string& help)
+{
+  Info info = { name, labels, type, help };
+  info_.push_back(info);
+  values_.push_back(new boost::atomic<double>(0.0));
+  return values_.size() - 1;
+}
+
+void Metrics::render(std::string* out) const
+{
+  std::string last_family;
+  char value[32];
+  for (size_t i = 0; i < info_.size(); i++)
+  {
+    const Info& info = info_[i];
+    std::string name_family = family(info.type, info.name);
+    if (name_family != last_family)
+    {
+      *out += "# HELP " + name_family + " " + info.help + "\n";
+      *out += "# TYPE " + name_family + " " + typeName(info.type) + "\n";
+      last_family = name_family;
+    }
+    *out += info.name;
+    if (!info.labels.empty())
+    {
+      *out += "{" + info.labels + "}";
+    }
+    snprintf(value, sizeof(value), " %.15g\n", get(i));
+    *out += value;
+  }
+}
+
+MetricsServer::MetricsServer(const Metrics* metrics, const std::string& path)
+  : metrics_(metrics), path_(path), stopping_(false)
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.length() >= sizeof(addr.sun_path))
+  {
+    throw std::runtime_error("Metrics socket path " + path + " is too long.");
+  }
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0)
+  {
+    throw std::runtime_error(std::string("Unable to create metrics socket: ") + strerror(errno));
+  }
+  unlink(path.c_str());
+  if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(listen_fd_, 4) != 0)
+  {
+    std::string error = strerror(errno);
+    close(listen_fd_);
+    throw std::runtime_error("Unable to listen on metrics socket " + path + ": " + error);
+  }
+  thread_ = boost::thread(&MetricsServer::serve, this);
+}
+
+MetricsServer::~MetricsServer()
+{
+  stopping_ = true;
+  thread_.join();
+  close(listen_fd_);
+  unlink(path_.c_str());
+}
+
+void MetricsServer::serve()
+{
+  while (!stopping_)
+  {
+    struct pollfd p = { listen_fd_, POLLIN, 0 };
+    if (poll(&p, 1, POLL_INTERVAL_MS) <= 0) continue;
+    int fd = accept(listen_fd_, NULL, NULL);
+    if (fd < 0) continue;
+    respond(fd);
+    close(fd);
+  }
+}
+
+void MetricsServer::respond(int fd)
+{
+  // Read the request, if the client sends one, up to the end of its headers.
+  std::string request;
+  char buffer[512];
+  struct pollfd p = { fd, POLLIN, 0 };
+  while (request.find("\r\n\r\n") == std::string::npos && request.length() < 8192 &&
+         poll(&p, 1, REQUEST_TIMEOUT_MS) > 0)
+  {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0) break;
+    request.append(buffer, n);
+  }
+
+  std::string body;
+  metrics_->render(&body);
+  std::string response;
+  if (request.compare(0, 4, "GET ") == 0)
+  {
+    char header[128];
+    snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+             "Content-Length: %zu\r\n\r\n", body.length());
+    response = header;
+  }
+  response += body;
+
+  size_t written = 0;
+  while (written < response.length())
+  {
+    ssize_t n = send(fd, response.data() + written, response.length() - written, MSG_NOSIGNAL);
+    if (n <= 0)
+    {
+      ROS_DEBUG("Metrics client went away before the response was sent.");
+      return;
+    }
+    written += n;
+  }
+}
+
+}  // namespace um6
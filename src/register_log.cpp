@@ -0,0 +1,331 @@
+/**
+ *
+ *  \file
+ *  \brief      Implementation of the register-frame log encoder and decoder.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/register_log.h"
+
+#include <endian.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "um6/registers.h"
+
+namespace um6
+{
+
+static const uint8_t LOG_MAGIC[8] = { 'U', 'M', '6', 'R', 'L', 'O', 'G', '\0' };
+static const uint8_t LOG_VERSION = 1;
+static const uint8_t KEYFRAME_SYNC[4] = { 0xA5, 'U', '6', 'K' };
+static const uint8_t DELTA_TAG = 'D';
+
+const size_t RegisterLogHeader::SIZE = 16;
+
+// Keyframe size, excluding the sync word.
+static size_t keyframeBodySize(uint8_t register_count)
+{
+  return 4 + 8 + register_count * 4 + 2;
+}
+
+static void putLE(std::string* out, uint64_t value, uint8_t bytes)
+{
+  for (uint8_t i = 0; i < bytes; i++)
+  {
+    out->push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+static uint64_t getLE(const uint8_t* data, uint8_t bytes)
+{
+  uint64_t value = 0;
+  for (uint8_t i = 0; i < bytes; i++)
+  {
+    value |= static_cast<uint64_t>(data[i]) << (8 * i);
+  }
+  return value;
+}
+
+static uint16_t checksum(const uint8_t* data, size_t length)
+{
+  uint16_t sum = 0;
+  for (size_t i = 0; i < length; i++)
+  {
+    sum += data[i];
+  }
+  return sum;
+}
+
+/**
+ * Splits network-order register words into host-order 16-bit channels.
+ */
+static void wordsToChannels(const uint32_t* words, uint8_t count, uint16_t* channels)
+{
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(words);
+  for (uint16_t i = 0; i < count * 2; i++)
+  {
+    channels[i] = (bytes[2 * i] << 8) | bytes[2 * i + 1];
+  }
+}
+
+static void channelsToWords(const uint16_t* channels, uint8_t count, uint32_t* words)
+{
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(words);
+  for (uint16_t i = 0; i < count * 2; i++)
+  {
+    bytes[2 * i] = channels[i] >> 8;
+    bytes[2 * i + 1] = channels[i] & 0xFF;
+  }
+}
+
+RegisterLogEncoder::RegisterLogEncoder(uint8_t first_register, uint8_t register_count,
+                                       uint32_t keyframe_interval)
+  : frame_(0), stamp_ns_(0), channels_(register_count * 2), zigzag_(register_count * 2)
+{
+  if (first_register + register_count > NUM_REGISTERS)
+  {
+    throw std::range_error("Logged register range extends beyond register array.");
+  }
+  config_.first_register = first_register;
+  config_.register_count = register_count;
+  config_.keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+}
+
+void RegisterLogEncoder::header(std::string* out) const
+{
+  out->append(reinterpret_cast<const char*>(LOG_MAGIC), sizeof(LOG_MAGIC));
+  out->push_back(LOG_VERSION);
+  out->push_back(config_.first_register);
+  out->push_back(config_.register_count);
+  out->push_back(0);
+  putLE(out, config_.keyframe_interval, 4);
+}
+
+void RegisterLogEncoder::encode(uint64_t stamp_ns, const Registers& registers, std::string* out)
+{
+  uint32_t words[NUM_REGISTERS];
+  registers.read_raw(config_.first_register, config_.register_count, words);
+  encode(stamp_ns, words, out);
+}
+
+void RegisterLogEncoder::encode(uint64_t stamp_ns, const uint32_t* words, std::string* out)
+{
+  const uint16_t num_channels = config_.register_count * 2;
+  uint16_t current[NUM_REGISTERS * 2];
+  wordsToChannels(words, config_.register_count, current);
+
+  if (frame_ % config_.keyframe_interval == 0)
+  {
+    size_t start = out->length();
+    out->append(reinterpret_cast<const char*>(KEYFRAME_SYNC), sizeof(KEYFRAME_SYNC));
+    putLE(out, frame_, 4);
+    putLE(out, stamp_ns, 8);
+    for (uint16_t i = 0; i < num_channels; i++)
+    {
+      putLE(out, current[i], 2);
+    }
+    const uint8_t* body = reinterpret_cast<const uint8_t*>(out->data()) + start + sizeof(KEYFRAME_SYNC);
+    putLE(out, checksum(body, out->length() - start - sizeof(KEYFRAME_SYNC)), 2);
+  }
+  else
+  {
+    out->push_back(DELTA_TAG);
+
+    // Stamp delta as a zig-zag LEB128 varint.
+    int64_t stamp_delta = static_cast<int64_t>(stamp_ns - stamp_ns_);
+    uint64_t zz_stamp = (static_cast<uint64_t>(stamp_delta) << 1) ^ static_cast<uint64_t>(stamp_delta >> 63);
+    while (zz_stamp >= 0x80)
+    {
+      out->push_back(static_cast<char>(zz_stamp | 0x80));
+      zz_stamp >>= 7;
+    }
+    out->push_back(static_cast<char>(zz_stamp));
+
+    // Zig-zag the channel deltas, noting the widest.
+    uint16_t all = 0;
+    for (uint16_t i = 0; i < num_channels; i++)
+    {
+      int16_t delta = static_cast<int16_t>(current[i] - channels_[i]);
+      zigzag_[i] = static_cast<uint16_t>((delta << 1) ^ (delta >> 15));
+      all |= zigzag_[i];
+    }
+    uint8_t width = 0;
+    while (all >> width) width++;
+    out->push_back(width);
+
+    // Pack them at that width, least significant bits first.
+    uint32_t acc = 0;
+    uint8_t bits = 0;
+    for (uint16_t i = 0; width > 0 && i < num_channels; i++)
+    {
+      acc |= static_cast<uint32_t>(zigzag_[i]) << bits;
+      bits += width;
+      while (bits >= 8)
+      {
+        out->push_back(static_cast<char>(acc));
+        acc >>= 8;
+        bits -= 8;
+      }
+    }
+    if (bits > 0) out->push_back(static_cast<char>(acc));
+  }
+
+  memcpy(&channels_[0], current, num_channels * sizeof(uint16_t));
+  stamp_ns_ = stamp_ns;
+  frame_++;
+}
+
+size_t RegisterLogDecoder::header(const uint8_t* data, size_t length)
+{
+  if (length < RegisterLogHeader::SIZE) return 0;
+  if (memcmp(data, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || data[8] != LOG_VERSION)
+  {
+    throw std::runtime_error("Not a register-frame log.");
+  }
+  config_.first_register = data[9];
+  config_.register_count = data[10];
+  config_.keyframe_interval = getLE(data + 12, 4);
+  if (config_.first_register + config_.register_count > NUM_REGISTERS)
+  {
+    throw std::runtime_error("Register-frame log covers registers beyond register array.");
+  }
+  channels_.assign(config_.register_count * 2, 0);
+  synced_ = false;
+  return RegisterLogHeader::SIZE;
+}
+
+size_t RegisterLogDecoder::findKeyframe(const uint8_t* data, size_t length, size_t from) const
+{
+  const size_t body = keyframeBodySize(config_.register_count);
+  for (size_t i = from; i + sizeof(KEYFRAME_SYNC) + body <= length; i++)
+  {
+    if (data[i] != KEYFRAME_SYNC[0] || memcmp(data + i, KEYFRAME_SYNC, sizeof(KEYFRAME_SYNC)) != 0)
+    {
+      continue;
+    }
+    const uint8_t* k = data + i + sizeof(KEYFRAME_SYNC);
+    if (checksum(k, body - 2) == getLE(k + body - 2, 2))
+    {
+      return i;
+    }
+  }
+  return length;
+}
+
+size_t RegisterLogDecoder::decode(const uint8_t* data, size_t length, uint64_t* stamp_ns, uint32_t* words)
+{
+  const uint16_t num_channels = config_.register_count * 2;
+  if (length < 1) return 0;
+
+  if (data[0] == KEYFRAME_SYNC[0])
+  {
+    const size_t body = keyframeBodySize(config_.register_count);
+    if (length < sizeof(KEYFRAME_SYNC) + body) return 0;
+    if (memcmp(data, KEYFRAME_SYNC, sizeof(KEYFRAME_SYNC)) != 0)
+    {
+      throw std::runtime_error("Corrupt keyframe sync in register-frame log.");
+    }
+    const uint8_t* k = data + sizeof(KEYFRAME_SYNC);
+    if (checksum(k, body - 2) != getLE(k + body - 2, 2))
+    {
+      throw std::runtime_error("Bad keyframe checksum in register-frame log.");
+    }
+    frame_ = getLE(k, 4);
+    stamp_ns_ = getLE(k + 4, 8);
+    for (uint16_t i = 0; i < num_channels; i++)
+    {
+      channels_[i] = getLE(k + 12 + 2 * i, 2);
+    }
+    synced_ = true;
+    *stamp_ns = stamp_ns_;
+    channelsToWords(&channels_[0], config_.register_count, words);
+    return sizeof(KEYFRAME_SYNC) + body;
+  }
+
+  if (data[0] != DELTA_TAG)
+  {
+    throw std::runtime_error("Unknown frame type in register-frame log.");
+  }
+  if (!synced_)
+  {
+    throw std::runtime_error("Delta frame in register-frame log without preceding keyframe.");
+  }
+
+  size_t pos = 1;
+  uint64_t zz_stamp = 0;
+  for (uint8_t shift = 0; ; shift += 7)
+  {
+    if (pos >= length) return 0;
+    if (shift > 63) throw std::runtime_error("Overlong stamp in register-frame log.");
+    uint8_t b = data[pos++];
+    zz_stamp |= static_cast<uint64_t>(b & 0x7F) << shift;
+    if (!(b & 0x80)) break;
+  }
+  if (pos >= length) return 0;
+  uint8_t width = data[pos++];
+  if (width > 16) throw std::runtime_error("Bad delta width in register-frame log.");
+  size_t packed_bytes = (num_channels * width + 7) / 8;
+  if (pos + packed_bytes > length) return 0;
+
+  // Copy the packed deltas somewhere with slack at the end, so that every
+  // channel can be pulled out by the same unaligned 32-bit load. The two loops
+  // below have no dependencies between channels, and vectorize.
+  uint8_t packed[NUM_REGISTERS * 4 + 4];
+  memcpy(packed, data + pos, packed_bytes);
+  memset(packed + packed_bytes, 0, 4);
+
+  uint16_t zigzag[NUM_REGISTERS * 2];
+  const uint32_t mask = (1u << width) - 1;
+  for (uint16_t i = 0; i < num_channels; i++)
+  {
+    uint32_t bit = i * width;
+    uint32_t w;
+    memcpy(&w, packed + (bit >> 3), sizeof(w));
+    zigzag[i] = (le32toh(w) >> (bit & 7)) & mask;
+  }
+  for (uint16_t i = 0; i < num_channels; i++)
+  {
+    uint16_t delta = (zigzag[i] >> 1) ^ -(zigzag[i] & 1);
+    channels_[i] += delta;
+  }
+
+  stamp_ns_ += static_cast<uint64_t>((zz_stamp >> 1) ^ -(zz_stamp & 1));
+  frame_++;
+  *stamp_ns = stamp_ns_;
+  channelsToWords(&channels_[0], config_.register_count, words);
+  return pos + packed_bytes;
+}
+
+}  // namespace um6
@@ -0,0 +1,134 @@
+/**
+ *
+ *  \file
+ *  \brief      Decoding of complete UM6 cycles out of the register array.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/sample.h"
+
+#include "um6/registers.h"
+
+namespace um6
+{
+
+const char* SampleChannels::channelName(int channel)
+{
+  static const char* names[NUM_CHANNELS] =
+  {
+    "gyro_x", "gyro_y", "gyro_z",
+    "accel_x", "accel_y", "accel_z",
+    "mag_x", "mag_y", "mag_z",
+    "roll", "pitch", "yaw",
+    "quat_x", "quat_y", "quat_z", "quat_w",
+    "temperature"
+  };
+  if (channel < 0 || channel >= NUM_CHANNELS) return "unknown";
+  return names[channel];
+}
+
+template<typename T>
+void decodeSample(const Registers& r, double stamp, BasicSample<T>* s)
+{
+  s->stamp = stamp;
+
+  // NED -> ENU conversion.
+  s->channel[Sample::GYRO_X] = r.gyro.get_scaled_as<T>(1);
+  s->channel[Sample::GYRO_Y] = r.gyro.get_scaled_as<T>(0);
+  s->channel[Sample::GYRO_Z] = -r.gyro.get_scaled_as<T>(2);
+
+  s->channel[Sample::ACCEL_X] = r.accel.get_scaled_as<T>(1);
+  s->channel[Sample::ACCEL_Y] = r.accel.get_scaled_as<T>(0);
+  s->channel[Sample::ACCEL_Z] = -r.accel.get_scaled_as<T>(2);
+
+  s->channel[Sample::MAG_X] = r.mag.get_scaled_as<T>(1);
+  s->channel[Sample::MAG_Y] = r.mag.get_scaled_as<T>(0);
+  s->channel[Sample::MAG_Z] = -r.mag.get_scaled_as<T>(2);
+
+  s->channel[Sample::ROLL] = r.euler.get_scaled_as<T>(1);
+  s->channel[Sample::PITCH] = r.euler.get_scaled_as<T>(0);
+  s->channel[Sample::YAW] = -r.euler.get_scaled_as<T>(2);
+
+  // IMU outputs [w,x,y,z] NED, convert to [x,y,z,w] ENU
+  s->channel[Sample::QUAT_X] = r.quat.get_scaled_as<T>(2);
+  s->channel[Sample::QUAT_Y] = r.quat.get_scaled_as<T>(1);
+  s->channel[Sample::QUAT_Z] = -r.quat.get_scaled_as<T>(3);
+  s->channel[Sample::QUAT_W] = r.quat.get_scaled_as<T>(0);
+
+  s->channel[Sample::TEMPERATURE] = r.temperature.get_scaled_as<T>(0);
+
+  // IMU reports a 4x4 wxyz covariance, ROS requires only 3x3 xyz.
+  // NED -> ENU conversion req'd?
+  static const uint8_t cov_fields[9] = { 5, 6, 7, 9, 10, 11, 13, 14, 15 };
+  for (uint8_t i = 0; i < 9; i++)
+  {
+    s->orientation_covariance[i] = r.covariance.get_scaled_as<T>(cov_fields[i]);
+  }
+}
+
+template void decodeSample(const Registers& r, double stamp, BasicSample<double>* s);
+template void decodeSample(const Registers& r, double stamp, BasicSample<float>* s);
+
+void encodeSample(const Sample& s, Registers* r)
+{
+  // ENU -> NED conversion.
+  r->gyro.set_scaled(0, s.channel[Sample::GYRO_Y]);
+  r->gyro.set_scaled(1, s.channel[Sample::GYRO_X]);
+  r->gyro.set_scaled(2, -s.channel[Sample::GYRO_Z]);
+
+  r->accel.set_scaled(0, s.channel[Sample::ACCEL_Y]);
+  r->accel.set_scaled(1, s.channel[Sample::ACCEL_X]);
+  r->accel.set_scaled(2, -s.channel[Sample::ACCEL_Z]);
+
+  r->mag.set_scaled(0, s.channel[Sample::MAG_Y]);
+  r->mag.set_scaled(1, s.channel[Sample::MAG_X]);
+  r->mag.set_scaled(2, -s.channel[Sample::MAG_Z]);
+
+  r->euler.set_scaled(0, s.channel[Sample::PITCH]);
+  r->euler.set_scaled(1, s.channel[Sample::ROLL]);
+  r->euler.set_scaled(2, -s.channel[Sample::YAW]);
+
+  // [x,y,z,w] ENU -> [w,x,y,z] NED
+  r->quat.set_scaled(0, s.channel[Sample::QUAT_W]);
+  r->quat.set_scaled(1, s.channel[Sample::QUAT_Y]);
+  r->quat.set_scaled(2, s.channel[Sample::QUAT_X]);
+  r->quat.set_scaled(3, -s.channel[Sample::QUAT_Z]);
+
+  r->temperature.set_scaled(0, s.channel[Sample::TEMPERATURE]);
+
+  static const uint8_t cov_fields[9] = { 5, 6, 7, 9, 10, 11, 13, 14, 15 };
+  for (uint8_t i = 0; i < 9; i++)
+  {
+    r->covariance.set_scaled(cov_fields[i], s.orientation_covariance[i]);
+  }
+}
+
+}  // namespace um6
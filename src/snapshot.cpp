@@ -0,0 +1,277 @@
+/**
+ *
+ *  \file
+ *  \brief      Snapshots of what the driver has learned about a device and its
+ *              link, for a warm restart.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/snapshot.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace um6
+{
+
+static const char SNAPSHOT_MAGIC[8] = { 'U', 'M', '6', 'S', 'N', 'A', 'P', '\0' };
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const char BY_ID_DIR[] = "/dev/serial/by-id";
+
+// The device name is the only variable-length field, and is bounded to keep
+// a damaged file from claiming an unreasonable length.
+static const size_t MAX_DEVICE_LENGTH = 255;
+
+/**
+ * FNV-1a over the encoded snapshot, to catch a truncated or damaged file. */
+static uint32_t checksum(const std::string& data)
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < data.size(); i++)
+  {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+  }
+  return hash;
+}
+
+template<typename T>
+static void put(std::string* out, T value)
+{
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+static bool get(const std::string& in, size_t* pos, T* value)
+{
+  if (in.size() - *pos < sizeof(T)) return false;
+  memcpy(value, in.data() + *pos, sizeof(T));
+  *pos += sizeof(T);
+  return true;
+}
+
+DriverSnapshot::DriverSnapshot()
+  : stamp_ns(0), baud(0), probe_interval(0), link_quality(1.0), junk_rate(0), resync_rate(0)
+{
+}
+
+bool saveSnapshot(const std::string& path, const DriverSnapshot& snapshot)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  std::string data(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  put(&data, SNAPSHOT_VERSION);
+  std::string device = snapshot.device.substr(0, MAX_DEVICE_LENGTH);
+  put(&data, static_cast<uint16_t>(device.size()));
+  data += device;
+  put(&data, static_cast<uint64_t>(now.tv_sec) * 1000000000ull + now.tv_nsec);
+  put(&data, snapshot.baud);
+  put(&data, snapshot.probe_interval);
+  put(&data, snapshot.link_quality);
+  put(&data, snapshot.junk_rate);
+  put(&data, snapshot.resync_rate);
+  put(&data, checksum(data));
+
+  // mkstemp creates the temporary file exclusively, under a name nobody can
+  // plant a link at in advance.
+  std::string tmp_template = path + ".XXXXXX";
+  std::vector<char> tmp_path(tmp_template.begin(), tmp_template.end());
+  tmp_path.push_back('\0');
+  int fd = mkstemp(&tmp_path[0]);
+  if (fd < 0) return false;
+  bool ok = write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+  ok = (fsync(fd) == 0) && ok;
+  ok = (close(fd) == 0) && ok;
+  if (!ok || rename(&tmp_path[0], path.c_str()) != 0)
+  {
+    unlink(&tmp_path[0]);
+    return false;
+  }
+  return true;
+}
+
+double snapshotAge(const DriverSnapshot& snapshot)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  int64_t now_ns = static_cast<int64_t>(now.tv_sec) * 1000000000ll + now.tv_nsec;
+  return (now_ns - static_cast<int64_t>(snapshot.stamp_ns)) * 1e-9;
+}
+
+bool loadSnapshot(const std::string& path, DriverSnapshot* snapshot)
+{
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  char buffer[512];
+  size_t length = fread(buffer, 1, sizeof(buffer), f);
+  fclose(f);
+  std::string data(buffer, length);
+
+  uint32_t stored_checksum;
+  if (data.size() < sizeof(SNAPSHOT_MAGIC) + sizeof(stored_checksum) ||
+      memcmp(data.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+  {
+    return false;
+  }
+  size_t end = data.size() - sizeof(stored_checksum);
+  memcpy(&stored_checksum, data.data() + end, sizeof(stored_checksum));
+  data.resize(end);
+  if (checksum(data) != stored_checksum) return false;
+
+  size_t pos = sizeof(SNAPSHOT_MAGIC);
+  uint32_t version;
+  uint16_t device_length;
+  if (!get(data, &pos, &version) || version != SNAPSHOT_VERSION ||
+      !get(data, &pos, &device_length) || data.size() - pos < device_length)
+  {
+    return false;
+  }
+  DriverSnapshot s;
+  s.device = data.substr(pos, device_length);
+  pos += device_length;
+  if (!get(data, &pos, &s.stamp_ns) || !get(data, &pos, &s.baud) || !get(data, &pos, &s.probe_interval) ||
+      !get(data, &pos, &s.link_quality) || !get(data, &pos, &s.junk_rate) || !get(data, &pos, &s.resync_rate) ||
+      pos != data.size())
+  {
+    return false;
+  }
+  *snapshot = s;
+  return true;
+}
+
+std::string deviceIdentity(const std::string& port)
+{
+  char resolved[PATH_MAX];
+  if (!realpath(port.c_str(), resolved)) return port;
+
+  DIR* dir = opendir(BY_ID_DIR);
+  if (dir)
+  {
+    struct dirent* entry;
+    char target[PATH_MAX];
+    while ((entry = readdir(dir)) != NULL)
+    {
+      if (entry->d_name[0] == '.') continue;
+      std::string link = std::string(BY_ID_DIR) + "/" + entry->d_name;
+      if (realpath(link.c_str(), target) && strcmp(target, resolved) == 0)
+      {
+        std::string name = entry->d_name;
+        closedir(dir);
+        return name;
+      }
+    }
+    closedir(dir);
+  }
+  return resolved;
+}
+
+std::string defaultSnapshotPath(const std::string& device)
+{
+  std::string name;
+  for (size_t i = 0; i < device.size() && name.size() < MAX_DEVICE_LENGTH; i++)
+  {
+    char c = device[i];
+    if (i == 0 && c == '/') continue;
+    name += (isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '.') ? c : '_';
+  }
+
+  // As ROS itself does for its logs, rather than somewhere world-writable.
+  const char* ros_home = getenv("ROS_HOME");
+  const char* home = getenv("HOME");
+  std::string dir;
+  if (ros_home && *ros_home)
+  {
+    dir = ros_home;
+  }
+  else if (home && *home)
+  {
+    dir = std::string(home) + "/.ros";
+  }
+  else
+  {
+    return "";
+  }
+  return dir + "/um6_snapshot_" + name + ".bin";
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+  : path_(path), has_pending_(false), stopping_(false), failures_(0)
+{
+  thread_ = boost::thread(&SnapshotWriter::writeLoop, this);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stopping_ = true;
+    cond_.notify_all();
+  }
+  thread_.join();
+}
+
+void SnapshotWriter::save(const DriverSnapshot& snapshot)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  pending_ = snapshot;
+  has_pending_ = true;
+  cond_.notify_all();
+}
+
+void SnapshotWriter::writeLoop()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  while (true)
+  {
+    while (!has_pending_ && !stopping_)
+    {
+      cond_.wait(lock);
+    }
+    if (!has_pending_) break;
+
+    DriverSnapshot snapshot = pending_;
+    has_pending_ = false;
+    lock.unlock();
+    if (!saveSnapshot(path_, snapshot)) failures_++;
+    lock.lock();
+  }
+}
+
+}  // namespace um6
@@ -0,0 +1,180 @@
+/**
+ *
+ *  \file
+ *  \brief      Output of samples on a fixed-phase timer, independent of when
+ *              they arrive from the serial port.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#include "um6/timed_output.h"
+
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace um6
+{
+
+SampleHold::SampleHold(Mode mode, double max_extrapolation)
+  : mode_(mode), max_extrapolation_(max_extrapolation), count_(0)
+{
+}
+
+void SampleHold::put(const Sample& sample)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  previous_ = newest_;
+  newest_ = sample;
+  if (count_ < 2) count_++;
+}
+
+bool SampleHold::get(double stamp, Sample* sample, double* age) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (count_ == 0) return false;
+  *age = stamp - newest_.stamp;
+
+  double span = newest_.stamp - previous_.stamp;
+  if (mode_ == LATEST || count_ < 2 || span <= 0)
+  {
+    *sample = newest_;
+    return true;
+  }
+
+  double limit = newest_.stamp;
+  if (mode_ == EXTRAPOLATE) limit += max_extrapolation_;
+  double fraction = (std::min(stamp, limit) - previous_.stamp) / span;
+  blendSamples(previous_, newest_, std::max(fraction, 0.0), sample);
+  return true;
+}
+
+void SampleHold::reset()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  count_ = 0;
+}
+
+bool SampleHold::parseMode(const std::string& name, Mode* mode)
+{
+  if (name == "latest") *mode = LATEST;
+  else if (name == "interpolate") *mode = INTERPOLATE;
+  else if (name == "extrapolate") *mode = EXTRAPOLATE;
+  else return false;
+  return true;
+}
+
+/**
+ * Wraps an angle in radians into [-pi, pi). */
+static double wrapAngle(double angle)
+{
+  return angle - 2 * M_PI * floor((angle + M_PI) / (2 * M_PI));
+}
+
+void blendSamples(const Sample& from, const Sample& to, double fraction, Sample* sample)
+{
+  sample->stamp = from.stamp + fraction * (to.stamp - from.stamp);
+
+  for (int i = Sample::GYRO_X; i <= Sample::MAG_Z; i++)
+  {
+    sample->channel[i] = from.channel[i] + fraction * (to.channel[i] - from.channel[i]);
+  }
+  sample->channel[Sample::TEMPERATURE] = from.channel[Sample::TEMPERATURE] +
+    fraction * (to.channel[Sample::TEMPERATURE] - from.channel[Sample::TEMPERATURE]);
+
+  for (int i = Sample::ROLL; i <= Sample::YAW; i++)
+  {
+    double delta = wrapAngle(to.channel[i] - from.channel[i]);
+    sample->channel[i] = wrapAngle(from.channel[i] + fraction * delta);
+  }
+
+  // q and -q are the same orientation; blend towards whichever is nearer.
+  double dot = 0;
+  for (int i = Sample::QUAT_X; i <= Sample::QUAT_W; i++) dot += from.channel[i] * to.channel[i];
+  double sign = dot < 0 ? -1.0 : 1.0;
+  double norm = 0;
+  for (int i = Sample::QUAT_X; i <= Sample::QUAT_W; i++)
+  {
+    sample->channel[i] = from.channel[i] + fraction * (sign * to.channel[i] - from.channel[i]);
+    norm += sample->channel[i] * sample->channel[i];
+  }
+  if (norm > 0)
+  {
+    norm = sqrt(norm);
+    for (int i = Sample::QUAT_X; i <= Sample::QUAT_W; i++) sample->channel[i] /= norm;
+  }
+
+  std::copy(to.orientation_covariance, to.orientation_covariance + 9, sample->orientation_covariance);
+}
+
+PhaseTimer::PhaseTimer(uint64_t period_ns, uint64_t phase_ns)
+  : period_ns_(period_ns), phase_ns_(phase_ns), last_(0), missed_(0)
+{
+  if (period_ns == 0) throw std::runtime_error("Timer period must be positive.");
+  if (phase_ns >= period_ns) throw std::runtime_error("Timer phase must be less than its period.");
+}
+
+uint64_t PhaseTimer::next(uint64_t now_ns) const
+{
+  if (now_ns < phase_ns_) return phase_ns_;
+  return phase_ns_ + ((now_ns - phase_ns_) / period_ns_ + 1) * period_ns_;
+}
+
+uint64_t PhaseTimer::wait()
+{
+  uint64_t now_ns = now();
+  uint64_t tick = last_ ? last_ + period_ns_ : next(now_ns);
+  if (tick <= now_ns)
+  {
+    uint64_t upcoming = next(now_ns);
+    missed_ += (upcoming - tick) / period_ns_;
+    tick = upcoming;
+  }
+
+  struct timespec ts;
+  ts.tv_sec = tick / 1000000000ull;
+  ts.tv_nsec = tick % 1000000000ull;
+  while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL) == EINTR)
+  {
+  }
+  last_ = tick;
+  return tick;
+}
+
+uint64_t PhaseTimer::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+}  // namespace um6
@@ -0,0 +1,54 @@
+/**
+ *
+ *  \file
+ *  \brief      Storage for the tracepoint semaphores.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/trace.h"
+
+#ifdef UM6_HAVE_SDT
+
+// Tracers increment these while attached to the matching probe.
+#define UM6_TRACE_DEFINE(name) volatile uint16_t um6_##name##_semaphore = 0
+
+UM6_TRACE_DEFINE(header_found);
+UM6_TRACE_DEFINE(checksum_ok);
+UM6_TRACE_DEFINE(checksum_bad);
+UM6_TRACE_DEFINE(write_raw);
+UM6_TRACE_DEFINE(receive_timeout);
+UM6_TRACE_DEFINE(cycle_complete);
+UM6_TRACE_DEFINE(message_published);
+UM6_TRACE_DEFINE(command_sent);
+UM6_TRACE_DEFINE(ack_received);
+UM6_TRACE_DEFINE(event_detected);
+
+#endif  // UM6_HAVE_SDT
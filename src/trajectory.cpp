@@ -0,0 +1,252 @@
+/**
+ *
+ *  \file
+ *  \brief      Synthetic motion for an emulated device: scripted trajectories
+ *              and models of sensor noise and bias.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#include "um6/trajectory.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace um6
+{
+
+// Specific force at rest and the earth's field, both in the world (ENU) frame.
+static const double GRAVITY[3] = { 0.0, 0.0, 1.0 };
+static const double EARTH_FIELD[3] = { 0.0, 0.4472136, -0.8944272 };
+
+TrajectorySegment::TrajectorySegment()
+  : duration(0), vibration_amplitude(0), vibration_frequency(0), temperature_rate(0)
+{
+  std::fill(rate, rate + 3, 0.0);
+  std::fill(mag_disturbance, mag_disturbance + 3, 0.0);
+}
+
+static void parseError(int line, const std::string& message)
+{
+  std::ostringstream ss;
+  ss << "Trajectory line " << line << ": " << message;
+  throw std::runtime_error(ss.str());
+}
+
+std::vector<TrajectorySegment> parseTrajectory(std::istream& in)
+{
+  std::vector<TrajectorySegment> script;
+  std::string text;
+  for (int line = 1; std::getline(in, text); line++)
+  {
+    text = text.substr(0, text.find('#'));
+    std::istringstream tokens(text);
+    std::string token;
+    if (!(tokens >> token)) continue;
+
+    TrajectorySegment segment;
+    char extra;
+    if (sscanf(token.c_str(), "%lf%c", &segment.duration, &extra) != 1 || !(segment.duration > 0))
+    {
+      parseError(line, "expected a positive duration, not " + token + ".");
+    }
+    while (tokens >> token)
+    {
+      size_t equals = token.find('=');
+      std::string key = token.substr(0, equals);
+      const char* value = equals == std::string::npos ? "" : token.c_str() + equals + 1;
+      bool ok;
+      if (key == "rate")
+      {
+        ok = sscanf(value, "%lf,%lf,%lf%c", &segment.rate[0], &segment.rate[1], &segment.rate[2], &extra) == 3;
+      }
+      else if (key == "vibration")
+      {
+        ok = sscanf(value, "%lf,%lf%c", &segment.vibration_amplitude, &segment.vibration_frequency, &extra) == 2;
+      }
+      else if (key == "temperature_rate")
+      {
+        ok = sscanf(value, "%lf%c", &segment.temperature_rate, &extra) == 1;
+      }
+      else if (key == "mag")
+      {
+        ok = sscanf(value, "%lf,%lf,%lf%c", &segment.mag_disturbance[0], &segment.mag_disturbance[1],
+                    &segment.mag_disturbance[2], &extra) == 3;
+      }
+      else
+      {
+        parseError(line, "unknown setting " + key + ".");
+      }
+      if (!ok) parseError(line, "unable to parse " + token + ".");
+    }
+    script.push_back(segment);
+  }
+  return script;
+}
+
+SensorNoise::SensorNoise() : white(0), bias(0), bias_walk(0), bias_temperature(0)
+{
+}
+
+NoiseModel::NoiseModel() : temperature(0)
+{
+}
+
+TrajectoryGenerator::TrajectoryGenerator(const std::vector<TrajectorySegment>& script, const NoiseModel& noise,
+                                         uint32_t seed, double temperature)
+  : script_(script), noise_(noise), random_(seed), time_(0), segment_(0), segment_start_(0),
+    temperature_(temperature), start_temperature_(temperature)
+{
+  q_[0] = q_[1] = q_[2] = 0;
+  q_[3] = 1;
+  const SensorNoise* models[NUM_SENSORS] = { &noise_.gyro, &noise_.accel, &noise_.mag };
+  for (int s = 0; s < NUM_SENSORS; s++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      walk_[s][i] = 0;
+      bias_[s][i] = models[s]->bias;
+    }
+  }
+}
+
+double TrajectoryGenerator::duration() const
+{
+  double total = 0;
+  for (size_t i = 0; i < script_.size(); i++) total += script_[i].duration;
+  return total;
+}
+
+const TrajectorySegment& TrajectoryGenerator::current() const
+{
+  static const TrajectorySegment stationary;
+  return segment_ < script_.size() ? script_[segment_] : stationary;
+}
+
+double TrajectoryGenerator::gaussian()
+{
+  return normal_(random_);
+}
+
+void TrajectoryGenerator::advance(double dt)
+{
+  while (dt > 0)
+  {
+    const TrajectorySegment& segment = current();
+    bool last = segment_ >= script_.size();
+    double remaining = last ? dt : segment_start_ + segment.duration - time_;
+    double h = std::min(dt, remaining);
+
+    // Rotate by the body rate over h, exactly, as the rate is constant.
+    double angle = sqrt(segment.rate[0] * segment.rate[0] + segment.rate[1] * segment.rate[1] +
+                        segment.rate[2] * segment.rate[2]) * h;
+    if (angle > 0)
+    {
+      double s = sin(angle / 2) / (angle / h), c = cos(angle / 2);
+      double d[4] = { segment.rate[0] * s, segment.rate[1] * s, segment.rate[2] * s, c };
+      double q[4] =
+      {
+        q_[3] * d[0] + q_[0] * d[3] + q_[1] * d[2] - q_[2] * d[1],
+        q_[3] * d[1] - q_[0] * d[2] + q_[1] * d[3] + q_[2] * d[0],
+        q_[3] * d[2] + q_[0] * d[1] - q_[1] * d[0] + q_[2] * d[3],
+        q_[3] * d[3] - q_[0] * d[0] - q_[1] * d[1] - q_[2] * d[2]
+      };
+      double norm = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+      for (int i = 0; i < 4; i++) q_[i] = q[i] / norm;
+    }
+    temperature_ += segment.temperature_rate * h;
+
+    time_ += h;
+    dt -= h;
+    if (!last && h >= remaining)
+    {
+      segment_start_ += segment.duration;
+      segment_++;
+    }
+  }
+}
+
+void TrajectoryGenerator::step(double dt, Sample* truth, Sample* measured)
+{
+  advance(dt);
+  const TrajectorySegment& segment = current();
+  const double x = q_[0], y = q_[1], z = q_[2], w = q_[3];
+
+  // Body-to-world rotation, whose transpose takes world vectors into the body.
+  const double r[3][3] =
+  {
+    { 1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y) },
+    { 2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x) },
+    { 2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y) }
+  };
+  double field[3];
+  for (int i = 0; i < 3; i++) field[i] = EARTH_FIELD[i] + segment.mag_disturbance[i];
+
+  double t = time_ - segment_start_;
+  for (int i = 0; i < 3; i++)
+  {
+    truth->channel[Sample::GYRO_X + i] = segment.rate[i];
+    double vibration = segment.vibration_amplitude *
+                       sin(2 * M_PI * (segment.vibration_frequency * t + i / 3.0));
+    truth->channel[Sample::ACCEL_X + i] = r[0][i] * GRAVITY[0] + r[1][i] * GRAVITY[1] + r[2][i] * GRAVITY[2] +
+                                          vibration;
+    truth->channel[Sample::MAG_X + i] = r[0][i] * field[0] + r[1][i] * field[1] + r[2][i] * field[2];
+  }
+
+  truth->channel[Sample::ROLL] = atan2(2 * (w * x + y * z), 1 - 2 * (x * x + y * y));
+  truth->channel[Sample::PITCH] = asin(std::max(-1.0, std::min(1.0, 2 * (w * y - z * x))));
+  truth->channel[Sample::YAW] = atan2(2 * (w * z + x * y), 1 - 2 * (y * y + z * z));
+  for (int i = 0; i < 4; i++) truth->channel[Sample::QUAT_X + i] = q_[i];
+  truth->channel[Sample::TEMPERATURE] = temperature_;
+  std::fill(truth->orientation_covariance, truth->orientation_covariance + 9, 0.0);
+  truth->stamp = time_;
+
+  *measured = *truth;
+  const SensorNoise* models[NUM_SENSORS] = { &noise_.gyro, &noise_.accel, &noise_.mag };
+  for (int s = 0; s < NUM_SENSORS; s++)
+  {
+    const SensorNoise& model = *models[s];
+    for (int i = 0; i < 3; i++)
+    {
+      if (model.bias_walk > 0) walk_[s][i] += model.bias_walk * sqrt(dt) * gaussian();
+      bias_[s][i] = model.bias + walk_[s][i] + model.bias_temperature * (temperature_ - start_temperature_);
+      double& value = measured->channel[Sample::GYRO_X + 3 * s + i];
+      value += bias_[s][i];
+      if (model.white > 0) value += model.white * gaussian();
+    }
+  }
+  if (noise_.temperature > 0) measured->channel[Sample::TEMPERATURE] += noise_.temperature * gaussian();
+}
+
+}  // namespace um6
@@ -0,0 +1,94 @@
+/**
+ *
+ *  \file
+ *  \brief      Kernel UART error counters for the serial port.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+
+#include "um6/uart_counters.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+#include <string>
+
+namespace um6
+{
+
+UartCounters::UartCounters(const std::string& port) : fd_(-1), supported_(false)
+{
+#ifdef TIOCGICOUNT
+  fd_ = open(port.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK);
+  Counts counts;
+  supported_ = read(&counts);
+#endif
+}
+
+UartCounters::~UartCounters()
+{
+  if (fd_ >= 0) close(fd_);
+}
+
+bool UartCounters::read(Counts* counts) const
+{
+#ifdef TIOCGICOUNT
+  struct serial_icounter_struct icount;
+  memset(&icount, 0, sizeof(icount));
+  if (fd_ < 0 || ioctl(fd_, TIOCGICOUNT, &icount) != 0) return false;
+  counts->overrun = icount.overrun;
+  counts->frame = icount.frame;
+  counts->parity = icount.parity;
+  counts->brk = icount.brk;
+  counts->buf_overrun = icount.buf_overrun;
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint32_t UartCounters::get(const Counts& counts, int index)
+{
+  const uint32_t values[NUM_COUNTS] = { counts.overrun, counts.frame, counts.parity, counts.brk, counts.buf_overrun };
+  return values[index];
+}
+
+const char* UartCounters::name(int index)
+{
+  static const char* names[NUM_COUNTS] = { "overrun", "frame", "parity", "break", "buffer_overrun" };
+  return names[index];
+}
+
+}  // namespace um6
@@ -0,0 +1,78 @@
+/**
+ *
+ *  \file
+ *  \brief      Statistics of every channel over tumbling windows of samples.
+ *  \author     Mike Purvis <mpurvis@clearpathrobotics.com>
+ *  \copyright  Copyright (c) 2013, Clearpath Robotics, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Clearpath Robotics, Inc. nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL CLEARPATH ROBOTICS, INC. BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please send comments, questions, or patches to code@clearpathrobotics.com
+ *
+ */
+
+
+#include "um6/windowed_stats.h"
+
+#include <math.h>
+
+#include <stdexcept>
+
+namespace um6
+{
+
+WindowedStats::WindowedStats(double window)
+  : window_(window), start_(-1), closed_start_(0)
+{
+  if (!(window > 0)) throw std::runtime_error("Statistics window must be positive.");
+}
+
+bool WindowedStats::add(const Sample& sample)
+{
+  double start = floor(sample.stamp / window_) * window_;
+  bool closed = false;
+  if (start != start_)
+  {
+    if (current_[0].count() > 0)
+    {
+      for (int c = 0; c < Sample::NUM_CHANNELS; c++)
+      {
+        closed_[c] = current_[c];
+        current_[c].reset();
+      }
+      closed_start_ = start_;
+      closed = true;
+    }
+    start_ = start;
+  }
+  for (int c = 0; c < Sample::NUM_CHANNELS; c++) current_[c].add(sample.channel[c]);
+  return closed;
+}
+
+void WindowedStats::reset()
+{
+  for (int c = 0; c < Sample::NUM_CHANNELS; c++) current_[c].reset();
+  start_ = -1;
+}
+
+}  // namespace um6
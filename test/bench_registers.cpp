@@ -0,0 +1,297 @@
+#include "um6/registers.h"
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "um6/comms.h"
+#include "um6/event_detector.h"
+#include "um6/fixed_sample.h"
+#include "um6/framer.h"
+#include "um6/messages.h"
+#include "um6/sample.h"
+
+// Microbenchmarks of the register array and its accessors, the layer every
+// received packet and every decoded cycle passes through. For results as
+// JSON, run with --benchmark_out=FILE --benchmark_out_format=json, or build
+// the bench_registers_json target.
+
+static void fill(um6::Registers* r)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    r->gyro.set(i, 100 * i - 120);
+    r->accel.set(i, 2000 * i - 5461);
+    r->mag.set(i, 1500 * i - 3000);
+    r->euler.set(i, 3000 * i - 1000);
+  }
+  for (int i = 0; i < 4; i++) r->quat.set(i, 7000 * i - 9000);
+  for (int i = 0; i < 16; i++) r->covariance.set(i, i * 1e-4f);
+  r->temperature.set(0, 31.5f);
+}
+
+// Includes the copy of the by-value std::string argument, as in Comms::receive.
+static void BM_WriteRaw(benchmark::State& state)
+{
+  um6::Registers r;
+  std::string data(state.range(0), '\x5a');
+  for (auto _ : state)
+  {
+    r.write_raw(UM6_ERROR_COV_00, data);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_WriteRaw)->Arg(4)->Arg(8)->Arg(60);
+
+template<size_t N>
+static void BM_MemcpyNetwork(benchmark::State& state)
+{
+  uint8_t src[N] = { 0 }, dest[N];
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(src);
+    um6::memcpy_network(dest, src, N);
+    benchmark::DoNotOptimize(dest);
+  }
+}
+BENCHMARK_TEMPLATE(BM_MemcpyNetwork, 2);
+BENCHMARK_TEMPLATE(BM_MemcpyNetwork, 4);
+
+template<typename RegT>
+static void benchmarkGet(benchmark::State& state, const um6::Accessor<RegT> um6::Registers::*accessor)
+{
+  um6::Registers r;
+  fill(&r);
+  const um6::Accessor<RegT>& a = r.*accessor;
+  uint8_t field = 0;
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(a.get(field));
+    field = (field + 1) % a.length;
+  }
+}
+
+template<typename RegT, typename T>
+static void benchmarkGetScaled(benchmark::State& state, const um6::Accessor<RegT> um6::Registers::*accessor)
+{
+  um6::Registers r;
+  fill(&r);
+  const um6::Accessor<RegT>& a = r.*accessor;
+  uint8_t field = 0;
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(a.template get_scaled_as<T>(field));
+    field = (field + 1) % a.length;
+  }
+}
+
+static void BM_GetInt16(benchmark::State& state)
+{
+  benchmarkGet(state, &um6::Registers::gyro);
+}
+BENCHMARK(BM_GetInt16);
+
+static void BM_GetUint32(benchmark::State& state)
+{
+  benchmarkGet(state, &um6::Registers::status);
+}
+BENCHMARK(BM_GetUint32);
+
+static void BM_GetFloat(benchmark::State& state)
+{
+  benchmarkGet(state, &um6::Registers::covariance);
+}
+BENCHMARK(BM_GetFloat);
+
+static void BM_GetScaledInt16(benchmark::State& state)
+{
+  benchmarkGetScaled<int16_t, double>(state, &um6::Registers::gyro);
+}
+BENCHMARK(BM_GetScaledInt16);
+
+static void BM_GetScaledInt16AsFloat(benchmark::State& state)
+{
+  benchmarkGetScaled<int16_t, float>(state, &um6::Registers::gyro);
+}
+BENCHMARK(BM_GetScaledInt16AsFloat);
+
+static void BM_GetScaledFloat(benchmark::State& state)
+{
+  benchmarkGetScaled<float, double>(state, &um6::Registers::covariance);
+}
+BENCHMARK(BM_GetScaledFloat);
+
+static void BM_DecodeSample(benchmark::State& state)
+{
+  um6::Registers r;
+  fill(&r);
+  um6::Sample s;
+  for (auto _ : state)
+  {
+    um6::decodeSample(r, 0.0, &s);
+    benchmark::DoNotOptimize(s);
+  }
+}
+BENCHMARK(BM_DecodeSample);
+
+static void BM_DecodeSampleFloat(benchmark::State& state)
+{
+  um6::Registers r;
+  fill(&r);
+  um6::SampleF s;
+  for (auto _ : state)
+  {
+    um6::decodeSample(r, 0.0, &s);
+    benchmark::DoNotOptimize(s);
+  }
+}
+BENCHMARK(BM_DecodeSampleFloat);
+
+static void BM_DecodeFixedSample(benchmark::State& state)
+{
+  um6::Registers r;
+  fill(&r);
+  um6::FixedSample s;
+  for (auto _ : state)
+  {
+    um6::decodeFixedSample(r, 0, &s);
+    benchmark::DoNotOptimize(s);
+  }
+}
+BENCHMARK(BM_DecodeFixedSample);
+
+// Everything publishMsgs does with every topic subscribed, short of publishing.
+static void BM_DecodeAndBuildMessages(benchmark::State& state)
+{
+  um6::Registers r;
+  fill(&r);
+  um6::MessageConfig config;
+  std_msgs::Header header;
+  header.frame_id = "imu_link";
+  for (auto _ : state)
+  {
+    um6::Sample s;
+    um6::decodeSample(r, 0.0, &s);
+    sensor_msgs::Imu imu;
+    geometry_msgs::Vector3Stamped mag, rpy;
+    std_msgs::Float32 temperature;
+    um6::imuMessage(s, header, config, &imu);
+    um6::magMessage(s, header, &mag);
+    um6::rpyMessage(s, header, &rpy);
+    um6::temperatureMessage(s, &temperature);
+    benchmark::DoNotOptimize(imu);
+    benchmark::DoNotOptimize(mag);
+    benchmark::DoNotOptimize(rpy);
+    benchmark::DoNotOptimize(temperature);
+  }
+}
+BENCHMARK(BM_DecodeAndBuildMessages);
+
+static std::string packet(const um6::Registers& r, uint8_t index, uint8_t count)
+{
+  uint32_t words[16];
+  r.read_raw(index, count, words);
+  return um6::Comms::message(index, std::string(reinterpret_cast<const char*>(words), count * 4));
+}
+
+// Bytes of the broadcast group which follow the packet at the given address,
+// and that packet itself, in the order the device broadcasts them; the
+// temperature completes a cycle.
+static size_t cycleRemaining(const um6::Registers& r, uint8_t address, std::string* data)
+{
+  const uint8_t order[][2] =
+  {
+    { UM6_GYRO_PROC_XY, 2 }, { UM6_ACCEL_PROC_XY, 2 }, { UM6_MAG_PROC_XY, 2 }, { UM6_EULER_PHI_THETA, 2 },
+    { UM6_QUAT_AB, 2 }, { UM6_ERROR_COV_00, 15 }, { UM6_ERROR_COV_33, 1 }, { UM6_TEMPERATURE, 1 }
+  };
+  size_t remaining = 0;
+  data->clear();
+  for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+  {
+    std::string p = packet(r, order[i][0], order[i][1]);
+    if (order[i][0] == address) *data = p;
+    else if (!data->empty()) remaining += p.size();
+  }
+  return remaining;
+}
+
+// Latency of an event from the arrival of the last byte of the packet which
+// raises it: framing the packet, checking it, and building the message. The
+// wait_for_cycle_us counter is how much longer the event would have taken,
+// at 115200 baud, waiting for the rest of its cycle to arrive.
+static void benchmarkEvent(benchmark::State& state, uint8_t address)
+{
+  um6::Registers r;
+  fill(&r);
+  r.accel.set_scaled(0, 4.0);
+  r.gyro.set_scaled(2, 10.0);
+  std::string data;
+  size_t remaining = cycleRemaining(r, address, &data);
+
+  um6::Framer framer;
+  um6::Registers received;
+  um6::EventDetector detector(3.0, 5.0, 0);
+  std_msgs::Header header;
+  header.frame_id = "imu_link";
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+  for (auto _ : state)
+  {
+    size_t consumed;
+    int16_t parsed = framer.parse(bytes, data.size(), &consumed, &received);
+    um6::EventDetector::Event event;
+    if (!detector.check(parsed, received, 0, &event))
+    {
+      state.SkipWithError("No event detected.");
+      break;
+    }
+    um6::ImuEvent msg;
+    um6::imuEventMessage(event, header, &msg);
+    benchmark::DoNotOptimize(msg);
+    detector.reset();
+  }
+  state.counters["wait_for_cycle_us"] = remaining * 10 / 115200.0 * 1e6;
+}
+
+static void BM_ShockEventLatency(benchmark::State& state)
+{
+  benchmarkEvent(state, UM6_ACCEL_PROC_XY);
+}
+BENCHMARK(BM_ShockEventLatency);
+
+static void BM_RotationEventLatency(benchmark::State& state)
+{
+  benchmarkEvent(state, UM6_GYRO_PROC_XY);
+}
+BENCHMARK(BM_RotationEventLatency);
+
+// Latency of imu/rate from the arrival of the last byte of the gyro packet,
+// against the wait_for_cycle_us which imu/data spends on the rest of its cycle.
+static void BM_EarlyRateLatency(benchmark::State& state)
+{
+  um6::Registers r;
+  fill(&r);
+  std::string data;
+  size_t remaining = cycleRemaining(r, UM6_GYRO_PROC_XY, &data);
+
+  um6::Framer framer;
+  um6::Registers received;
+  std_msgs::Header header;
+  header.frame_id = "imu_link";
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+  for (auto _ : state)
+  {
+    size_t consumed;
+    if (framer.parse(bytes, data.size(), &consumed, &received) != UM6_GYRO_PROC_XY)
+    {
+      state.SkipWithError("Gyro packet not parsed.");
+      break;
+    }
+    geometry_msgs::Vector3Stamped msg;
+    um6::rateMessage(received, header, &msg);
+    benchmark::DoNotOptimize(msg);
+  }
+  state.counters["wait_for_cycle_us"] = remaining * 10 / 115200.0 * 1e6;
+}
+BENCHMARK(BM_EarlyRateLatency);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,102 @@
+#include "um6/allan_variance.h"
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+
+/**
+ * Zero-mean, unit-variance noise from the Box-Muller transform.
+ */
+static double gaussian()
+{
+  double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+  double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+  return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+TEST(AllanVariance, cluster_sizes)
+{
+  std::vector<uint64_t> sizes = um6::allanClusterSizes(10001, 10);
+  ASSERT_FALSE(sizes.empty());
+  EXPECT_EQ(1, sizes.front());
+  EXPECT_LE(sizes.back(), 5000);
+  for (size_t i = 1; i < sizes.size(); i++)
+  {
+    EXPECT_GT(sizes[i], sizes[i - 1]);
+  }
+  EXPECT_TRUE(um6::allanClusterSizes(2).empty());
+}
+
+TEST(AllanVariance, white_noise)
+{
+  srand(1);
+  const double tau0 = 0.01, sigma = 0.1;
+  std::vector<std::vector<double> > signals(1);
+  for (int i = 0; i < 200000; i++)
+  {
+    signals[0].push_back(5.0 + sigma * gaussian());
+  }
+
+  std::vector<um6::AllanCurve> curves;
+  um6::allanDeviationCurves(signals, tau0, 1, &curves);
+  ASSERT_EQ(1, curves.size());
+
+  // For white noise, the deviation at one sample is the noise itself, falling
+  // off as 1/sqrt(m) thereafter.
+  EXPECT_NEAR(sigma, curves[0].adev[0], sigma * 0.02);
+  for (size_t p = 0; p < curves[0].tau.size(); p++)
+  {
+    if (curves[0].tau[p] > 10) break;
+    EXPECT_NEAR(sigma * sqrt(tau0 / curves[0].tau[p]), curves[0].adev[p], sigma * 0.1);
+  }
+
+  um6::AllanNoise noise = um6::fitAllanNoise(curves[0]);
+  EXPECT_NEAR(sigma * sqrt(tau0), noise.angle_random_walk, sigma * sqrt(tau0) * 0.1);
+}
+
+TEST(AllanVariance, random_walk_rises)
+{
+  srand(2);
+  std::vector<std::vector<double> > signals(1);
+  double value = 0;
+  for (int i = 0; i < 50000; i++)
+  {
+    value += 0.01 * gaussian();
+    signals[0].push_back(value);
+  }
+
+  std::vector<um6::AllanCurve> curves;
+  um6::allanDeviationCurves(signals, 1.0, 1, &curves);
+  EXPECT_GT(curves[0].adev[curves[0].adev.size() / 2], 10 * curves[0].adev[0]);
+}
+
+TEST(AllanVariance, threads_match_single)
+{
+  srand(3);
+  std::vector<std::vector<double> > signals(3);
+  for (int i = 0; i < 20000; i++)
+  {
+    for (int s = 0; s < 3; s++)
+    {
+      signals[s].push_back(gaussian() * (s + 1));
+    }
+  }
+
+  std::vector<um6::AllanCurve> single, multi;
+  um6::allanDeviationCurves(signals, 0.05, 1, &single);
+  um6::allanDeviationCurves(signals, 0.05, 4, &multi);
+  ASSERT_EQ(3, multi.size());
+  for (int s = 0; s < 3; s++)
+  {
+    EXPECT_EQ(single[s].tau, multi[s].tau);
+    EXPECT_EQ(single[s].adev, multi[s].adev);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
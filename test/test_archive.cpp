@@ -0,0 +1,160 @@
+#include "um6/archive.h"
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <vector>
+
+
+class Archive : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    char name[] = "/tmp/um6_test_archive_XXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_NE(-1, fd);
+    close(fd);
+    path = name;
+  }
+
+  virtual void TearDown()
+  {
+    unlink(path.c_str());
+  }
+
+  void write_samples(size_t count, uint32_t chunk_samples)
+  {
+    um6::ArchiveWriter writer(path, chunk_samples);
+    for (size_t i = 0; i < count; i++)
+    {
+      um6::Sample s;
+      s.stamp = 100.0 + i * 0.01;
+      for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+      {
+        s.channel[c] = c * 1000 + i;
+      }
+      writer.append(s);
+    }
+  }
+
+  std::string path;
+};
+
+TEST_F(Archive, round_trip)
+{
+  write_samples(1000, 64);
+
+  um6::ArchiveReader reader(path);
+  ASSERT_EQ(1000, reader.size());
+  EXPECT_EQ(16, reader.chunks());
+  EXPECT_EQ(1000 - 15 * 64, reader.chunkCount(15));
+
+  um6::Sample s;
+  reader.sample(777, &s);
+  EXPECT_DOUBLE_EQ(100.0 + 777 * 0.01, s.stamp);
+  EXPECT_FLOAT_EQ(777, s.channel[um6::Sample::GYRO_X]);
+  EXPECT_FLOAT_EQ(16777, s.channel[um6::Sample::TEMPERATURE]);
+  EXPECT_THROW(reader.sample(1000, &s), std::out_of_range);
+}
+
+TEST_F(Archive, chunk_size_rounded)
+{
+  write_samples(10, 5);
+
+  um6::ArchiveReader reader(path);
+  EXPECT_EQ(10, reader.size());
+  EXPECT_EQ(1, reader.chunks());
+}
+
+TEST_F(Archive, chunk_size_out_of_range)
+{
+  EXPECT_THROW(um6::ArchiveWriter(path, 0), std::runtime_error);
+  EXPECT_THROW(um6::ArchiveWriter(path, static_cast<uint32_t>(-1)), std::runtime_error);
+  EXPECT_THROW(um6::ArchiveWriter(path, um6::ArchiveWriter::MAX_CHUNK_SAMPLES + 1), std::runtime_error);
+}
+
+TEST_F(Archive, find_by_stamp)
+{
+  write_samples(500, 32);
+
+  um6::ArchiveReader reader(path);
+  EXPECT_EQ(0, reader.find(0.0));
+  EXPECT_EQ(250, reader.find(102.495));
+  EXPECT_EQ(250, reader.find(102.5 - 1e-9));
+  EXPECT_EQ(500, reader.find(200.0));
+}
+
+TEST_F(Archive, scan_with_decimation)
+{
+  write_samples(500, 32);
+
+  um6::ArchiveReader reader(path);
+  std::vector<double> stamps;
+  std::vector<float> values;
+  EXPECT_EQ(20, reader.scan(101.0, 103.0, 10, um6::Sample::ACCEL_Y, &stamps, &values));
+  ASSERT_EQ(20, values.size());
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    EXPECT_FLOAT_EQ(4000 + 100 + i * 10, values[i]);
+    EXPECT_NEAR(101.0 + i * 0.1, stamps[i], 1e-9);
+  }
+}
+
+TEST_F(Archive, empty)
+{
+  write_samples(0, 32);
+
+  um6::ArchiveReader reader(path);
+  EXPECT_EQ(0, reader.size());
+  EXPECT_EQ(0, reader.find(100.0));
+}
+
+TEST_F(Archive, rejects_inconsistent_headers)
+{
+  write_samples(100, 32);
+  int fd = open(path.c_str(), O_RDWR);
+  ASSERT_NE(-1, fd);
+
+  // A chunk claiming more samples than its columns hold.
+  um6::ArchiveChunkHeader chunk;
+  um6::ArchiveFileHeader header;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(header)), pread(fd, &header, sizeof(header), 0));
+  off_t second = sizeof(header) + header.chunk_bytes;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(chunk)), pread(fd, &chunk, sizeof(chunk), second));
+  EXPECT_EQ(32u, chunk.count);
+  chunk.count = 33;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(chunk)), pwrite(fd, &chunk, sizeof(chunk), second));
+  EXPECT_THROW(um6::ArchiveReader reader(path), std::runtime_error);
+
+  // A short chunk in the middle, which would throw out indexing by sample.
+  chunk.count = 10;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(chunk)), pwrite(fd, &chunk, sizeof(chunk), second));
+  EXPECT_THROW(um6::ArchiveReader reader(path), std::runtime_error);
+
+  // The last chunk may be short.
+  chunk.count = 32;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(chunk)), pwrite(fd, &chunk, sizeof(chunk), second));
+  {
+    um6::ArchiveReader reader(path);
+    ASSERT_EQ(4u, reader.chunks());
+    EXPECT_EQ(4u, reader.chunkCount(3));
+    EXPECT_EQ(100u, reader.scan(0.0, 1000.0, 1, um6::Sample::GYRO_X, NULL, NULL));
+  }
+
+  // A header with empty chunks.
+  header.chunk_samples = 0;
+  header.chunk_bytes = sizeof(um6::ArchiveChunkHeader);
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(header)), pwrite(fd, &header, sizeof(header), 0));
+  close(fd);
+  EXPECT_THROW(um6::ArchiveReader reader(path), std::runtime_error);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,93 @@
+#include "um6/async_log.h"
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+boost::mutex received_mutex;
+std::vector<std::string> received;
+std::vector<um6::AsyncLog::Severity> received_severities;
+
+void collect(um6::AsyncLog::Severity severity, const char* text)
+{
+  boost::mutex::scoped_lock lock(received_mutex);
+  received.push_back(text);
+  received_severities.push_back(severity);
+}
+
+std::vector<std::string> take(std::vector<um6::AsyncLog::Severity>* severities = NULL)
+{
+  boost::mutex::scoped_lock lock(received_mutex);
+  std::vector<std::string> out;
+  out.swap(received);
+  if (severities) severities->swap(received_severities);
+  received_severities.clear();
+  return out;
+}
+}  // namespace
+
+TEST(AsyncLog, direct_until_started)
+{
+  um6::AsyncLog::setSink(collect);
+  UM6_WARN_ASYNC("value %d", 1);
+  std::vector<um6::AsyncLog::Severity> severities;
+  std::vector<std::string> out = take(&severities);
+  ASSERT_EQ(1u, out.size());
+  EXPECT_EQ("value 1", out[0]);
+  EXPECT_EQ(um6::AsyncLog::WARN, severities[0]);
+  um6::AsyncLog::setSink(NULL);
+}
+
+TEST(AsyncLog, rate_limits_each_site)
+{
+  um6::AsyncLog::setSink(collect);
+  um6::AsyncLog::start(16);
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 100; j++)
+    {
+      UM6_LOG_ASYNC(WARN, 0.2, "flood %d", j);
+      if (j % 10 == 0) UM6_LOG_ASYNC(ERROR, 0.2, "other %d", j);
+    }
+    usleep(250000);
+  }
+  um6::AsyncLog::stop();
+  um6::AsyncLog::setSink(NULL);
+
+  std::vector<um6::AsyncLog::Severity> severities;
+  std::vector<std::string> out = take(&severities);
+  ASSERT_EQ(6u, out.size());
+  EXPECT_EQ("flood 0", out[0]);
+  EXPECT_EQ(um6::AsyncLog::WARN, severities[0]);
+  EXPECT_EQ("other 0", out[1]);
+  EXPECT_EQ(um6::AsyncLog::ERROR, severities[1]);
+  EXPECT_EQ("flood 0 (99 similar suppressed)", out[2]);
+  EXPECT_EQ("other 0 (9 similar suppressed)", out[3]);
+  EXPECT_EQ(0u, um6::AsyncLog::dropped());
+}
+
+TEST(AsyncLog, drops_when_full)
+{
+  um6::AsyncLog::setSink(collect);
+  um6::AsyncLog::start(4);
+  um6::AsyncLog::Site sites[64];
+  for (int i = 0; i < 64; i++)
+  {
+    um6::AsyncLog::log(&sites[i], um6::AsyncLog::WARN, 1.0, "site %d", i);
+  }
+  um6::AsyncLog::stop();
+  um6::AsyncLog::setSink(NULL);
+  EXPECT_EQ(64u, take().size() + um6::AsyncLog::dropped());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,53 @@
+#include "um6/cpu_accounting.h"
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+
+namespace
+{
+volatile double sink;
+
+void burn(uint64_t ns)
+{
+  uint64_t until = um6::CpuAccounting::threadCpuNanoseconds() + ns;
+  while (um6::CpuAccounting::threadCpuNanoseconds() < until)
+  {
+    for (int i = 0; i < 1000; i++) sink += i;
+  }
+}
+}  // namespace
+
+TEST(CpuAccounting, charges_current_stage)
+{
+  um6::CpuAccounting cpu;
+  um6::CpuAccounting::Snapshot s = cpu.snapshot();
+  EXPECT_EQ(0u, s.cpu_ns[um6::CpuAccounting::READ]);
+  EXPECT_EQ(0u, s.samples);
+
+  // Sleeping costs no CPU, so the read stage stays small.
+  cpu.enter(um6::CpuAccounting::READ);
+  usleep(50000);
+  cpu.enter(um6::CpuAccounting::DECODE);
+  burn(20000000);
+  cpu.enter(um6::CpuAccounting::PUBLISH);
+  cpu.addSample();
+  cpu.addBytes(100);
+
+  s = cpu.snapshot();
+  EXPECT_LT(s.cpu_ns[um6::CpuAccounting::READ], 10000000u);
+  EXPECT_GE(s.cpu_ns[um6::CpuAccounting::DECODE], 20000000u);
+  EXPECT_EQ(1u, s.samples);
+  EXPECT_EQ(100u, s.bytes);
+
+  // The stage in progress is included in a snapshot.
+  burn(5000000);
+  EXPECT_GE(cpu.snapshot().cpu_ns[um6::CpuAccounting::PUBLISH], 5000000u);
+  EXPECT_EQ(um6::CpuAccounting::PUBLISH, cpu.stage());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
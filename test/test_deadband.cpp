@@ -0,0 +1,72 @@
+#include "um6/deadband.h"
+#include <gtest/gtest.h>
+
+#include "um6/registers.h"
+
+TEST(Deadband, disabled_publishes_every_cycle)
+{
+  um6::Registers r;
+  um6::Deadband<float> deadband(0, 10.0);
+  EXPECT_FALSE(deadband.enabled());
+  for (int i = 0; i < 5; i++) EXPECT_TRUE(deadband.update(r.temperature, i * 0.01));
+}
+
+TEST(Deadband, temperature)
+{
+  um6::Registers r;
+  um6::Deadband<float> deadband(0.25, 0);
+  r.temperature.set(0, 30.0);
+  EXPECT_TRUE(deadband.update(r.temperature, 0.0));
+  r.temperature.set(0, 30.2);
+  EXPECT_FALSE(deadband.update(r.temperature, 1.0));
+  r.temperature.set(0, 29.8);
+  EXPECT_FALSE(deadband.update(r.temperature, 2.0));
+  r.temperature.set(0, 30.3);
+  EXPECT_TRUE(deadband.update(r.temperature, 3.0));
+
+  // Compared against what was last published, not the last seen.
+  r.temperature.set(0, 30.5);
+  EXPECT_FALSE(deadband.update(r.temperature, 4.0));
+  r.temperature.set(0, 30.6);
+  EXPECT_TRUE(deadband.update(r.temperature, 5.0));
+
+  deadband.reset();
+  EXPECT_TRUE(deadband.update(r.temperature, 6.0));
+}
+
+TEST(Deadband, any_field_of_the_mag)
+{
+  um6::Registers r;
+  // Ten counts either way.
+  um6::Deadband<int16_t> deadband(10 * r.mag.scale(), 0);
+  r.mag.set(0, 100);
+  r.mag.set(1, -200);
+  r.mag.set(2, 300);
+  EXPECT_TRUE(deadband.update(r.mag, 0.0));
+  r.mag.set(2, 310);
+  EXPECT_FALSE(deadband.update(r.mag, 0.1));
+  r.mag.set(1, -211);
+  EXPECT_TRUE(deadband.update(r.mag, 0.2));
+  r.mag.set(0, 90);
+  EXPECT_FALSE(deadband.update(r.mag, 0.3));
+  r.mag.set(0, 89);
+  EXPECT_TRUE(deadband.update(r.mag, 0.4));
+}
+
+TEST(Deadband, max_interval)
+{
+  um6::Registers r;
+  um6::Deadband<float> deadband(1.0, 2.0);
+  r.temperature.set(0, 30.0);
+  EXPECT_TRUE(deadband.update(r.temperature, 10.0));
+  EXPECT_FALSE(deadband.update(r.temperature, 11.9));
+  EXPECT_TRUE(deadband.update(r.temperature, 12.0));
+  EXPECT_FALSE(deadband.update(r.temperature, 13.0));
+  EXPECT_TRUE(deadband.update(r.temperature, 14.5));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
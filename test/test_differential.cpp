@@ -0,0 +1,227 @@
+#include "um6/comms.h"
+#include "um6/framer.h"
+#include "um6/registers.h"
+#include "serial/serial.h"
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Drives the reference receive path (Comms over a pseudoterminal) and the
+ * buffer path (Framer) with the same pseudo-random byte stream, and checks
+ * that every parse returns the same result, consumes the same number of
+ * bytes, and leaves the same raw registers, and that both end with the same
+ * packet, checksum, resync and junk byte counters.
+ *
+ * The default packet count keeps this quick enough for every build; set
+ * UM6_DIFFERENTIAL_PACKETS to run a longer soak.
+ */
+class Differential : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    ASSERT_NE(-1, master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NDELAY));
+    ASSERT_NE(-1, grantpt(master_fd));
+    ASSERT_NE(-1, unlockpt(master_fd));
+    char* ser_name;
+    ASSERT_TRUE((ser_name = ptsname(master_fd)) != NULL);
+    ser.setPort(ser_name);
+    serial::Timeout to = serial::Timeout(50, 50, 0, 50, 0);
+    ser.setTimeout(to);
+    ser.open();
+    ASSERT_TRUE(ser.isOpen()) << "Couldn't open Serial connection to pseudoterminal.";
+
+    const char* packets_env = getenv("UM6_DIFFERENTIAL_PACKETS");
+    packets = packets_env ? strtoul(packets_env, NULL, 10) : 100000;
+  }
+
+  virtual void TearDown()
+  {
+    ser.close();
+    close(master_fd);
+  }
+
+  uint8_t randomByte()
+  {
+    return boost::random::uniform_int_distribution<int>(0, 255)(rng);
+  }
+
+  int uniform(int low, int high)
+  {
+    return boost::random::uniform_int_distribution<int>(low, high)(rng);
+  }
+
+  std::string randomPacket()
+  {
+    // Mostly data registers, including batches running off the end of the
+    // register array, with some configuration and command addresses.
+    uint8_t address;
+    int roll = uniform(0, 9);
+    if (roll < 7) address = uniform(DATA_REG_START_ADDRESS, NUM_REGISTERS - 1);
+    else if (roll < 9) address = uniform(0, DATA_REG_START_ADDRESS - 1);
+    else address = uniform(NUM_REGISTERS, 255);
+
+    int registers = uniform(0, 3) == 0 ? 0 : uniform(1, 15);
+    std::string data;
+    for (int i = 0; i < registers * 4; i++)
+    {
+      data += static_cast<char>(randomByte());
+    }
+    return um6::Comms::message(address, data);
+  }
+
+  /**
+   * Appends the next segment of stream: usually a valid packet, otherwise
+   * junk, a truncated packet, or a packet with a flipped bit.
+   */
+  void appendSegment(std::string* stream)
+  {
+    int roll = uniform(0, 99);
+    if (roll < 70)
+    {
+      *stream += randomPacket();
+    }
+    else if (roll < 80)
+    {
+      // Junk, weighted towards header characters to exercise the search.
+      static const char header_chars[] = "snp";
+      int length = uniform(1, 120);
+      for (int i = 0; i < length; i++)
+      {
+        *stream += uniform(0, 1) ? header_chars[uniform(0, 2)] : static_cast<char>(randomByte());
+      }
+    }
+    else if (roll < 90)
+    {
+      std::string packet = randomPacket();
+      *stream += packet.substr(0, uniform(1, packet.length() - 1));
+    }
+    else
+    {
+      std::string packet = randomPacket();
+      packet[uniform(0, packet.length() - 1)] ^= 1 << uniform(0, 7);
+      *stream += packet;
+    }
+  }
+
+  /**
+   * Writes to the pseudoterminal, and waits for the bytes to come through so
+   * that the number available is exact. */
+  void writeSerial(const uint8_t* data, size_t length)
+  {
+    size_t expected = ser.available() + length;
+    while (length > 0)
+    {
+      ssize_t n = write(master_fd, data, length);
+      ASSERT_GT(n, 0);
+      data += n;
+      length -= n;
+    }
+    for (int i = 0; i < 1000 && ser.available() < expected; i++)
+    {
+      usleep(100);
+    }
+    ASSERT_EQ(expected, ser.available());
+  }
+
+  serial::Serial ser;
+  int master_fd;
+  size_t packets;
+  boost::random::mt19937 rng;
+};
+
+namespace
+{
+const int16_t THREW = -100;
+
+int16_t framerParse(um6::Framer* framer, const uint8_t* data, size_t length, size_t* consumed,
+                    um6::Registers* registers)
+{
+  try
+  {
+    return framer->parse(data, length, consumed, registers);
+  }
+  catch(const std::range_error& e)
+  {
+    return THREW;
+  }
+}
+
+int16_t commsReceive(um6::Comms* comms, um6::Registers* registers)
+{
+  try
+  {
+    return comms->receive(registers);
+  }
+  catch(const std::range_error& e)
+  {
+    return THREW;
+  }
+}
+}  // namespace
+
+TEST_F(Differential, comms_and_framer_agree)
+{
+  um6::Comms comms(&ser);
+  um6::Framer framer;
+  um6::Registers comms_registers, framer_registers;
+  uint32_t comms_raw[NUM_REGISTERS], framer_raw[NUM_REGISTERS];
+
+  // The pseudoterminal is kept this far ahead of what Framer consumed, so that
+  // Comms reading too much shows up as well as reading too little. Together
+  // with the longest packet, this stays under Comms' flush threshold.
+  const size_t LOOKAHEAD = 64;
+
+  std::string stream;
+  size_t pos = 0;
+  size_t written = 0;
+  size_t parses = 0;
+  while (parses < packets)
+  {
+    // Keep enough stream ahead of the framer for any packet or search.
+    while (stream.length() - pos < 5 + um6::Framer::SEARCH_LENGTH + 2 + 60 + 2 + LOOKAHEAD)
+    {
+      appendSegment(&stream);
+    }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(stream.data()) + pos;
+    size_t length = stream.length() - pos;
+
+    size_t consumed = 0;
+    int16_t expected = framerParse(&framer, data, length, &consumed, &framer_registers);
+    ASSERT_NE(um6::Framer::NEED_MORE, expected) << "at parse " << parses;
+
+    size_t target = pos + consumed + LOOKAHEAD;
+    writeSerial(reinterpret_cast<const uint8_t*>(stream.data()) + written, target - written);
+    written = target;
+    int16_t actual = commsReceive(&comms, &comms_registers);
+    ASSERT_EQ(expected, actual) << "at parse " << parses << ", stream offset " << pos;
+    ASSERT_EQ(LOOKAHEAD, ser.available()) << "Comms and Framer consumed different lengths at parse " << parses;
+
+    comms_registers.read_raw(0, NUM_REGISTERS, comms_raw);
+    framer_registers.read_raw(0, NUM_REGISTERS, framer_raw);
+    ASSERT_EQ(0, memcmp(comms_raw, framer_raw, sizeof(comms_raw))) << "at parse " << parses;
+
+    pos += consumed;
+    parses++;
+  }
+
+  EXPECT_EQ(framer.packets(), comms.counters().packets);
+  EXPECT_EQ(framer.badChecksums(), comms.counters().bad_checksums);
+  EXPECT_EQ(framer.resyncs(), comms.counters().resyncs);
+  EXPECT_EQ(framer.junkBytes(), comms.counters().junk_bytes);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,85 @@
+#include "um6/event_detector.h"
+#include <gtest/gtest.h>
+
+#include <math.h>
+
+#include "um6/registers.h"
+
+static void setAccel(um6::Registers* r, double north, double east, double down)
+{
+  r->accel.set_scaled(0, north);
+  r->accel.set_scaled(1, east);
+  r->accel.set_scaled(2, down);
+}
+
+TEST(EventDetector, shock)
+{
+  um6::Registers r;
+  um6::EventDetector detector(3.0, 0, 0.1);
+  EXPECT_TRUE(detector.enabled());
+  um6::EventDetector::Event event;
+
+  setAccel(&r, 0, 0, -1.0);
+  EXPECT_FALSE(detector.check(UM6_ACCEL_PROC_XY, r, 0.00, &event));
+
+  setAccel(&r, 2.0, 2.0, -1.0);
+  ASSERT_TRUE(detector.check(UM6_ACCEL_PROC_XY, r, 0.01, &event));
+  EXPECT_EQ(um6::EventDetector::SHOCK, event.type);
+  EXPECT_NEAR(3.0, event.magnitude, 0.001);
+  EXPECT_NEAR(2.0, event.vector[0], 0.001);
+  EXPECT_NEAR(2.0, event.vector[1], 0.001);
+  EXPECT_NEAR(1.0, event.vector[2], 0.001);
+
+  // Other packets, and the gyro with its detector off, are not checked.
+  EXPECT_FALSE(detector.check(UM6_GYRO_PROC_XY, r, 0.01, &event));
+  EXPECT_FALSE(detector.check(UM6_TEMPERATURE, r, 0.01, &event));
+
+  // One event while over the threshold, and none again within the holdoff.
+  setAccel(&r, 4.0, 0, 0);
+  EXPECT_FALSE(detector.check(UM6_ACCEL_PROC_XY, r, 0.02, &event));
+  setAccel(&r, 0, 0, -1.0);
+  EXPECT_FALSE(detector.check(UM6_ACCEL_PROC_XY, r, 0.03, &event));
+  setAccel(&r, 4.0, 0, 0);
+  EXPECT_FALSE(detector.check(UM6_ACCEL_PROC_XY, r, 0.04, &event));
+  setAccel(&r, 0, 0, -1.0);
+  EXPECT_FALSE(detector.check(UM6_ACCEL_PROC_XY, r, 0.12, &event));
+  setAccel(&r, 4.0, 0, 0);
+  EXPECT_TRUE(detector.check(UM6_ACCEL_PROC_XY, r, 0.13, &event));
+  EXPECT_NEAR(4.0, event.magnitude, 0.001);
+
+  detector.reset();
+  EXPECT_TRUE(detector.check(UM6_ACCEL_PROC_XY, r, 0.14, &event));
+}
+
+TEST(EventDetector, rotation)
+{
+  um6::Registers r;
+  um6::EventDetector detector(0, 5.0, 0);
+  um6::EventDetector::Event event;
+  r.gyro.set_scaled(0, 0);
+  r.gyro.set_scaled(1, 0);
+  r.gyro.set_scaled(2, 4.9);
+  EXPECT_FALSE(detector.check(UM6_GYRO_PROC_XY, r, 0, &event));
+  r.gyro.set_scaled(2, 5.1);
+  ASSERT_TRUE(detector.check(UM6_GYRO_PROC_XY, r, 0, &event));
+  EXPECT_EQ(um6::EventDetector::ROTATION, event.type);
+  EXPECT_NEAR(5.1, event.magnitude, 0.002);
+  EXPECT_NEAR(-5.1, event.vector[2], 0.002);
+  EXPECT_STREQ("rotation", um6::EventDetector::typeName(event.type));
+}
+
+TEST(EventDetector, disabled)
+{
+  um6::Registers r;
+  um6::EventDetector detector(0, 0, 0);
+  EXPECT_FALSE(detector.enabled());
+  um6::EventDetector::Event event;
+  setAccel(&r, 5.0, 0, 0);
+  EXPECT_FALSE(detector.check(UM6_ACCEL_PROC_XY, r, 0, &event));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,201 @@
+#include "um6/fan_out.h"
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <vector>
+
+static void collect(std::vector<int>* values, const int& value)
+{
+  values->push_back(value);
+}
+
+static void collectSlowly(std::vector<int>* values, const int& value)
+{
+  values->push_back(value);
+  boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+}
+
+TEST(FanOutQueue, drop_newest)
+{
+  um6::FanOutQueue<int> queue(um6::FanOutPolicy::DROP_NEWEST, 4, 0);
+  for (int i = 0; i < 6; i++)
+  {
+    EXPECT_EQ(i < 4, queue.push(i));
+  }
+  EXPECT_EQ(2u, queue.dropped());
+  EXPECT_EQ(4u, queue.lag());
+  int value;
+  for (int i = 0; i < 4; i++)
+  {
+    ASSERT_TRUE(queue.pop(&value));
+    EXPECT_EQ(i, value);
+  }
+  EXPECT_FALSE(queue.pop(&value));
+  EXPECT_EQ(0u, queue.lag());
+  EXPECT_EQ(4u, queue.maxLag());
+}
+
+TEST(FanOutQueue, drop_oldest)
+{
+  um6::FanOutQueue<int> queue(um6::FanOutPolicy::DROP_OLDEST, 4, 0);
+  for (int i = 0; i < 6; i++)
+  {
+    EXPECT_TRUE(queue.push(i));
+  }
+  EXPECT_EQ(6u, queue.lag());
+  int value;
+  for (int i = 2; i < 6; i++)
+  {
+    ASSERT_TRUE(queue.pop(&value));
+    EXPECT_EQ(i, value);
+  }
+  EXPECT_FALSE(queue.pop(&value));
+  EXPECT_EQ(2u, queue.dropped());
+}
+
+TEST(FanOutQueue, latest)
+{
+  um6::FanOutQueue<int> queue(um6::FanOutPolicy::LATEST, 16, 0);
+  EXPECT_EQ(1u, queue.capacity());
+  for (int i = 0; i < 5; i++) queue.push(i);
+  int value;
+  ASSERT_TRUE(queue.pop(&value));
+  EXPECT_EQ(4, value);
+  EXPECT_FALSE(queue.pop(&value));
+  EXPECT_EQ(4u, queue.dropped());
+}
+
+TEST(FanOutQueue, block_waits_until_deadline)
+{
+  um6::FanOutQueue<int> queue(um6::FanOutPolicy::BLOCK, 2, 0.02);
+  EXPECT_TRUE(queue.push(0));
+  EXPECT_TRUE(queue.push(1));
+  uint64_t start = um6::traceClock();
+  EXPECT_FALSE(queue.push(2));
+  EXPECT_GE(um6::traceClock() - start, 20000000u);
+  EXPECT_EQ(1u, queue.dropped());
+
+}
+
+TEST(FanOut, block_loses_nothing_from_a_consumer_keeping_up)
+{
+  um6::FanOut<int> fan_out;
+  std::vector<int> values;
+  fan_out.add("collect", boost::bind(collect, &values, _1), um6::FanOutPolicy::BLOCK, 2, 1.0);
+  fan_out.start();
+  for (int i = 0; i < 10000; i++) fan_out.push(i);
+  fan_out.stop();
+  ASSERT_EQ(10000u, values.size());
+  for (int i = 0; i < 10000; i++) EXPECT_EQ(i, values[i]);
+  EXPECT_EQ(0u, fan_out.queue(0).dropped());
+}
+
+struct Wide
+{
+  uint64_t words[16];
+};
+
+static void consumeWide(um6::FanOutQueue<Wide>* queue, boost::atomic<bool>* done, uint64_t* received)
+{
+  Wide w;
+  uint64_t last = 0;
+  while (!done->load() || queue->lag() > 0)
+  {
+    if (!queue->pop(&w)) continue;
+    for (int i = 1; i < 16; i++) ASSERT_EQ(w.words[0], w.words[i]);
+    ASSERT_GT(w.words[0], last);
+    last = w.words[0];
+    (*received)++;
+  }
+}
+
+// Under an overwriting policy, a value is either read whole or skipped.
+TEST(FanOutQueue, overwrite_never_tears)
+{
+  um6::FanOutQueue<Wide> queue(um6::FanOutPolicy::DROP_OLDEST, 2, 0);
+  boost::atomic<bool> done(false);
+  uint64_t received = 0;
+  boost::thread consumer(consumeWide, &queue, &done, &received);
+  Wide w;
+  for (uint64_t n = 1; n <= 1000000; n++)
+  {
+    for (int i = 0; i < 16; i++) w.words[i] = n;
+    queue.push(w);
+  }
+  done.store(true);
+  consumer.join();
+  EXPECT_EQ(1000000u, received + queue.dropped());
+}
+
+TEST(FanOut, slow_consumer_holds_up_only_itself)
+{
+  um6::FanOut<int> fan_out;
+  std::vector<int> fast, slow;
+  fan_out.add("fast", boost::bind(collect, &fast, _1), um6::FanOutPolicy::BLOCK, 1024, 1.0);
+  fan_out.add("slow", boost::bind(collectSlowly, &slow, _1), um6::FanOutPolicy::DROP_OLDEST, 4);
+  fan_out.start();
+
+  uint64_t start = um6::traceClock();
+  for (int i = 0; i < 1000; i++) fan_out.push(i);
+  EXPECT_LT(um6::traceClock() - start, 100000000u);
+  fan_out.stop();
+
+  ASSERT_EQ(1000u, fast.size());
+  for (int i = 0; i < 1000; i++) EXPECT_EQ(i, fast[i]);
+  EXPECT_EQ(0u, fan_out.queue(0).dropped());
+
+  // The slow consumer sees an increasing subset, ending with the last value.
+  ASSERT_FALSE(slow.empty());
+  EXPECT_EQ(999, slow.back());
+  for (size_t i = 1; i < slow.size(); i++) EXPECT_LT(slow[i - 1], slow[i]);
+  EXPECT_EQ(1000u, slow.size() + fan_out.queue(1).dropped());
+  EXPECT_EQ("slow", fan_out.name(1));
+}
+
+static void countBusily(boost::atomic<int>* count, const int&)
+{
+  uint64_t start = um6::CpuAccounting::threadCpuNanoseconds();
+  while (um6::CpuAccounting::threadCpuNanoseconds() - start < 1000000) {}
+  (*count)++;
+}
+
+TEST(FanOut, consumer_cpu_is_read_from_its_thread)
+{
+  um6::FanOut<int> fan_out;
+  boost::atomic<int> busy(0);
+  std::vector<int> idle;
+  fan_out.add("busy", boost::bind(countBusily, &busy, _1), um6::FanOutPolicy::BLOCK, 64, 1.0);
+  fan_out.add("idle", boost::bind(collect, &idle, _1), um6::FanOutPolicy::BLOCK, 64, 1.0);
+  EXPECT_EQ(0u, fan_out.cpuNanoseconds(0));
+  fan_out.start();
+
+  uint64_t producer_start = um6::CpuAccounting::threadCpuNanoseconds();
+  for (int i = 0; i < 20; i++) fan_out.push(i);
+  while (busy.load() < 20) boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+  uint64_t producer_ns = um6::CpuAccounting::threadCpuNanoseconds() - producer_start;
+
+  // The busy consumer's 20ms are charged to it, not to the producer. Read from
+  // another thread, its clock may lag by the slice it is running.
+  EXPECT_GE(fan_out.cpuNanoseconds(0), 15000000u);
+  EXPECT_LT(fan_out.cpuNanoseconds(1), 10000000u);
+  EXPECT_LT(producer_ns, 10000000u);
+  fan_out.stop();
+  EXPECT_EQ(0u, fan_out.cpuNanoseconds(0));
+}
+
+TEST(FanOutPolicy, names)
+{
+  um6::FanOutPolicy::Type policy;
+  for (int i = 0; i <= um6::FanOutPolicy::BLOCK; i++)
+  {
+    ASSERT_TRUE(um6::FanOutPolicy::parse(um6::FanOutPolicy::name(static_cast<um6::FanOutPolicy::Type>(i)), &policy));
+    EXPECT_EQ(i, policy);
+  }
+  EXPECT_FALSE(um6::FanOutPolicy::parse("inline", &policy));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,89 @@
+#include "um6/fixed_sample.h"
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include "um6/registers.h"
+#include "um6/sample.h"
+
+// One Q16.16 step, plus the relative error of the compiled-in multipliers.
+static double tolerance(double value)
+{
+  return 1.0 / (1 << um6::Q16_SHIFT) + fabs(value) * 1e-6;
+}
+
+TEST(FixedSample, matches_double_decode)
+{
+  um6::Registers r;
+  srand(1);
+  for (int trial = 0; trial < 1000; trial++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      r.gyro.set(i, rand());
+      r.accel.set(i, rand());
+      r.mag.set(i, rand());
+      r.euler.set(i, rand());
+    }
+    for (int i = 0; i < 4; i++) r.quat.set(i, rand());
+    r.temperature.set(0, 25.5);
+    for (int i = 0; i < 16; i++) r.covariance.set(i, i * 0.125);
+
+    um6::Sample expected, actual;
+    um6::FixedSample fixed;
+    um6::decodeSample(r, 12.5, &expected);
+    um6::decodeFixedSample(r, 12500000000ULL, &fixed);
+    um6::toSample(fixed, &actual);
+
+    EXPECT_DOUBLE_EQ(expected.stamp, actual.stamp);
+    for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+    {
+      EXPECT_NEAR(expected.channel[c], actual.channel[c], tolerance(expected.channel[c]))
+          << um6::Sample::channelName(c);
+    }
+    for (int i = 0; i < 9; i++)
+    {
+      EXPECT_EQ(expected.orientation_covariance[i], actual.orientation_covariance[i]);
+    }
+  }
+}
+
+TEST(FixedSample, extremes_fit)
+{
+  um6::Registers r;
+  um6::FixedSample fixed;
+  for (int i = 0; i < 3; i++) r.gyro.set(i, -32768);
+  um6::decodeFixedSample(r, 0, &fixed);
+  EXPECT_NEAR(-32768 * 0.0610352 * TO_RADIANS, um6::fromQ16(fixed.channel[um6::Sample::GYRO_X]), 1e-4);
+  EXPECT_NEAR(32768 * 0.0610352 * TO_RADIANS, um6::fromQ16(fixed.channel[um6::Sample::GYRO_Z]), 1e-4);
+}
+
+TEST(FixedLowPass, tracks_double_filter)
+{
+  um6::FixedLowPass lowpass(3);
+  um6::FixedSample s = um6::FixedSample();
+  double expected = 0.0;
+  const double alpha = 1.0 / 8;
+
+  lowpass.filter(&s);
+  for (int i = 0; i < 200; i++)
+  {
+    double input = (i < 100) ? 1.5 : -0.25;
+    s.channel[um6::Sample::ACCEL_Z] = static_cast<um6::q16_t>(input * (1 << um6::Q16_SHIFT));
+    s.channel[um6::Sample::YAW] = 12345;
+    lowpass.filter(&s);
+    expected += alpha * (input - expected);
+    EXPECT_NEAR(expected, um6::fromQ16(s.channel[um6::Sample::ACCEL_Z]), 1e-4) << i;
+    EXPECT_EQ(12345, s.channel[um6::Sample::YAW]);
+  }
+  // Settles on the input without truncation bias.
+  EXPECT_EQ(static_cast<um6::q16_t>(-0.25 * (1 << um6::Q16_SHIFT)), s.channel[um6::Sample::ACCEL_Z]);
+
+  EXPECT_THROW(um6::FixedLowPass(9), std::runtime_error);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,146 @@
+#include "um6/flight_recorder.h"
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+class FlightRecorderDump : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    char name[] = "/tmp/um6_test_recorder_XXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_NE(-1, fd);
+    close(fd);
+    path = name;
+  }
+
+  virtual void TearDown()
+  {
+    unlink(path.c_str());
+  }
+
+  std::vector<std::string> dump_lines(const um6::FlightRecorder& recorder)
+  {
+    std::vector<std::string> lines;
+    EXPECT_TRUE(recorder.dump(path.c_str()));
+    std::ifstream f(path.c_str());
+    std::string line;
+    while (std::getline(f, line))
+    {
+      if (line[0] != '#') lines.push_back(line.substr(line.find(' ') + 1));
+    }
+    return lines;
+  }
+
+  std::string path;
+};
+
+TEST_F(FlightRecorderDump, packets_and_events)
+{
+  um6::FlightRecorder recorder(16, 60.0, path);
+  recorder.record(um6::FlightRecorder::RX_PACKET, "snp\x80\x01", 5);
+  recorder.event("link lost\n");
+  recorder.record(um6::FlightRecorder::TX_PACKET, "\xff\x00", 2);
+
+  std::vector<std::string> lines = dump_lines(recorder);
+  ASSERT_EQ(3, lines.size());
+  EXPECT_EQ("rx 73 6e 70 80 01", lines[0]);
+  EXPECT_EQ("event link lost.", lines[1]);
+  EXPECT_EQ("tx ff 00", lines[2]);
+  EXPECT_NE(0, access((path + ".tmp").c_str(), F_OK)) << "Temporary file left behind.";
+}
+
+TEST_F(FlightRecorderDump, keeps_most_recent)
+{
+  um6::FlightRecorder recorder(4, 60.0, path);
+  for (uint8_t i = 0; i < 10; i++)
+  {
+    recorder.record(um6::FlightRecorder::RX_PACKET, &i, 1);
+  }
+
+  std::vector<std::string> lines = dump_lines(recorder);
+  ASSERT_EQ(4, lines.size());
+  EXPECT_EQ("rx 06", lines[0]);
+  EXPECT_EQ("rx 09", lines[3]);
+}
+
+TEST_F(FlightRecorderDump, truncates_long_records)
+{
+  um6::FlightRecorder recorder(4, 60.0, path);
+  std::string junk(200, 'x');
+  recorder.record(um6::FlightRecorder::RX_JUNK, junk.data(), junk.length());
+
+  std::vector<std::string> lines = dump_lines(recorder);
+  ASSERT_EQ(1, lines.size());
+  EXPECT_EQ(std::string("rx-junk").length() + 3 * um6::FlightRecorder::MAX_PAYLOAD, lines[0].length());
+}
+
+TEST_F(FlightRecorderDump, window_excludes_old)
+{
+  um6::FlightRecorder recorder(4, 0.05, path);
+  recorder.event("old");
+  usleep(100000);
+  recorder.event("new");
+
+  std::vector<std::string> lines = dump_lines(recorder);
+  ASSERT_EQ(1, lines.size());
+  EXPECT_EQ("event new", lines[0]);
+}
+
+TEST_F(FlightRecorderDump, default_path)
+{
+  um6::FlightRecorder recorder(4, 60.0, path);
+  recorder.event("hello");
+  EXPECT_STREQ(path.c_str(), recorder.defaultPath());
+  EXPECT_TRUE(recorder.dump());
+  EXPECT_FALSE(recorder.dump("/nonexistent/directory/dump"));
+}
+
+TEST_F(FlightRecorderDump, replaces_stale_temporary)
+{
+  // A link left at the temporary path is removed rather than written through.
+  std::string target = path + ".target";
+  std::string tmp_path = path + ".tmp";
+  ASSERT_EQ(0, symlink(target.c_str(), tmp_path.c_str()));
+
+  um6::FlightRecorder recorder(4, 60.0, path);
+  recorder.event("hello");
+  EXPECT_TRUE(recorder.dump());
+  EXPECT_NE(0, access(target.c_str(), F_OK));
+  EXPECT_NE(0, access(tmp_path.c_str(), F_OK));
+
+  std::vector<std::string> lines = dump_lines(recorder);
+  ASSERT_EQ(1, lines.size());
+  EXPECT_EQ("event hello", lines[0]);
+}
+
+TEST(FlightRecorder, request_path)
+{
+  um6::FlightRecorder recorder(4, 60.0, "/var/log/um6/recorder.txt");
+  std::string path;
+  EXPECT_TRUE(recorder.requestPath("", &path));
+  EXPECT_EQ("/var/log/um6/recorder.txt", path);
+  EXPECT_TRUE(recorder.requestPath("fault.txt", &path));
+  EXPECT_EQ("/var/log/um6/fault.txt", path);
+  EXPECT_FALSE(recorder.requestPath("../fault.txt", &path));
+  EXPECT_FALSE(recorder.requestPath("/etc/passwd", &path));
+  EXPECT_FALSE(recorder.requestPath("sub/fault.txt", &path));
+  EXPECT_FALSE(recorder.requestPath(".hidden", &path));
+
+  um6::FlightRecorder relative(4, 60.0, "recorder.txt");
+  EXPECT_TRUE(relative.requestPath("fault.txt", &path));
+  EXPECT_EQ("fault.txt", path);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
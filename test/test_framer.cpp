@@ -0,0 +1,98 @@
+#include "um6/comms.h"
+#include "um6/framer.h"
+#include "um6/registers.h"
+#include <gtest/gtest.h>
+
+#include <string>
+
+
+static const uint8_t* bytes(const std::string& s)
+{
+  return reinterpret_cast<const uint8_t*>(s.data());
+}
+
+TEST(Framer, basic_message)
+{
+  std::string msg(um6::Comms::message(UM6_MAG_RAW_XY, std::string("\x1\x2\x3\x4")));
+
+  um6::Framer framer;
+  um6::Registers registers;
+  size_t consumed;
+  ASSERT_EQ(UM6_MAG_RAW_XY, framer.parse(bytes(msg), msg.length(), &consumed, &registers));
+  EXPECT_EQ(msg.length(), consumed);
+  EXPECT_EQ(0x0102, registers.mag_raw.get(0));
+  EXPECT_EQ(1, framer.packets());
+}
+
+TEST(Framer, batch_messages_back_to_back)
+{
+  std::string msg(um6::Comms::message(UM6_ACCEL_RAW_XY, std::string("\x5\x6\x7\x8\x9\xa\0\0", 8)));
+  msg += um6::Comms::message(UM6_COMMUNICATION, std::string());
+
+  um6::Framer framer;
+  um6::Registers registers;
+  size_t consumed, pos = 0;
+  ASSERT_EQ(UM6_ACCEL_RAW_XY, framer.parse(bytes(msg), msg.length(), &consumed, &registers));
+  EXPECT_EQ(0x090a, registers.accel_raw.get(2));
+  pos += consumed;
+  ASSERT_EQ(UM6_COMMUNICATION, framer.parse(bytes(msg) + pos, msg.length() - pos, &consumed, &registers));
+  pos += consumed;
+  EXPECT_EQ(msg.length(), pos);
+  EXPECT_EQ(0, framer.resyncs());
+}
+
+TEST(Framer, bad_checksum)
+{
+  std::string msg(um6::Comms::message(UM6_MAG_RAW_XY, std::string("\x1\x2\x3\x4")));
+  msg[msg.length() - 1]++;
+
+  um6::Framer framer;
+  um6::Registers registers;
+  size_t consumed;
+  EXPECT_EQ(-1, framer.parse(bytes(msg), msg.length(), &consumed, &registers));
+  EXPECT_EQ(msg.length(), consumed);
+  EXPECT_EQ(1, framer.badChecksums());
+  EXPECT_EQ(0, registers.mag_raw.get(0));
+}
+
+TEST(Framer, garbage_bytes_preceeding_message)
+{
+  std::string msg(um6::Comms::message(UM6_COMMUNICATION, std::string()));
+  msg = "ssssssnsnsns" + msg;
+
+  um6::Framer framer;
+  size_t consumed;
+  EXPECT_EQ(UM6_COMMUNICATION, framer.parse(bytes(msg), msg.length(), &consumed));
+  EXPECT_EQ(msg.length(), consumed);
+  EXPECT_EQ(1, framer.resyncs());
+  EXPECT_EQ(12, framer.junkBytes());
+}
+
+TEST(Framer, no_header_in_search_length)
+{
+  std::string junk(200, 'x');
+
+  um6::Framer framer;
+  size_t consumed;
+  EXPECT_EQ(-1, framer.parse(bytes(junk), junk.length(), &consumed));
+  EXPECT_EQ(5 + um6::Framer::SEARCH_LENGTH, consumed);
+}
+
+TEST(Framer, partial_message)
+{
+  std::string msg(um6::Comms::message(UM6_ACCEL_RAW_XY, std::string("\x5\x6\x7\x8\x9\xa\0\0", 8)));
+
+  um6::Framer framer;
+  size_t consumed;
+  for (size_t length = 0; length < msg.length(); length++)
+  {
+    EXPECT_EQ(um6::Framer::NEED_MORE, framer.parse(bytes(msg), length, &consumed));
+    EXPECT_EQ(0, consumed);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,147 @@
+#include "um6/latency.h"
+#include "um6/firmware_registers.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+
+TEST(LatencyHistogram, buckets_cover_values_contiguously)
+{
+  EXPECT_EQ(0u, um6::LatencyHistogram::bucketIndex(0));
+  EXPECT_EQ(127u, um6::LatencyHistogram::bucketIndex(127));
+  for (size_t i = 1; i < um6::LatencyHistogram::BUCKET_COUNT; i++)
+  {
+    EXPECT_EQ(um6::LatencyHistogram::bucketHighest(i - 1) + 1, um6::LatencyHistogram::bucketLowest(i));
+    EXPECT_EQ(i, um6::LatencyHistogram::bucketIndex(um6::LatencyHistogram::bucketLowest(i)));
+    EXPECT_EQ(i, um6::LatencyHistogram::bucketIndex(um6::LatencyHistogram::bucketHighest(i)));
+  }
+  EXPECT_EQ(um6::LatencyHistogram::BUCKET_COUNT - 1, um6::LatencyHistogram::bucketIndex(1ull << 62));
+}
+
+TEST(LatencyHistogram, percentiles_within_precision)
+{
+  um6::LatencyHistogram h;
+  EXPECT_EQ(0u, h.percentile(50));
+
+  // 1us to 10ms, uniformly.
+  for (uint64_t i = 1; i <= 10000; i++)
+  {
+    h.record(i * 1000);
+  }
+  EXPECT_EQ(10000u, h.count());
+  EXPECT_EQ(1000u, h.min());
+  EXPECT_EQ(10000000u, h.max());
+  EXPECT_NEAR(5000500.0, h.mean(), 1e-3);
+  EXPECT_NEAR(5000000.0, h.percentile(50), 5000000 * 0.016);
+  EXPECT_NEAR(9900000.0, h.percentile(99), 9900000 * 0.016);
+  EXPECT_EQ(10000000u, h.percentile(100));
+
+  um6::LatencyHistogram other;
+  other.record(20000000);
+  h.merge(other);
+  EXPECT_EQ(10001u, h.count());
+  EXPECT_EQ(20000000u, h.max());
+}
+
+TEST(LatencyTracer, stages_and_chrome_trace)
+{
+  um6::LatencyTracer tracer(2);
+
+  // Stages are ignored until a cycle is started.
+  tracer.mark(um6::LatencyTracer::LAST_PACKET, 5);
+  EXPECT_FALSE(tracer.inCycle());
+
+  for (uint64_t cycle = 0; cycle < 3; cycle++)
+  {
+    uint64_t t = cycle * 1000000;
+    for (int m = 0; m < um6::LatencyTracer::NUM_MARKS; m++)
+    {
+      tracer.mark(static_cast<um6::LatencyTracer::Mark>(m), t);
+      t += (m + 1) * 1000;
+    }
+  }
+  EXPECT_FALSE(tracer.inCycle());
+
+  for (int stage = 0; stage < um6::LatencyTracer::NUM_STAGES; stage++)
+  {
+    EXPECT_EQ(3u, tracer.histogram(stage).count());
+    EXPECT_EQ((stage + 1) * 1000u, tracer.histogram(stage).max());
+  }
+  EXPECT_EQ(15000u, tracer.total().max());
+
+  // Only the last two cycles are kept.
+  std::ostringstream json;
+  tracer.writeChromeTrace(json);
+  EXPECT_EQ(std::string::npos, json.str().find("\"ts\":0.000"));
+  EXPECT_NE(std::string::npos, json.str().find("\"ts\":1000.000"));
+  EXPECT_NE(std::string::npos, json.str().find("\"name\":\"decode\""));
+
+  std::ostringstream summary;
+  tracer.writeSummary(summary);
+  EXPECT_NE(std::string::npos, summary.str().find("total: n=3"));
+}
+
+TEST(LatencyTracer, abandoned_cycle_is_not_recorded)
+{
+  um6::LatencyTracer tracer;
+  tracer.mark(um6::LatencyTracer::FIRST_PACKET, 0);
+  EXPECT_TRUE(tracer.inCycle());
+  tracer.abandon();
+  EXPECT_FALSE(tracer.inCycle());
+
+  // The rest of the abandoned cycle is ignored, and the next is timed from its own first packet.
+  tracer.mark(um6::LatencyTracer::LAST_PACKET, 1000);
+  tracer.mark(um6::LatencyTracer::SPUN, 2000);
+  EXPECT_EQ(0u, tracer.total().count());
+  tracer.mark(um6::LatencyTracer::FIRST_PACKET, 1000000);
+  for (int m = um6::LatencyTracer::LAST_PACKET; m < um6::LatencyTracer::NUM_MARKS; m++)
+  {
+    tracer.mark(static_cast<um6::LatencyTracer::Mark>(m), 1000000 + m * 1000);
+  }
+  EXPECT_EQ(1u, tracer.total().count());
+  EXPECT_EQ(5000u, tracer.total().max());
+}
+
+TEST(ChannelLatency, waits_per_channel_and_early_saving)
+{
+  um6::ChannelLatency channels;
+  EXPECT_EQ(-1, channels.arrived(UM6_GYRO_RAW_XY, 0));
+  EXPECT_EQ(um6::ChannelLatency::GYRO, channels.arrived(UM6_GYRO_PROC_XY, 1000));
+  channels.publishedEarly(um6::ChannelLatency::GYRO, 1100);
+
+  // Only once per arrival.
+  channels.publishedEarly(um6::ChannelLatency::GYRO, 5000);
+  EXPECT_EQ(um6::ChannelLatency::ACCEL, channels.arrived(UM6_ACCEL_PROC_XY, 2000));
+  EXPECT_EQ(um6::ChannelLatency::COVARIANCE, channels.arrived(UM6_ERROR_COV_00, 3000));
+  EXPECT_EQ(um6::ChannelLatency::COVARIANCE, channels.arrived(UM6_ERROR_COV_33, 4000));
+  channels.published(10000);
+
+  EXPECT_EQ(1u, channels.early(um6::ChannelLatency::GYRO).count());
+  EXPECT_EQ(100u, channels.early(um6::ChannelLatency::GYRO).max());
+  EXPECT_EQ(9000u, channels.cycle(um6::ChannelLatency::GYRO).max());
+  EXPECT_EQ(8000u, channels.cycle(um6::ChannelLatency::ACCEL).max());
+  EXPECT_EQ(6000u, channels.cycle(um6::ChannelLatency::COVARIANCE).max());
+  EXPECT_EQ(0u, channels.cycle(um6::ChannelLatency::MAG).count());
+
+  // Nothing is recorded for a cycle which is abandoned.
+  channels.arrived(UM6_GYRO_PROC_XY, 20000);
+  channels.discard();
+  channels.publishedEarly(um6::ChannelLatency::GYRO, 20100);
+  channels.published(30000);
+  EXPECT_EQ(1u, channels.cycle(um6::ChannelLatency::GYRO).count());
+  EXPECT_EQ(1u, channels.early(um6::ChannelLatency::GYRO).count());
+
+  std::ostringstream summary;
+  channels.writeSummary(summary);
+  EXPECT_EQ("gyro: n=1 mean=9.0us p99=9.0us early mean=0.1us p99=0.1us saved=8.9us\n"
+            "accel: n=1 mean=8.0us p99=8.0us\n"
+            "covariance: n=1 mean=6.0us p99=6.0us\n", summary.str());
+
+  channels.reset();
+  EXPECT_EQ(0u, channels.cycle(um6::ChannelLatency::GYRO).count());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
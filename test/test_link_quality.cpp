@@ -0,0 +1,137 @@
+#include "um6/link_quality.h"
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <vector>
+
+
+TEST(LinkQuality, baud_codes_and_broadcast_rate)
+{
+  EXPECT_EQ(5, um6::baudRateCode(115200));
+  EXPECT_EQ(0, um6::baudRateCode(9600));
+  EXPECT_EQ(-1, um6::baudRateCode(230400));
+
+  // 160 bytes per cycle at 70% of 115200 baud allows about 50Hz.
+  uint8_t field;
+  EXPECT_TRUE(um6::broadcastRateField(115200, 160, 0.7, &field));
+  EXPECT_LE(um6::broadcastRateHz(field), 50.4);
+  EXPECT_GT(um6::broadcastRateHz(field + 1), 50.4);
+
+  // Far above the maximum.
+  EXPECT_TRUE(um6::broadcastRateField(921600, 10, 1.0, &field));
+  EXPECT_EQ(255, field);
+
+  // Exactly the minimum, and just below it.
+  EXPECT_TRUE(um6::broadcastRateField(32000, 160, 1.0, &field));
+  EXPECT_EQ(0, field);
+  EXPECT_FALSE(um6::broadcastRateField(31999, 160, 1.0, &field));
+  EXPECT_EQ(0, field);
+}
+
+TEST(LinkQuality, no_broadcast_rate_fits_slow_links)
+{
+  // A full cycle of 164 bytes at 20Hz needs 32.8kbit/s.
+  uint8_t field;
+  EXPECT_TRUE(um6::broadcastRateField(57600, 164, 0.7, &field));
+  EXPECT_FALSE(um6::broadcastRateField(38400, 164, 0.7, &field));
+  EXPECT_FALSE(um6::broadcastRateField(19200, 164, 0.7, &field));
+  EXPECT_FALSE(um6::broadcastRateField(9600, 160, 0.7, &field));
+}
+
+TEST(LinkQuality, tracks_error_fraction)
+{
+  um6::Comms::Counters counters;
+  memset(&counters, 0, sizeof(counters));
+  um6::LinkQuality link(1.0);
+  link.reset(counters, 0);
+  EXPECT_EQ(1.0, link.quality());
+
+  // One packet in ten lost, long enough to converge.
+  for (int t = 1; t <= 20; t++)
+  {
+    counters.packets += 90;
+    counters.bad_checksums += 5;
+    counters.resyncs += 5;
+    counters.junk_bytes += 50;
+    link.update(counters, t);
+  }
+  EXPECT_NEAR(0.9, link.quality(), 1e-3);
+  EXPECT_NEAR(5.0, link.resyncsPerSecond(), 1e-3);
+  EXPECT_NEAR(50.0, link.junkBytesPerSecond(), 1e-3);
+
+  // Nothing but timeouts drags quality towards zero.
+  for (int t = 21; t <= 40; t++)
+  {
+    counters.timeouts += 20;
+    link.update(counters, t);
+  }
+  EXPECT_LT(link.quality(), 1e-3);
+}
+
+TEST(BaudController, falls_back_and_probes_up)
+{
+  std::vector<uint32_t> rates;
+  rates.push_back(115200);
+  rates.push_back(57600);
+  rates.push_back(38400);
+  um6::BaudController controller(rates, 0.95, 5.0, 60.0);
+  controller.reset(115200, 0);
+
+  // Brief dips don't trigger a change; sustained ones do.
+  EXPECT_EQ(0u, controller.update(0.5, 1));
+  EXPECT_EQ(0u, controller.update(0.99, 2));
+  EXPECT_EQ(0u, controller.update(0.5, 3));
+  EXPECT_EQ(0u, controller.update(0.5, 7));
+  EXPECT_EQ(57600u, controller.update(0.5, 8));
+  EXPECT_EQ(57600u, controller.current());
+
+  // Good at the lower rate; after the probe interval, try the higher one.
+  EXPECT_EQ(0u, controller.update(0.99, 30));
+  EXPECT_EQ(115200u, controller.update(0.99, 68));
+
+  // The probe fails, so step back down and wait twice as long next time.
+  EXPECT_EQ(0u, controller.update(0.5, 69));
+  EXPECT_EQ(57600u, controller.update(0.5, 74));
+  EXPECT_EQ(120.0, controller.probeInterval());
+  EXPECT_EQ(0u, controller.update(0.99, 74 + 60));
+  EXPECT_EQ(115200u, controller.update(0.99, 74 + 120));
+
+  // This time the probe holds, and the interval returns to normal.
+  EXPECT_EQ(0u, controller.update(0.99, 74 + 120 + 10));
+  EXPECT_EQ(60.0, controller.probeInterval());
+  EXPECT_EQ(115200u, controller.current());
+
+  // Never beyond the ends of the ladder.
+  controller.reset(38400, 0);
+  EXPECT_EQ(0u, controller.update(0.1, 0));
+  EXPECT_EQ(0u, controller.update(0.1, 100));
+}
+
+TEST(BaudController, lost_probe_backs_off)
+{
+  std::vector<uint32_t> rates;
+  rates.push_back(115200);
+  rates.push_back(57600);
+  um6::BaudController controller(rates, 0.95, 5.0, 60.0);
+  controller.reset(57600, 0);
+  EXPECT_EQ(115200u, controller.update(0.99, 60));
+
+  // The link is lost at the probed rate, and reconnects at the lower one.
+  controller.linkLost();
+  controller.reset(57600, 70);
+  EXPECT_EQ(120.0, controller.probeInterval());
+  EXPECT_EQ(0u, controller.update(0.99, 70 + 60));
+  EXPECT_EQ(115200u, controller.update(0.99, 70 + 120));
+
+  // Losing the link when not probing leaves the interval alone.
+  EXPECT_EQ(0u, controller.update(0.99, 70 + 120 + 10));
+  EXPECT_EQ(60.0, controller.probeInterval());
+  controller.linkLost();
+  EXPECT_EQ(60.0, controller.probeInterval());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,88 @@
+#include "um6/metrics.h"
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace
+{
+std::string fetch(const std::string& path, const std::string& request)
+{
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+  {
+    close(fd);
+    return "";
+  }
+  if (!request.empty()) write(fd, request.data(), request.length());
+
+  std::string response;
+  char buffer[256];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+  {
+    response.append(buffer, n);
+  }
+  close(fd);
+  return response;
+}
+}  // namespace
+
+TEST(Metrics, renders_text_format)
+{
+  um6::Metrics metrics;
+  size_t packets = metrics.add("um6_packets_total", "", um6::Metrics::COUNTER, "Packets received.");
+  size_t p50 = metrics.add("um6_latency_seconds", "stage=\"decode\",quantile=\"0.5\"", um6::Metrics::SUMMARY,
+                           "Stage latency.");
+  size_t count = metrics.add("um6_latency_seconds_count", "stage=\"decode\"", um6::Metrics::SUMMARY, "");
+  metrics.set(packets, 1234);
+  metrics.set(p50, 0.00025);
+  metrics.set(count, 10);
+
+  std::string text;
+  metrics.render(&text);
+  EXPECT_EQ("# HELP um6_packets_total Packets received.\n"
+            "# TYPE um6_packets_total counter\n"
+            "um6_packets_total 1234\n"
+            "# HELP um6_latency_seconds Stage latency.\n"
+            "# TYPE um6_latency_seconds summary\n"
+            "um6_latency_seconds{stage=\"decode\",quantile=\"0.5\"} 0.00025\n"
+            "um6_latency_seconds_count{stage=\"decode\"} 10\n", text);
+}
+
+TEST(MetricsServer, serves_http_and_plain)
+{
+  char dir[] = "/tmp/um6_metrics_XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  std::string path = std::string(dir) + "/metrics.sock";
+
+  um6::Metrics metrics;
+  metrics.set(metrics.add("um6_samples_total", "", um6::Metrics::COUNTER, "Samples."), 42);
+  {
+    um6::MetricsServer server(&metrics, path);
+
+    std::string http = fetch(path, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    EXPECT_EQ(0u, http.find("HTTP/1.0 200 OK\r\n"));
+    EXPECT_NE(std::string::npos, http.find("\r\n\r\n# HELP um6_samples_total"));
+    EXPECT_NE(std::string::npos, http.find("um6_samples_total 42\n"));
+
+    std::string plain = fetch(path, "");
+    EXPECT_EQ(0u, plain.find("# HELP um6_samples_total"));
+  }
+  EXPECT_NE(0, access(path.c_str(), F_OK));
+  rmdir(dir);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
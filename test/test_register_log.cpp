@@ -0,0 +1,176 @@
+#include "um6/register_log.h"
+#include "um6/registers.h"
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+
+static const uint8_t FIRST = UM6_GYRO_PROC_XY;
+static const uint8_t COUNT = UM6_TEMPERATURE - UM6_GYRO_PROC_XY + 1;
+
+/**
+ * Produces frames which random-walk by small amounts, as real data does.
+ */
+static std::vector<std::vector<uint32_t> > random_walk(size_t frames, int step)
+{
+  srand(1234);
+  std::vector<std::vector<uint32_t> > out;
+  std::vector<uint32_t> words(COUNT, 0);
+  std::vector<int16_t> channels(COUNT * 2, 0);
+  for (size_t f = 0; f < frames; f++)
+  {
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(&words[0]);
+    for (size_t c = 0; c < COUNT * 2; c++)
+    {
+      channels[c] += rand() % (2 * step + 1) - step;
+      bytes[2 * c] = static_cast<uint16_t>(channels[c]) >> 8;
+      bytes[2 * c + 1] = static_cast<uint16_t>(channels[c]) & 0xFF;
+    }
+    out.push_back(words);
+  }
+  return out;
+}
+
+static std::string encode_all(const std::vector<std::vector<uint32_t> >& frames, uint32_t keyframe_interval)
+{
+  um6::RegisterLogEncoder encoder(FIRST, COUNT, keyframe_interval);
+  std::string log;
+  encoder.header(&log);
+  for (size_t f = 0; f < frames.size(); f++)
+  {
+    encoder.encode(1000000000ull + f * 10000000ull, &frames[f][0], &log);
+  }
+  return log;
+}
+
+TEST(RegisterLog, round_trip)
+{
+  std::vector<std::vector<uint32_t> > frames = random_walk(1000, 3);
+  std::string log = encode_all(frames, 50);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(log.data());
+
+  um6::RegisterLogDecoder decoder;
+  size_t pos = decoder.header(data, log.length());
+  ASSERT_EQ(um6::RegisterLogHeader::SIZE, pos);
+  EXPECT_EQ(FIRST, decoder.config().first_register);
+  EXPECT_EQ(COUNT, decoder.config().register_count);
+
+  for (size_t f = 0; f < frames.size(); f++)
+  {
+    uint64_t stamp;
+    std::vector<uint32_t> words(COUNT);
+    size_t used = decoder.decode(data + pos, log.length() - pos, &stamp, &words[0]);
+    ASSERT_GT(used, 0);
+    pos += used;
+    EXPECT_EQ(1000000000ull + f * 10000000ull, stamp);
+    EXPECT_EQ(frames[f], words) << "Mismatch at frame " << f;
+  }
+  EXPECT_EQ(log.length(), pos);
+
+  // Small deltas should pack into a fraction of the raw size.
+  EXPECT_LT(log.length(), frames.size() * COUNT * 4 / 3);
+}
+
+TEST(RegisterLog, unchanged_frames_are_tiny)
+{
+  std::vector<std::vector<uint32_t> > frames(100, std::vector<uint32_t>(COUNT, 0x12345678));
+  std::string log = encode_all(frames, 1000);
+  // Header and one keyframe, then just a tag, stamp delta varint and zero width per frame.
+  EXPECT_LT(log.length(), um6::RegisterLogHeader::SIZE + 4 + 14 + COUNT * 4 + 99 * 7);
+}
+
+TEST(RegisterLog, incomplete_frame)
+{
+  std::vector<std::vector<uint32_t> > frames = random_walk(10, 100);
+  std::string log = encode_all(frames, 5);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(log.data());
+
+  um6::RegisterLogDecoder decoder;
+  size_t pos = decoder.header(data, log.length());
+  uint64_t stamp;
+  std::vector<uint32_t> words(COUNT);
+  for (size_t cut = 0; cut < 20; cut++)
+  {
+    EXPECT_EQ(0, decoder.decode(data + pos, cut, &stamp, &words[0]));
+  }
+}
+
+TEST(RegisterLog, seek_to_keyframe)
+{
+  std::vector<std::vector<uint32_t> > frames = random_walk(500, 20);
+  std::string log = encode_all(frames, 64);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(log.data());
+
+  um6::RegisterLogDecoder decoder;
+  decoder.header(data, log.length());
+
+  // Start decoding from an arbitrary point in the middle of the log.
+  size_t pos = decoder.findKeyframe(data, log.length(), log.length() / 2);
+  ASSERT_LT(pos, log.length());
+
+  uint64_t stamp;
+  std::vector<uint32_t> words(COUNT);
+  pos += decoder.decode(data + pos, log.length() - pos, &stamp, &words[0]);
+  uint32_t frame = decoder.frameNumber();
+  EXPECT_EQ(0, frame % 64);
+  EXPECT_EQ(frames[frame], words);
+  EXPECT_EQ(1000000000ull + frame * 10000000ull, stamp);
+
+  while (pos < log.length())
+  {
+    pos += decoder.decode(data + pos, log.length() - pos, &stamp, &words[0]);
+    EXPECT_EQ(frames[decoder.frameNumber()], words);
+  }
+  EXPECT_EQ(499, decoder.frameNumber());
+}
+
+TEST(RegisterLog, delta_without_keyframe)
+{
+  std::vector<std::vector<uint32_t> > frames = random_walk(3, 1);
+  std::string log = encode_all(frames, 100);
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(log.data());
+
+  um6::RegisterLogDecoder decoder;
+  size_t pos = decoder.header(data, log.length());
+  pos = decoder.findKeyframe(data, log.length(), pos + 1);
+  EXPECT_EQ(log.length(), pos);
+
+  uint64_t stamp;
+  std::vector<uint32_t> words(COUNT);
+  size_t key = um6::RegisterLogHeader::SIZE;
+  size_t delta = key + decoder.decode(data + key, log.length() - key, &stamp, &words[0]);
+  decoder.resync();
+  EXPECT_THROW(decoder.decode(data + delta, log.length() - delta, &stamp, &words[0]), std::runtime_error);
+}
+
+TEST(RegisterLog, encode_from_registers)
+{
+  um6::Registers r;
+  r.write_raw(UM6_GYRO_PROC_XY, std::string("\x01\x02\x03\x04\x05\x06\x07\x08", 8));
+
+  um6::RegisterLogEncoder encoder(FIRST, COUNT);
+  std::string log;
+  encoder.header(&log);
+  encoder.encode(0, r, &log);
+
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(log.data());
+  um6::RegisterLogDecoder decoder;
+  size_t pos = decoder.header(data, log.length());
+  std::vector<uint32_t> words(COUNT);
+  uint64_t stamp;
+  decoder.decode(data + pos, log.length() - pos, &stamp, &words[0]);
+
+  um6::Registers out;
+  out.write_raw(FIRST, std::string(reinterpret_cast<char*>(&words[0]), COUNT * 4));
+  EXPECT_EQ(0x0102, out.gyro.get(0));
+  EXPECT_EQ(0x0304, out.gyro.get(1));
+  EXPECT_EQ(0x0506, out.gyro.get(2));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -3,6 +3,9 @@
 
 #include <arpa/inet.h>
 
+#include <stdexcept>
+#include <string>
+
 
 TEST(ByteOrder, compare_with_htons)
 {
@@ -88,6 +91,52 @@ TEST(Accessor, set_float)
   EXPECT_FLOAT_EQ(0.555, check);
 }
 
+TEST(Accessor, set_scaled_rounds)
+{
+  um6::Registers r;
+  for (int16_t raw = -1000; raw <= 1000; raw++)
+  {
+    r.gyro.set_scaled(0, raw * 0.0610352 * TO_RADIANS);
+    EXPECT_EQ(raw, r.gyro.get(0));
+  }
+  r.accel.set_scaled(1, 0.000183105 * 2.4);
+  EXPECT_EQ(2, r.accel.get(1));
+  r.accel.set_scaled(1, -0.000183105 * 2.6);
+  EXPECT_EQ(-3, r.accel.get(1));
+}
+
+TEST(Accessor, set_scaled_saturates)
+{
+  um6::Registers r;
+  // About 34.9 rad/s is the most the gyro register holds.
+  r.gyro.set_scaled(0, 40.0);
+  EXPECT_EQ(32767, r.gyro.get(0));
+  EXPECT_NEAR(34.9, r.gyro.get_scaled(0), 0.05);
+  r.gyro.set_scaled(1, -40.0);
+  EXPECT_EQ(-32768, r.gyro.get(1));
+  r.accel.set_scaled(2, 1e9);
+  EXPECT_EQ(32767, r.accel.get(2));
+  r.accel.set_scaled(2, -1e9);
+  EXPECT_EQ(-32768, r.accel.get(2));
+}
+
+TEST(Registers, write_raw_bounds)
+{
+  um6::Registers r;
+
+  // A batch ending at the last register.
+  std::string two(8, '\x5a');
+  r.write_raw(NUM_REGISTERS - 2, two);
+  uint32_t out[2];
+  r.read_raw(NUM_REGISTERS - 2, 2, out);
+  EXPECT_EQ(0x5a5a5a5au, out[1]);
+
+  // One register past the end, whole or in part.
+  EXPECT_THROW(r.write_raw(NUM_REGISTERS - 1, two), std::range_error);
+  EXPECT_THROW(r.write_raw(NUM_REGISTERS - 2, std::string(9, '\0')), std::range_error);
+  EXPECT_THROW(r.read_raw(NUM_REGISTERS - 1, 2, out), std::range_error);
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
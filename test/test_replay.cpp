@@ -0,0 +1,268 @@
+#include "um6/cycle_decoder.h"
+#include "um6/framer.h"
+#include "um6/messages.h"
+#include "um6/registers.h"
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Runs recorded raw serial streams through the driver's pipeline: framing
+// into the register array, cycle assembly on the trigger packet, decode, and
+// message construction. Publishing is replaced by printing each message, and
+// the result is diffed against golden output stored beside the recording.
+// After an intended change in output, run with UM6_UPDATE_GOLDEN=1 to
+// regenerate the golden files, and review the diff. The golden files are
+// exact to the last bit, as generated on x86-64; a compiler which contracts
+// multiply-adds, as is common on ARM, may differ in the last place.
+
+#ifndef UM6_TEST_DATA
+#define UM6_TEST_DATA "test/data"
+#endif
+
+// As in the driver, arrival of this packet completes a cycle.
+const uint8_t TRIGGER_PACKET = UM6_TEMPERATURE;
+
+// Virtual clock: cycles are stamped at the broadcast rate from a fixed start.
+const uint64_t START_NS = 1400000000000000000ull;
+const uint64_t PERIOD_NS = 50000000ull;
+
+static std::vector<uint8_t> load(const std::string& path)
+{
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file) throw std::runtime_error("Unable to open " + path + ".");
+  return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static void print(std::ostream& out, const char* topic, const std_msgs::Header& header)
+{
+  char stamp[32];
+  snprintf(stamp, sizeof(stamp), "%u.%09u", header.stamp.sec, header.stamp.nsec);
+  out << topic << " " << stamp << " " << header.frame_id;
+}
+
+static void print(std::ostream& out, const geometry_msgs::Vector3& v)
+{
+  out << " " << v.x << " " << v.y << " " << v.z;
+}
+
+static void print(std::ostream& out, const boost::array<double, 9>& m)
+{
+  for (int i = 0; i < 9; i++) out << " " << m[i];
+}
+
+/**
+ * Stands in for the driver's publishers, recording each message as a line of text.
+ */
+class Publisher
+{
+public:
+  Publisher()
+  {
+    out_.precision(17);
+  }
+
+  void publish(const um6::Sample& s, const std_msgs::Header& header)
+  {
+    sensor_msgs::Imu imu = sensor_msgs::Imu();
+    um6::imuMessage(s, header, config_, &imu);
+    print(out_, "imu/data", imu.header);
+    out_ << " " << imu.orientation.x << " " << imu.orientation.y << " " << imu.orientation.z
+         << " " << imu.orientation.w;
+    print(out_, imu.orientation_covariance);
+    print(out_, imu.angular_velocity);
+    print(out_, imu.angular_velocity_covariance);
+    print(out_, imu.linear_acceleration);
+    print(out_, imu.linear_acceleration_covariance);
+    out_ << "\n";
+
+    geometry_msgs::Vector3Stamped mag = geometry_msgs::Vector3Stamped();
+    um6::magMessage(s, header, &mag);
+    print(out_, "imu/mag", mag.header);
+    print(out_, mag.vector);
+    out_ << "\n";
+
+    geometry_msgs::Vector3Stamped rpy = geometry_msgs::Vector3Stamped();
+    um6::rpyMessage(s, header, &rpy);
+    print(out_, "imu/rpy", rpy.header);
+    print(out_, rpy.vector);
+    out_ << "\n";
+
+    std_msgs::Float32 temperature = std_msgs::Float32();
+    um6::temperatureMessage(s, &temperature);
+    out_ << "imu/temperature " << temperature.data << "\n";
+  }
+
+  um6::MessageConfig* config()
+  {
+    return &config_;
+  }
+
+  std::string str() const
+  {
+    return out_.str();
+  }
+
+private:
+  um6::MessageConfig config_;
+  std::ostringstream out_;
+};
+
+/**
+ * Replays a stream as the driver would have received it, in reads of varying
+ * size, returning the number of cycles published.
+ */
+static size_t replay(const std::vector<uint8_t>& stream, um6::CycleDecoder* decoder, Publisher* publisher)
+{
+  um6::Framer framer;
+  um6::Registers registers;
+  std::vector<uint8_t> buffer;
+  std_msgs::Header header;
+  header.frame_id = "imu_link";
+  size_t cycles = 0;
+  uint32_t seed = 1;
+
+  for (size_t pos = 0; pos < stream.size();)
+  {
+    seed = seed * 1103515245 + 12345;
+    size_t chunk = std::min<size_t>(1 + (seed >> 16) % 64, stream.size() - pos);
+    buffer.insert(buffer.end(), stream.begin() + pos, stream.begin() + pos + chunk);
+    pos += chunk;
+
+    size_t offset = 0;
+    while (offset < buffer.size())
+    {
+      size_t consumed = 0;
+      int16_t address;
+      try
+      {
+        address = framer.parse(&buffer[offset], buffer.size() - offset, &consumed, &registers);
+      }
+      catch(const std::range_error& e)
+      {
+        offset += consumed;
+        continue;
+      }
+      if (address == um6::Framer::NEED_MORE) break;
+      offset += consumed;
+
+      if (address == TRIGGER_PACKET)
+      {
+        header.stamp.fromNSec(START_NS + cycles * PERIOD_NS);
+        um6::Sample sample;
+        decoder->decode(registers, header.stamp, &sample);
+        publisher->publish(sample, header);
+        cycles++;
+      }
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + offset);
+  }
+  return cycles;
+}
+
+static void expectGolden(const std::string& name, const std::string& output)
+{
+  std::string path = std::string(UM6_TEST_DATA) + "/" + name;
+  if (getenv("UM6_UPDATE_GOLDEN"))
+  {
+    std::ofstream(path.c_str(), std::ios::binary) << output;
+    return;
+  }
+
+  std::vector<uint8_t> golden_bytes = load(path);
+  std::istringstream golden(std::string(golden_bytes.begin(), golden_bytes.end()));
+  std::istringstream actual(output);
+  std::string expected_line, actual_line;
+  for (size_t line = 1; std::getline(golden, expected_line); line++)
+  {
+    ASSERT_TRUE(std::getline(actual, actual_line)) << path << ":" << line << ": output ends early";
+    ASSERT_EQ(expected_line, actual_line) << path << ":" << line;
+  }
+  EXPECT_FALSE(std::getline(actual, actual_line)) << path << ": output has extra lines";
+}
+
+static void replayGolden(um6::CycleDecoder::Precision precision, int lowpass_shift, const std::string& golden)
+{
+  std::vector<uint8_t> stream = load(std::string(UM6_TEST_DATA) + "/replay.bin");
+  um6::CycleDecoder decoder(precision, lowpass_shift);
+  Publisher publisher;
+  publisher.config()->angular_velocity_covariance = 0.0025;
+  publisher.config()->linear_acceleration_covariance = 0.01;
+  size_t cycles = replay(stream, &decoder, &publisher);
+  EXPECT_GT(cycles, 0u);
+  expectGolden(golden, publisher.str());
+}
+
+TEST(Replay, double_matches_golden)
+{
+  replayGolden(um6::CycleDecoder::DOUBLE, 0, "replay_double.golden");
+}
+
+TEST(Replay, float_lowpass_matches_golden)
+{
+  replayGolden(um6::CycleDecoder::FLOAT, 2, "replay_float_lowpass.golden");
+}
+
+TEST(Replay, fixed_lowpass_matches_golden)
+{
+  replayGolden(um6::CycleDecoder::FIXED, 2, "replay_fixed_lowpass.golden");
+}
+
+// The early rate carries the same angular velocity as imu/data, unfiltered.
+TEST(Replay, early_rate_matches_imu_data)
+{
+  um6::Registers registers;
+  registers.gyro.set_scaled(0, 0.5);
+  registers.gyro.set_scaled(1, -1.25);
+  registers.gyro.set_scaled(2, 2.0);
+  std_msgs::Header header;
+  header.frame_id = "imu_link";
+
+  um6::Sample s;
+  um6::decodeSample(registers, 0, &s);
+  sensor_msgs::Imu imu = sensor_msgs::Imu();
+  um6::imuMessage(s, header, um6::MessageConfig(), &imu);
+  geometry_msgs::Vector3Stamped rate = geometry_msgs::Vector3Stamped();
+  um6::rateMessage(registers, header, &rate);
+  EXPECT_EQ("imu_link", rate.header.frame_id);
+  EXPECT_DOUBLE_EQ(imu.angular_velocity.x, rate.vector.x);
+  EXPECT_DOUBLE_EQ(imu.angular_velocity.y, rate.vector.y);
+  EXPECT_DOUBLE_EQ(imu.angular_velocity.z, rate.vector.z);
+  EXPECT_LT(rate.vector.z, -1.9);
+}
+
+// Cycles per second through the whole stack, repeated UM6_REPLAY_REPEAT times.
+TEST(Replay, throughput)
+{
+  std::vector<uint8_t> stream = load(std::string(UM6_TEST_DATA) + "/replay.bin");
+  int repeat = getenv("UM6_REPLAY_REPEAT") ? atoi(getenv("UM6_REPLAY_REPEAT")) : 20;
+  um6::CycleDecoder decoder(um6::CycleDecoder::DOUBLE, 0);
+
+  struct timespec start, end;
+  size_t cycles = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < repeat; i++)
+  {
+    Publisher publisher;
+    cycles += replay(stream, &decoder, &publisher);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  printf("%zu cycles in %.3f s: %.0f cycles/s\n", cycles, seconds, cycles / seconds);
+  RecordProperty("cycles_per_second", static_cast<int>(cycles / seconds));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
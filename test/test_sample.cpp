@@ -0,0 +1,136 @@
+#include "um6/sample.h"
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "um6/registers.h"
+
+static void randomise(um6::Registers* r)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    r->gyro.set(i, rand());
+    r->accel.set(i, rand());
+    r->mag.set(i, rand());
+    r->euler.set(i, rand());
+  }
+  for (int i = 0; i < 4; i++) r->quat.set(i, rand());
+  r->temperature.set(0, (rand() % 1000) * 0.1 - 40);
+  for (int i = 0; i < 16; i++) r->covariance.set(i, (rand() % 1000) * 1e-4);
+}
+
+TEST(Sample, float_decode_matches_double)
+{
+  um6::Registers r;
+  double max_error[um6::Sample::NUM_CHANNELS] = { 0 };
+  srand(1);
+  for (int trial = 0; trial < 10000; trial++)
+  {
+    randomise(&r);
+    um6::Sample expected;
+    um6::SampleF actual;
+    um6::decodeSample(r, 1.5e9, &expected);
+    um6::decodeSample(r, 1.5e9, &actual);
+
+    // The stamp stays a double.
+    EXPECT_EQ(expected.stamp, actual.stamp);
+    for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+    {
+      // Two roundings to float: the scale factor, then the product.
+      double error = fabs(actual.channel[c] - expected.channel[c]);
+      EXPECT_LE(error, fabs(expected.channel[c]) * 1.2e-7) << um6::Sample::channelName(c);
+      if (error > max_error[c]) max_error[c] = error;
+    }
+    for (int i = 0; i < 9; i++)
+    {
+      EXPECT_EQ(expected.orientation_covariance[i], actual.orientation_covariance[i]);
+    }
+  }
+
+  printf("Largest float vs double decode error by channel:\n");
+  for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+  {
+    printf("  %-12s %.3g\n", um6::Sample::channelName(c), max_error[c]);
+    RecordProperty(std::string("max_error_") + um6::Sample::channelName(c), testing::PrintToString(max_error[c]));
+  }
+}
+
+TEST(Sample, convert_round_trip)
+{
+  um6::Registers r;
+  srand(2);
+  randomise(&r);
+  um6::SampleF single, back;
+  um6::Sample converted;
+  um6::decodeSample(r, 42.0, &single);
+  um6::convertSample(single, &converted);
+  um6::convertSample(converted, &back);
+  EXPECT_EQ(42.0, converted.stamp);
+  for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+  {
+    EXPECT_EQ(single.channel[c], back.channel[c]);
+  }
+}
+
+TEST(Sample, encode_round_trip)
+{
+  um6::Registers r, encoded;
+  srand(3);
+  for (int trial = 0; trial < 1000; trial++)
+  {
+    randomise(&r);
+    um6::Sample s;
+    um6::decodeSample(r, 0, &s);
+    um6::encodeSample(s, &encoded);
+    EXPECT_EQ(r.temperature.get(0), encoded.temperature.get(0));
+    for (int i = 0; i < 3; i++)
+    {
+      EXPECT_EQ(r.gyro.get(i), encoded.gyro.get(i));
+      EXPECT_EQ(r.accel.get(i), encoded.accel.get(i));
+      EXPECT_EQ(r.mag.get(i), encoded.mag.get(i));
+      EXPECT_EQ(r.euler.get(i), encoded.euler.get(i));
+    }
+    for (int i = 0; i < 4; i++) EXPECT_EQ(r.quat.get(i), encoded.quat.get(i));
+  }
+}
+
+TEST(LowPass, float_tracks_double)
+{
+  um6::Registers r;
+  um6::LowPass<double> lowpass(1.0 / 16);
+  um6::LowPass<float> lowpass_float(1.0f / 16);
+  double max_error = 0;
+  srand(3);
+  for (int i = 0; i < 100000; i++)
+  {
+    randomise(&r);
+    um6::Sample s;
+    um6::SampleF single;
+    um6::decodeSample(r, 0, &s);
+    um6::decodeSample(r, 0, &single);
+    double yaw = s.channel[um6::Sample::YAW];
+    lowpass.filter(&s);
+    lowpass_float.filter(&single);
+
+    // Orientation isn't filtered.
+    EXPECT_EQ(yaw, s.channel[um6::Sample::YAW]);
+    for (int c = um6::Sample::GYRO_X; c <= um6::Sample::MAG_Z; c++)
+    {
+      double error = fabs(single.channel[c] - s.channel[c]);
+      if (error > max_error) max_error = error;
+    }
+  }
+  printf("Largest float vs double low-pass error over 1e5 cycles: %.3g\n", max_error);
+  RecordProperty("max_error", testing::PrintToString(max_error));
+
+  // Rounding doesn't accumulate: the filter forgets it at the same rate as the input.
+  EXPECT_LT(max_error, 1e-5);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,186 @@
+#include "um6/snapshot.h"
+#include <gtest/gtest.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+class Snapshot : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    char dir[] = "/tmp/um6_snapshot_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir));
+    dir_ = dir;
+    path_ = dir_ + "/snapshot.bin";
+
+    snapshot_.device = "usb-FTDI_FT232R_USB_UART_A9014MJT-if00-port0";
+    snapshot_.baud = 38400;
+    snapshot_.probe_interval = 480.0;
+    snapshot_.link_quality = 0.993;
+    snapshot_.junk_rate = 12.5;
+    snapshot_.resync_rate = 0.25;
+  }
+
+  virtual void TearDown()
+  {
+    unlink(path_.c_str());
+    rmdir(dir_.c_str());
+  }
+
+  std::string read()
+  {
+    std::ifstream f(path_.c_str(), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  }
+
+  void write(const std::string& data)
+  {
+    std::ofstream(path_.c_str(), std::ios::binary) << data;
+  }
+
+  std::string dir_, path_;
+  um6::DriverSnapshot snapshot_;
+};
+
+TEST_F(Snapshot, round_trip)
+{
+  ASSERT_TRUE(um6::saveSnapshot(path_, snapshot_));
+  EXPECT_EQ(0, access(path_.c_str(), F_OK));
+  // Nothing else, such as the temporary file, is left behind.
+  DIR* dir = opendir(dir_.c_str());
+  ASSERT_TRUE(dir);
+  int entries = 0;
+  while (struct dirent* entry = readdir(dir))
+  {
+    if (entry->d_name[0] != '.') entries++;
+  }
+  closedir(dir);
+  EXPECT_EQ(1, entries);
+
+  um6::DriverSnapshot loaded;
+  ASSERT_TRUE(um6::loadSnapshot(path_, &loaded));
+  EXPECT_EQ(snapshot_.device, loaded.device);
+  EXPECT_EQ(snapshot_.baud, loaded.baud);
+  EXPECT_EQ(snapshot_.probe_interval, loaded.probe_interval);
+  EXPECT_EQ(snapshot_.link_quality, loaded.link_quality);
+  EXPECT_EQ(snapshot_.junk_rate, loaded.junk_rate);
+  EXPECT_EQ(snapshot_.resync_rate, loaded.resync_rate);
+  EXPECT_GT(loaded.stamp_ns, 0u);
+
+  // Replaces the previous snapshot whole.
+  snapshot_.device = "ttyS0";
+  snapshot_.baud = 115200;
+  ASSERT_TRUE(um6::saveSnapshot(path_, snapshot_));
+  ASSERT_TRUE(um6::loadSnapshot(path_, &loaded));
+  EXPECT_EQ("ttyS0", loaded.device);
+  EXPECT_EQ(115200u, loaded.baud);
+}
+
+TEST_F(Snapshot, rejects_damage)
+{
+  um6::DriverSnapshot loaded;
+  EXPECT_FALSE(um6::loadSnapshot(path_, &loaded));
+
+  ASSERT_TRUE(um6::saveSnapshot(path_, snapshot_));
+  std::string good = read();
+
+  for (size_t i = 0; i < good.size(); i++)
+  {
+    std::string bad = good;
+    bad[i] ^= 0x10;
+    write(bad);
+    EXPECT_FALSE(um6::loadSnapshot(path_, &loaded)) << "byte " << i;
+  }
+  const size_t lengths[] = { 0, 8, 12, good.size() / 2, good.size() - 4, good.size() - 1 };
+  for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+  {
+    write(good.substr(0, lengths[i]));
+    EXPECT_FALSE(um6::loadSnapshot(path_, &loaded)) << "length " << lengths[i];
+  }
+  write(good + "x");
+  EXPECT_FALSE(um6::loadSnapshot(path_, &loaded));
+
+  // A failed load leaves the output alone.
+  loaded.baud = 1234;
+  EXPECT_FALSE(um6::loadSnapshot(path_, &loaded));
+  EXPECT_EQ(1234u, loaded.baud);
+}
+
+TEST_F(Snapshot, save_fails_cleanly)
+{
+  EXPECT_FALSE(um6::saveSnapshot(dir_ + "/missing/snapshot.bin", snapshot_));
+}
+
+TEST_F(Snapshot, writer_saves_the_newest)
+{
+  {
+    um6::SnapshotWriter writer(path_);
+    for (uint32_t baud = 1; baud <= 100; baud++)
+    {
+      snapshot_.baud = baud;
+      writer.save(snapshot_);
+    }
+  }
+  um6::DriverSnapshot loaded;
+  ASSERT_TRUE(um6::loadSnapshot(path_, &loaded));
+  EXPECT_EQ(100u, loaded.baud);
+}
+
+TEST_F(Snapshot, writer_counts_failures)
+{
+  um6::SnapshotWriter writer(dir_ + "/missing/snapshot.bin");
+  writer.save(snapshot_);
+  for (int i = 0; i < 1000 && writer.failures() == 0; i++) usleep(1000);
+  EXPECT_EQ(1u, writer.failures());
+}
+
+TEST_F(Snapshot, age)
+{
+  ASSERT_TRUE(um6::saveSnapshot(path_, snapshot_));
+  um6::DriverSnapshot loaded;
+  ASSERT_TRUE(um6::loadSnapshot(path_, &loaded));
+  EXPECT_GE(um6::snapshotAge(loaded), 0.0);
+  EXPECT_LT(um6::snapshotAge(loaded), 60.0);
+
+  loaded.stamp_ns -= 7200 * 1000000000ull;
+  EXPECT_GT(um6::snapshotAge(loaded), 7200.0);
+  loaded.stamp_ns += 14400 * 1000000000ull;
+  EXPECT_LT(um6::snapshotAge(loaded), 0.0);
+}
+
+TEST(DefaultSnapshotPath, unique_per_device)
+{
+  setenv("ROS_HOME", "/home/robot/.ros_home", 1);
+  EXPECT_EQ("/home/robot/.ros_home/um6_snapshot_usb-FTDI_FT232R_USB_UART_A9014MJT-if00-port0.bin",
+            um6::defaultSnapshotPath("usb-FTDI_FT232R_USB_UART_A9014MJT-if00-port0"));
+  EXPECT_EQ("/home/robot/.ros_home/um6_snapshot_dev_ttyUSB0.bin", um6::defaultSnapshotPath("/dev/ttyUSB0"));
+  EXPECT_NE(um6::defaultSnapshotPath("/dev/ttyUSB0"), um6::defaultSnapshotPath("/dev/ttyUSB1"));
+}
+
+TEST(DefaultSnapshotPath, outside_tmp)
+{
+  unsetenv("ROS_HOME");
+  setenv("HOME", "/home/robot", 1);
+  EXPECT_EQ("/home/robot/.ros/um6_snapshot_dev_ttyUSB0.bin", um6::defaultSnapshotPath("/dev/ttyUSB0"));
+  unsetenv("HOME");
+  EXPECT_EQ("", um6::defaultSnapshotPath("/dev/ttyUSB0"));
+}
+
+TEST(DeviceIdentity, falls_back_to_resolved_path)
+{
+  EXPECT_EQ("/dev/does-not-exist", um6::deviceIdentity("/dev/does-not-exist"));
+  EXPECT_EQ("/dev/null", um6::deviceIdentity("/dev/../dev/null"));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
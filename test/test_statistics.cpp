@@ -0,0 +1,79 @@
+#include "um6/statistics.h"
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+TEST(RunningStats, basic)
+{
+  um6::RunningStats stats;
+  EXPECT_EQ(0, stats.count());
+  EXPECT_EQ(0, stats.variance());
+
+  const double values[] = { 2, 4, 4, 4, 5, 5, 7, 9 };
+  for (int i = 0; i < 8; i++)
+  {
+    stats.add(values[i]);
+  }
+  EXPECT_EQ(8, stats.count());
+  EXPECT_DOUBLE_EQ(5.0, stats.mean());
+  EXPECT_DOUBLE_EQ(32.0 / 7, stats.variance());
+  EXPECT_DOUBLE_EQ(2.0, stats.min());
+  EXPECT_DOUBLE_EQ(9.0, stats.max());
+}
+
+TEST(RunningStats, merge_matches_single_pass)
+{
+  um6::RunningStats all, first, second, empty;
+  for (int i = 0; i < 1000; i++)
+  {
+    double value = 1e6 + (i * 7919 % 1000) * 0.01;
+    all.add(value);
+    (i < 300 ? first : second).add(value);
+  }
+  first.merge(empty);
+  first.merge(second);
+  EXPECT_EQ(all.count(), first.count());
+  EXPECT_NEAR(all.mean(), first.mean(), 1e-9);
+  EXPECT_NEAR(all.variance(), first.variance(), 1e-9);
+  EXPECT_EQ(all.min(), first.min());
+  EXPECT_EQ(all.max(), first.max());
+
+  empty.merge(all);
+  EXPECT_EQ(all.count(), empty.count());
+  EXPECT_EQ(all.mean(), empty.mean());
+}
+
+TEST(RunningStats, float_tracks_double)
+{
+  // A stationary gyro axis: small bias plus noise. Float keeps up over a
+  // window of thousands of values, but drifts over longer runs.
+  for (int n = 1000; n <= 1000000; n *= 10)
+  {
+    um6::RunningStats stats;
+    um6::RunningStatsF stats_float;
+    uint32_t seed = 1;
+    for (int i = 0; i < n; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      double value = 0.01 + ((seed >> 8) % 10000 - 5000) * 1e-6;
+      stats.add(value);
+      stats_float.add(value);
+    }
+    double mean_error = fabs(stats_float.mean() - stats.mean()) / stats.mean();
+    double stddev_error = fabs(stats_float.stddev() - stats.stddev()) / stats.stddev();
+    printf("float vs double over %d values: mean %.3g, stddev %.3g relative error\n", n, mean_error, stddev_error);
+    if (n <= 10000)
+    {
+      EXPECT_LT(mean_error, 1e-6);
+      EXPECT_LT(stddev_error, 1e-5);
+    }
+    EXPECT_EQ(static_cast<float>(stats.min()), stats_float.min());
+    EXPECT_EQ(static_cast<float>(stats.max()), stats_float.max());
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,175 @@
+#include "um6/timed_output.h"
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include <stdexcept>
+
+static um6::Sample makeSample(double stamp, double value)
+{
+  um6::Sample s;
+  memset(&s, 0, sizeof(s));
+  s.stamp = stamp;
+  for (int i = um6::Sample::GYRO_X; i <= um6::Sample::MAG_Z; i++) s.channel[i] = value;
+  s.channel[um6::Sample::TEMPERATURE] = value;
+  s.channel[um6::Sample::QUAT_W] = 1.0;
+  s.orientation_covariance[0] = value;
+  return s;
+}
+
+TEST(SampleHold, empty)
+{
+  um6::SampleHold hold(um6::SampleHold::LATEST);
+  um6::Sample s;
+  double age;
+  EXPECT_FALSE(hold.get(10.0, &s, &age));
+  hold.put(makeSample(9.99, 1.0));
+  EXPECT_TRUE(hold.get(10.0, &s, &age));
+  hold.reset();
+  EXPECT_FALSE(hold.get(10.0, &s, &age));
+}
+
+TEST(SampleHold, latest)
+{
+  um6::SampleHold hold(um6::SampleHold::LATEST);
+  hold.put(makeSample(1.00, 1.0));
+  hold.put(makeSample(1.05, 2.0));
+  um6::Sample s;
+  double age;
+  ASSERT_TRUE(hold.get(1.07, &s, &age));
+  EXPECT_DOUBLE_EQ(1.05, s.stamp);
+  EXPECT_DOUBLE_EQ(2.0, s.channel[um6::Sample::GYRO_X]);
+  EXPECT_NEAR(0.02, age, 1e-9);
+}
+
+TEST(SampleHold, interpolate)
+{
+  um6::SampleHold hold(um6::SampleHold::INTERPOLATE);
+  hold.put(makeSample(1.00, 1.0));
+  um6::Sample s;
+  double age;
+
+  // A single sample is held as it is.
+  ASSERT_TRUE(hold.get(1.02, &s, &age));
+  EXPECT_DOUBLE_EQ(1.0, s.channel[um6::Sample::ACCEL_Y]);
+
+  hold.put(makeSample(1.10, 2.0));
+  ASSERT_TRUE(hold.get(1.025, &s, &age));
+  EXPECT_NEAR(1.025, s.stamp, 1e-9);
+  EXPECT_NEAR(1.25, s.channel[um6::Sample::ACCEL_Y], 1e-9);
+  EXPECT_NEAR(1.25, s.channel[um6::Sample::TEMPERATURE], 1e-9);
+  EXPECT_NEAR(-0.075, age, 1e-9);
+  EXPECT_DOUBLE_EQ(2.0, s.orientation_covariance[0]);
+
+  // Outside the two samples, the nearer one.
+  ASSERT_TRUE(hold.get(1.2, &s, &age));
+  EXPECT_NEAR(2.0, s.channel[um6::Sample::ACCEL_Y], 1e-9);
+  EXPECT_NEAR(0.1, age, 1e-9);
+  ASSERT_TRUE(hold.get(0.9, &s, &age));
+  EXPECT_NEAR(1.0, s.channel[um6::Sample::ACCEL_Y], 1e-9);
+}
+
+TEST(SampleHold, extrapolate)
+{
+  um6::SampleHold hold(um6::SampleHold::EXTRAPOLATE, 0.05);
+  hold.put(makeSample(1.00, 1.0));
+  hold.put(makeSample(1.10, 2.0));
+  um6::Sample s;
+  double age;
+  ASSERT_TRUE(hold.get(1.12, &s, &age));
+  EXPECT_NEAR(1.12, s.stamp, 1e-9);
+  EXPECT_NEAR(2.2, s.channel[um6::Sample::MAG_Z], 1e-9);
+  EXPECT_NEAR(0.02, age, 1e-9);
+
+  // No further than the limit past the newest sample.
+  ASSERT_TRUE(hold.get(1.5, &s, &age));
+  EXPECT_NEAR(1.15, s.stamp, 1e-9);
+  EXPECT_NEAR(2.5, s.channel[um6::Sample::MAG_Z], 1e-9);
+  EXPECT_NEAR(0.4, age, 1e-9);
+}
+
+TEST(SampleHold, parse_mode)
+{
+  um6::SampleHold::Mode mode;
+  EXPECT_TRUE(um6::SampleHold::parseMode("interpolate", &mode));
+  EXPECT_EQ(um6::SampleHold::INTERPOLATE, mode);
+  EXPECT_TRUE(um6::SampleHold::parseMode("latest", &mode));
+  EXPECT_EQ(um6::SampleHold::LATEST, mode);
+  EXPECT_FALSE(um6::SampleHold::parseMode("newest", &mode));
+}
+
+TEST(BlendSamples, angles_wrap_the_short_way)
+{
+  um6::Sample from = makeSample(0.0, 0.0), to = makeSample(1.0, 0.0), s;
+  from.channel[um6::Sample::YAW] = M_PI - 0.1;
+  to.channel[um6::Sample::YAW] = -M_PI + 0.1;
+  um6::blendSamples(from, to, 0.25, &s);
+  EXPECT_NEAR(M_PI - 0.05, s.channel[um6::Sample::YAW], 1e-9);
+  um6::blendSamples(from, to, 0.75, &s);
+  EXPECT_NEAR(-M_PI + 0.05, s.channel[um6::Sample::YAW], 1e-9);
+}
+
+TEST(BlendSamples, quaternion_takes_the_short_way_and_stays_unit)
+{
+  um6::Sample from = makeSample(0.0, 0.0), to = makeSample(1.0, 0.0), s;
+  // 90 degrees about z, given as its negation.
+  to.channel[um6::Sample::QUAT_Z] = -sqrt(0.5);
+  to.channel[um6::Sample::QUAT_W] = -sqrt(0.5);
+  um6::blendSamples(from, to, 0.5, &s);
+  double norm = 0;
+  for (int i = um6::Sample::QUAT_X; i <= um6::Sample::QUAT_W; i++) norm += s.channel[i] * s.channel[i];
+  EXPECT_NEAR(1.0, norm, 1e-12);
+  EXPECT_GT(s.channel[um6::Sample::QUAT_W], 0.9);
+  EXPECT_NEAR(sin(M_PI / 8), s.channel[um6::Sample::QUAT_Z], 1e-12);
+}
+
+TEST(PhaseTimer, next)
+{
+  um6::PhaseTimer timer(10000000, 2500000);
+  EXPECT_EQ(2500000u, timer.next(0));
+  EXPECT_EQ(12500000u, timer.next(2500000));
+  EXPECT_EQ(12500000u, timer.next(12499999));
+  EXPECT_EQ(1000000002500000ull, timer.next(1000000000000000ull));
+}
+
+TEST(PhaseTimer, bad_arguments)
+{
+  EXPECT_THROW(um6::PhaseTimer(0, 0), std::runtime_error);
+  EXPECT_THROW(um6::PhaseTimer(1000, 1000), std::runtime_error);
+}
+
+TEST(PhaseTimer, wait_ticks_at_phase)
+{
+  const uint64_t period = 2000000, phase = 700000;
+  um6::PhaseTimer timer(period, phase);
+  uint64_t last = timer.wait();
+  for (int i = 0; i < 10; i++)
+  {
+    uint64_t missed = timer.missed();
+    uint64_t tick = timer.wait();
+    EXPECT_GE(um6::PhaseTimer::now(), tick);
+    EXPECT_EQ(phase, tick % period);
+    EXPECT_EQ(last + period * (1 + timer.missed() - missed), tick);
+    last = tick;
+  }
+}
+
+TEST(PhaseTimer, missed_ticks_are_skipped_and_counted)
+{
+  const uint64_t period = 1000000;
+  um6::PhaseTimer timer(period, 0);
+  uint64_t first = timer.wait();
+  struct timespec ts = { 0, 5500000 };
+  nanosleep(&ts, NULL);
+  uint64_t second = timer.wait();
+  EXPECT_GE(timer.missed(), 5u);
+  EXPECT_EQ(first + period * (1 + timer.missed()), second);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,153 @@
+#include "um6/trajectory.h"
+#include <gtest/gtest.h>
+
+#include <math.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+static std::vector<um6::TrajectorySegment> parse(const std::string& text)
+{
+  std::istringstream in(text);
+  return um6::parseTrajectory(in);
+}
+
+TEST(Trajectory, parse)
+{
+  std::vector<um6::TrajectorySegment> script = parse(
+    "# Settle, then turn left.\n"
+    "5\n"
+    "\n"
+    "2.5 rate=0,0,0.5 vibration=0.2,30  # Bumpy turn.\n"
+    "10 temperature_rate=0.1 mag=0.1,-0.2,0.3\n");
+  ASSERT_EQ(3u, script.size());
+  EXPECT_EQ(5.0, script[0].duration);
+  EXPECT_EQ(0.0, script[0].rate[2]);
+  EXPECT_EQ(2.5, script[1].duration);
+  EXPECT_EQ(0.5, script[1].rate[2]);
+  EXPECT_EQ(0.2, script[1].vibration_amplitude);
+  EXPECT_EQ(30.0, script[1].vibration_frequency);
+  EXPECT_EQ(0.1, script[2].temperature_rate);
+  EXPECT_EQ(-0.2, script[2].mag_disturbance[1]);
+}
+
+TEST(Trajectory, parse_errors)
+{
+  EXPECT_THROW(parse("rate=0,0,1\n"), std::runtime_error);
+  EXPECT_THROW(parse("-1\n"), std::runtime_error);
+  EXPECT_THROW(parse("1 rate=0,1\n"), std::runtime_error);
+  EXPECT_THROW(parse("1 spin=1\n"), std::runtime_error);
+  EXPECT_THROW(parse("1 temperature_rate=0.1x\n"), std::runtime_error);
+  try
+  {
+    parse("1\n2 spin=1\n");
+    FAIL();
+  }
+  catch(const std::runtime_error& e)
+  {
+    EXPECT_NE(std::string::npos, std::string(e.what()).find("line 2"));
+  }
+}
+
+TEST(Trajectory, stationary)
+{
+  um6::TrajectoryGenerator generator(parse("1\n"), um6::NoiseModel(), 1, 20.0);
+  um6::Sample truth, measured;
+  generator.step(0.01, &truth, &measured);
+  EXPECT_DOUBLE_EQ(0.01, truth.stamp);
+  EXPECT_EQ(0.0, truth.channel[um6::Sample::GYRO_X]);
+  EXPECT_NEAR(1.0, truth.channel[um6::Sample::ACCEL_Z], 1e-12);
+  EXPECT_NEAR(0.0, truth.channel[um6::Sample::ACCEL_X], 1e-12);
+  EXPECT_NEAR(0.4472136, truth.channel[um6::Sample::MAG_Y], 1e-7);
+  EXPECT_EQ(1.0, truth.channel[um6::Sample::QUAT_W]);
+  EXPECT_EQ(20.0, truth.channel[um6::Sample::TEMPERATURE]);
+  for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++)
+  {
+    EXPECT_EQ(truth.channel[c], measured.channel[c]) << um6::Sample::channelName(c);
+  }
+}
+
+TEST(Trajectory, rotation_is_consistent)
+{
+  // A quarter turn left, then a half turn nose-down, stepped at an uneven rate.
+  um6::TrajectoryGenerator generator(parse("1 rate=0,0,1.5707963267948966\n"
+                                           "2 rate=0,0.7853981633974483,0\n"),
+                                     um6::NoiseModel(), 1);
+  um6::Sample truth, measured;
+  while (generator.time() < 1.0 - 1e-9) generator.step(0.0137, &truth, &measured);
+  EXPECT_NEAR(M_PI / 2, truth.channel[um6::Sample::YAW], 0.03);
+
+  // Stepping exactly to the end of the first segment lands on the quarter turn.
+  um6::TrajectoryGenerator exact(parse("1 rate=0,0,1.5707963267948966\n"), um6::NoiseModel(), 1);
+  exact.step(0.4, &truth, &measured);
+  exact.step(0.6, &truth, &measured);
+  EXPECT_NEAR(M_PI / 2, truth.channel[um6::Sample::YAW], 1e-9);
+  // Facing north, the field's north component lies along the body's x axis.
+  EXPECT_NEAR(0.4472136, truth.channel[um6::Sample::MAG_X], 1e-7);
+  EXPECT_NEAR(0.0, truth.channel[um6::Sample::MAG_Y], 1e-9);
+  EXPECT_NEAR(sin(M_PI / 4), truth.channel[um6::Sample::QUAT_Z], 1e-9);
+  EXPECT_TRUE(exact.finished());
+
+  // A step across a segment boundary turns for only the part within it.
+  um6::TrajectoryGenerator split(parse("0.5 rate=0,0,1\n1\n"), um6::NoiseModel(), 1);
+  split.step(0.8, &truth, &measured);
+  EXPECT_NEAR(0.5, truth.channel[um6::Sample::YAW], 1e-9);
+  EXPECT_EQ(0.0, truth.channel[um6::Sample::GYRO_Z]);
+
+  // Pitched nose-down by 90 degrees, gravity lies along the body's x axis.
+  um6::TrajectoryGenerator pitch(parse("2 rate=0,0.7853981633974483,0\n"), um6::NoiseModel(), 1);
+  pitch.step(2.0, &truth, &measured);
+  EXPECT_NEAR(-1.0, truth.channel[um6::Sample::ACCEL_X], 1e-9);
+  EXPECT_NEAR(0.0, truth.channel[um6::Sample::ACCEL_Z], 1e-9);
+}
+
+TEST(Trajectory, vibration_and_temperature)
+{
+  um6::TrajectoryGenerator generator(parse("1 vibration=0.5,10 temperature_rate=2\n"), um6::NoiseModel(), 1, 20.0);
+  um6::Sample truth, measured;
+  generator.step(0.025, &truth, &measured);
+  EXPECT_NEAR(0.5, truth.channel[um6::Sample::ACCEL_X], 1e-9);
+  EXPECT_NEAR(20.05, truth.channel[um6::Sample::TEMPERATURE], 1e-9);
+}
+
+TEST(Trajectory, noise_and_bias)
+{
+  um6::NoiseModel noise;
+  noise.gyro.white = 0.01;
+  noise.gyro.bias = 0.05;
+  noise.gyro.bias_temperature = 0.001;
+  noise.accel.bias_walk = 0.002;
+  std::vector<um6::TrajectorySegment> script = parse("100 temperature_rate=0.1\n");
+  um6::TrajectoryGenerator generator(script, noise, 7, 20.0);
+  um6::Sample truth, measured;
+  double sum = 0, sum_squares = 0;
+  const int steps = 10000;
+  for (int i = 0; i < steps; i++)
+  {
+    generator.step(0.01, &truth, &measured);
+    double error = measured.channel[um6::Sample::GYRO_X] - truth.channel[um6::Sample::GYRO_X] -
+                   generator.gyroBias()[0];
+    sum += error;
+    sum_squares += error * error;
+  }
+  EXPECT_NEAR(0.0, sum / steps, 0.001);
+  EXPECT_NEAR(0.01, sqrt(sum_squares / steps), 0.001);
+  // 10 degrees warmer over the run.
+  EXPECT_NEAR(0.06, generator.gyroBias()[2], 1e-9);
+  EXPECT_NE(0.0, generator.accelBias()[0]);
+  EXPECT_EQ(0.0, generator.magBias()[0]);
+
+  // The same seed gives the same measurements.
+  um6::TrajectoryGenerator again(script, noise, 7, 20.0);
+  um6::Sample truth_again, measured_again;
+  for (int i = 0; i < steps; i++) again.step(0.01, &truth_again, &measured_again);
+  EXPECT_EQ(measured.channel[um6::Sample::GYRO_X], measured_again.channel[um6::Sample::GYRO_X]);
+  EXPECT_EQ(measured.channel[um6::Sample::ACCEL_Y], measured_again.channel[um6::Sample::ACCEL_Y]);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
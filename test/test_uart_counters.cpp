@@ -0,0 +1,46 @@
+#include "um6/uart_counters.h"
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+TEST(UartCounters, missing_port)
+{
+  um6::UartCounters uart("/dev/um6_no_such_port");
+  um6::UartCounters::Counts counts;
+  EXPECT_FALSE(uart.supported());
+  EXPECT_FALSE(uart.read(&counts));
+}
+
+TEST(UartCounters, pseudoterminal_has_no_counters)
+{
+  int master_fd;
+  ASSERT_NE(-1, master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NDELAY));
+  ASSERT_NE(-1, grantpt(master_fd));
+  ASSERT_NE(-1, unlockpt(master_fd));
+
+  um6::UartCounters uart(ptsname(master_fd));
+  um6::UartCounters::Counts counts;
+  EXPECT_FALSE(uart.supported());
+  EXPECT_FALSE(uart.read(&counts));
+  close(master_fd);
+}
+
+TEST(UartCounters, names_follow_struct_order)
+{
+  um6::UartCounters::Counts counts = { 1, 2, 3, 4, 5 };
+  for (int i = 0; i < um6::UartCounters::NUM_COUNTS; i++)
+  {
+    EXPECT_EQ(static_cast<uint32_t>(i + 1), um6::UartCounters::get(counts, i));
+  }
+  EXPECT_STREQ("overrun", um6::UartCounters::name(0));
+  EXPECT_STREQ("buffer_overrun", um6::UartCounters::name(4));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,67 @@
+#include "um6/windowed_stats.h"
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <stdexcept>
+
+static um6::Sample makeSample(double stamp, double value)
+{
+  um6::Sample s;
+  memset(&s, 0, sizeof(s));
+  s.stamp = stamp;
+  for (int c = 0; c < um6::Sample::NUM_CHANNELS; c++) s.channel[c] = value + c;
+  return s;
+}
+
+TEST(WindowedStats, tumbling_windows)
+{
+  um6::WindowedStats stats(1.0);
+  const double start = 1400000000.0;
+
+  // Starting part way into a window; it closes when the next one starts.
+  for (int i = 5; i < 20; i++)
+  {
+    bool closed = stats.add(makeSample(start + i * 0.1, i));
+    EXPECT_EQ(i == 10, closed) << i;
+  }
+  EXPECT_EQ(start, stats.start());
+  EXPECT_EQ(1.0, stats.window());
+  const um6::RunningStats& gyro_y = stats.channel(um6::Sample::GYRO_Y);
+  EXPECT_EQ(5u, gyro_y.count());
+  EXPECT_DOUBLE_EQ(8.0, gyro_y.mean());
+  EXPECT_DOUBLE_EQ(6.0, gyro_y.min());
+  EXPECT_DOUBLE_EQ(10.0, gyro_y.max());
+  EXPECT_NEAR(sqrt(2.5), gyro_y.stddev(), 1e-12);
+
+  // A gap of several windows closes only the one with samples in it.
+  EXPECT_TRUE(stats.add(makeSample(start + 5.5, 0)));
+  EXPECT_EQ(start + 1.0, stats.start());
+  EXPECT_EQ(10u, stats.channel(um6::Sample::TEMPERATURE).count());
+  EXPECT_DOUBLE_EQ(14.5 + um6::Sample::TEMPERATURE, stats.channel(um6::Sample::TEMPERATURE).mean());
+}
+
+TEST(WindowedStats, reset)
+{
+  um6::WindowedStats stats(0.5);
+  stats.add(makeSample(10.0, 1));
+  stats.reset();
+  EXPECT_FALSE(stats.add(makeSample(10.6, 2)));
+  EXPECT_FALSE(stats.add(makeSample(10.7, 2)));
+  EXPECT_TRUE(stats.add(makeSample(11.0, 3)));
+  EXPECT_EQ(2u, stats.channel(0).count());
+  EXPECT_EQ(10.5, stats.start());
+}
+
+TEST(WindowedStats, bad_window)
+{
+  EXPECT_THROW(um6::WindowedStats(0), std::runtime_error);
+  EXPECT_THROW(um6::WindowedStats(-1), std::runtime_error);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}